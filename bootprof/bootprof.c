@@ -0,0 +1,183 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef uint8_t u8;
+typedef uint32_t u32;
+typedef uint64_t u64;
+
+#define TICKS_PER_MS    67027.964
+#define PROFILE_MAGIC   "BPRF"
+#define PROFILE_VERSION 1
+#define HISTOGRAM_BINS  10
+#define HISTOGRAM_WIDTH 40
+
+//Keep in sync with source/profile.h
+static const char *stageNames[] = {
+    "mountFs",
+    "readConfig",
+    "boot options",
+    "locateEmuNAND",
+    "writeConfig",
+    "firmRead",
+    "decryption",
+    "patching"
+};
+
+#define STAGE_COUNT (sizeof(stageNames) / sizeof(stageNames[0]))
+
+static const char *firmNames[] = {"NATIVE_FIRM", "TWL_FIRM", "AGB_FIRM", "SAFE_FIRM", "NATIVE_FIRM 2.x"};
+
+typedef struct stageStats
+{
+    double *samples;
+    u32 count,
+        capacity;
+} stageStats;
+
+static stageStats stats[STAGE_COUNT + 1]; //The last one is the whole boot
+
+static void error(FILE *fp, const char *message)
+{
+    fclose(fp);
+    printf("%s, are you sure this is a Luma3DS boot profile?\n", message);
+    exit(1);
+}
+
+static u32 read32(const u8 *buf)
+{
+    return buf[0] | (buf[1] << 8) | (buf[2] << 16) | ((u32)buf[3] << 24);
+}
+
+static u64 read64(const u8 *buf)
+{
+    return read32(buf) | ((u64)read32(buf + 4) << 32);
+}
+
+static void addSample(stageStats *stage, double ms)
+{
+    if(stage->count == stage->capacity)
+    {
+        stage->capacity = stage->capacity ? stage->capacity * 2 : 64;
+        stage->samples = realloc(stage->samples, stage->capacity * sizeof(double));
+        if(stage->samples == NULL)
+        {
+            printf("Out of memory\n");
+            exit(1);
+        }
+    }
+
+    stage->samples[stage->count++] = ms;
+}
+
+static void printStats(const char *name, const stageStats *stage)
+{
+    double min = stage->samples[0],
+           max = stage->samples[0],
+           sum = 0;
+
+    for(u32 i = 0; i < stage->count; i++)
+    {
+        if(stage->samples[i] < min) min = stage->samples[i];
+        if(stage->samples[i] > max) max = stage->samples[i];
+        sum += stage->samples[i];
+    }
+
+    printf("\n%s: %u boots, min %.2f ms, avg %.2f ms, max %.2f ms\n", name, stage->count, min, sum / stage->count, max);
+
+    //All the samples fall in a single bin
+    if(max - min < 0.01) return;
+
+    u32 bins[HISTOGRAM_BINS] = {0},
+        peak = 0;
+    double binSize = (max - min) / HISTOGRAM_BINS;
+
+    for(u32 i = 0; i < stage->count; i++)
+    {
+        u32 bin = (u32)((stage->samples[i] - min) / binSize);
+        if(bin >= HISTOGRAM_BINS) bin = HISTOGRAM_BINS - 1;
+        if(++bins[bin] > peak) peak = bins[bin];
+    }
+
+    for(u32 i = 0; i < HISTOGRAM_BINS; i++)
+    {
+        printf("  %10.2f - %10.2f ms |", min + i * binSize, min + (i + 1) * binSize);
+        for(u32 j = 0; j < bins[i] * HISTOGRAM_WIDTH / peak; j++) putchar('#');
+        printf(" %u\n", bins[i]);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    if(argc < 2)
+    {
+        printf("Usage: %s <bootprof.bin> [-v]\n", argv[0]);
+        exit(0);
+    }
+
+    FILE *fp = fopen(argv[1], "rb");
+    if(fp == NULL)
+    {
+        printf("Couldn't open %s\n", argv[1]);
+        exit(1);
+    }
+
+    int verbose = argc > 2 && strcmp(argv[2], "-v") == 0;
+    u32 boots = 0;
+    u8 header[8];
+
+    while(fread(header, 1, sizeof(header), fp) == sizeof(header))
+    {
+        if(memcmp(header, PROFILE_MAGIC, 4) != 0) error(fp, "Bad record magic");
+        if(header[4] != PROFILE_VERSION) error(fp, "Unsupported record version");
+
+        u32 entryCount = header[5],
+            firmType = header[6],
+            flags = header[7];
+
+        if(verbose)
+            printf("Boot %u: %s, %s, %s, NAND %u, FIRM from %s%s\n", boots + 1,
+                   firmType < sizeof(firmNames) / sizeof(firmNames[0]) ? firmNames[firmType] : "unknown FIRM",
+                   (flags & 1) ? "N3DS" : "O3DS", (flags & 2) ? "A9LH" : "non-A9LH",
+                   (flags >> 3) & 3, ((flags >> 5) & 1) ? "emuNAND" : "sysNAND", (flags & 4) ? ", firmlaunch" : "");
+
+        u64 previous = 0;
+
+        for(u32 i = 0; i < entryCount; i++)
+        {
+            u8 entry[16];
+            if(fread(entry, 1, sizeof(entry), fp) != sizeof(entry)) error(fp, "Truncated record");
+
+            u64 ticks = read64(entry);
+            u32 stage = read32(entry + 8);
+            double ms = (ticks - previous) / TICKS_PER_MS;
+
+            previous = ticks;
+
+            if(stage >= STAGE_COUNT) error(fp, "Unknown stage");
+
+            addSample(&stats[stage], ms);
+
+            if(verbose) printf("  %-14s %10.2f ms\n", stageNames[stage], ms);
+        }
+
+        addSample(&stats[STAGE_COUNT], previous / TICKS_PER_MS);
+        boots++;
+    }
+
+    fclose(fp);
+
+    if(!boots)
+    {
+        printf("No boots recorded\n");
+        exit(0);
+    }
+
+    for(u32 i = 0; i < STAGE_COUNT; i++)
+        if(stats[i].count) printStats(stageNames[i], &stats[i]);
+
+    printStats("whole boot", &stats[STAGE_COUNT]);
+
+    return 0;
+}
@@ -0,0 +1,217 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../source/font.h"
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+
+//Keep in sync with source/draw.h
+#define SCREEN_TOP_WIDTH  400
+#define SCREEN_TOP_HEIGHT 240
+#define SCREEN_TOP_FBSIZE (SCREEN_TOP_WIDTH * SCREEN_TOP_HEIGHT * 3)
+#define SPACING_Y 10
+#define SPACING_X 8
+
+#define BENCHMARK_ROUNDS 2000
+
+//Word aligned like the real framebuffers
+static u32 referenceFb[SCREEN_TOP_FBSIZE / 4],
+           testFb[SCREEN_TOP_FBSIZE / 4];
+static u8 *top_left;
+
+static const char *menuStrings[] = {
+    "Luma3DS configuration",
+    "Press A to select, START to save",
+    "Screen brightness: 4( ) 3( ) 2( ) 1( )",
+    "New 3DS CPU: Off( ) Clock( ) L2( ) Clock+L2( )",
+    "( ) Autoboot SysNAND",
+    "( ) Use SysNAND FIRM if booting with R (A9LH)",
+    "( ) Use second EmuNAND as default",
+    "( ) Enable region/language emu. and ext. .code",
+    "( ) Show current NAND in System Settings",
+    "( ) Enable experimental TwlBg patches",
+    "( ) Show GBA boot screen in patched AGB_FIRM",
+    "( ) Display splash screen before payloads",
+    "( ) Use a PIN",
+    "( ) Load the FIRM while showing the splash"
+};
+
+#define MENU_STRINGS (sizeof(menuStrings) / sizeof(menuStrings[0]))
+
+//The renderer before the glyph atlas, char is unsigned on ARM
+static void referenceDrawCharacter(unsigned char character, int posX, int posY, u32 color)
+{
+    u8 *const select = top_left;
+
+    for(int y = 0; y < 8; y++)
+    {
+        char charPos = font[character * 8 + y];
+
+        for(int x = 7; x >= 0; x--)
+            if ((charPos >> x) & 1)
+            {
+                int screenPos = (posX * SCREEN_TOP_HEIGHT * 3 + (SCREEN_TOP_HEIGHT - y - posY - 1) * 3) + (7 - x) * 3 * SCREEN_TOP_HEIGHT;
+
+                select[screenPos] = color >> 16;
+                select[screenPos + 1] = color >> 8;
+                select[screenPos + 2] = color;
+            }
+    }
+}
+
+static int referenceDrawString(const char *string, int posX, int posY, u32 color)
+{
+    for(int i = 0, line_i = 0; i < (int)strlen(string); i++, line_i++)
+    {
+        if(string[i] == '\n')
+        {
+            posY += SPACING_Y;
+            line_i = 0;
+            i++;
+        }
+        else if(line_i >= (SCREEN_TOP_WIDTH - posX) / SPACING_X)
+        {
+            posY += SPACING_Y;
+            line_i = 2;
+            if(string[i] == ' ') i++;
+        }
+
+        referenceDrawCharacter(string[i], posX + line_i * SPACING_X, posY, color);
+    }
+
+    return posY;
+}
+
+//The firmware's renderer
+#include "../source/glyph.h"
+
+//Like drawCharacter in source/draw.c, without waiting for the screens
+static void drawCharacter(unsigned char character, int posX, int posY, u32 color)
+{
+    blitGlyph(top_left, (char)character, posX, posY, color, false);
+}
+
+static int drawString(const char *string, int posX, int posY, u32 color)
+{
+    int length = strlen(string);
+
+    for(int i = 0, line_i = 0; i < length; i++, line_i++)
+    {
+        if(string[i] == '\n')
+        {
+            posY += SPACING_Y;
+            line_i = 0;
+            i++;
+        }
+        else if(line_i >= (SCREEN_TOP_WIDTH - posX) / SPACING_X)
+        {
+            posY += SPACING_Y;
+            line_i = 2;
+            if(string[i] == ' ') i++;
+        }
+
+        drawCharacter(string[i], posX + line_i * SPACING_X, posY, color);
+    }
+
+    return posY;
+}
+
+static void fillNoise(void)
+{
+    for(u32 i = 0; i < SCREEN_TOP_FBSIZE / 4; i++)
+        referenceFb[i] = testFb[i] = ((u32)rand() << 16) ^ (u32)rand();
+}
+
+static void compare(const char *what, int posY)
+{
+    if(memcmp(referenceFb, testFb, SCREEN_TOP_FBSIZE) == 0) return;
+
+    const u8 *reference = (const u8 *)referenceFb,
+             *test = (const u8 *)testFb;
+    u32 i = 0;
+    while(reference[i] == test[i]) i++;
+
+    printf("Mismatch drawing %s at posY %d: pixel (%u, %u) byte %u is %02X instead of %02X\n", what, posY,
+           i / 3 / SCREEN_TOP_HEIGHT, SCREEN_TOP_HEIGHT - 1 - i / 3 % SCREEN_TOP_HEIGHT, i % 3, test[i], reference[i]);
+    exit(1);
+}
+
+static void checkCharacters(void)
+{
+    //Every glyph at every row alignment, over noise so that stray writes show up
+    for(int posY = 0; posY <= SCREEN_TOP_HEIGHT - 8; posY++)
+    {
+        fillNoise();
+
+        for(u32 c = 0; c < 256; c++)
+        {
+            int posX = (c * 13) % (SCREEN_TOP_WIDTH - 8);
+            u32 color = (u32)rand() & 0xFFFFFF;
+
+            top_left = (u8 *)referenceFb;
+            referenceDrawCharacter(c, posX, posY, color);
+            top_left = (u8 *)testFb;
+            drawCharacter(c, posX, posY, color);
+        }
+
+        compare("characters", posY);
+    }
+}
+
+static void checkStrings(void)
+{
+    static const char *wrapped = "A long line that has to wrap around the right edge of the top screen,\nthen a second line";
+
+    fillNoise();
+
+    for(int posY = 0, i = 0; posY + 2 * SPACING_Y + 8 <= SCREEN_TOP_HEIGHT; posY += 7, i++)
+    {
+        const char *string = i % 4 == 3 ? wrapped : menuStrings[i % MENU_STRINGS];
+        int posX = i % 4 == 3 ? 10 : (i * 3) % 40;
+
+        top_left = (u8 *)referenceFb;
+        int referenceEnd = referenceDrawString(string, posX, posY, 0xFF9900);
+        top_left = (u8 *)testFb;
+        int testEnd = drawString(string, posX, posY, 0xFF9900);
+
+        if(referenceEnd != testEnd)
+        {
+            printf("drawString returned %d instead of %d\n", testEnd, referenceEnd);
+            exit(1);
+        }
+    }
+
+    compare("strings", -1);
+}
+
+static double benchmark(int (*draw)(const char *, int, int, u32), u32 *framebuffer)
+{
+    top_left = (u8 *)framebuffer;
+
+    clock_t start = clock();
+
+    for(u32 round = 0; round < BENCHMARK_ROUNDS; round++)
+        for(u32 i = 0; i < MENU_STRINGS; i++)
+            draw(menuStrings[i], 10, 10 + i * SPACING_Y, round & 1 ? 0xFFFFFF : 0x0000FF);
+
+    return (double)(clock() - start) * 1000 / CLOCKS_PER_SEC / BENCHMARK_ROUNDS;
+}
+
+int main(void)
+{
+    checkCharacters();
+    checkStrings();
+    printf("Output matches the reference renderer pixel for pixel\n");
+
+    double reference = benchmark(referenceDrawString, referenceFb),
+           test = benchmark(drawString, testFb);
+
+    printf("Config menu text: %.4f ms per redraw before, %.4f ms after (%.1fx)\n", reference, test, test > 0 ? reference / test : 0);
+
+    return 0;
+}
@@ -0,0 +1,181 @@
+#include <3ds.h>
+#include "codecache.h"
+#include "memory.h"
+#include "ifile.h"
+#include "fsldr.h"
+
+/* Decompressed and patched code of the last launched titles, one file each in CODE_CACHE_DIR.
+   The index keeps track of their sizes, the least recently launched ones are dropped first
+   to keep the whole cache under CODE_CACHE_MAX_SIZE */
+
+#define CODE_CACHE_INDEX       CODE_CACHE_DIR "/index.bin"
+#define CODE_CACHE_VERSION     1
+
+typedef struct codeCacheHeader
+{
+    char magic[4];
+    u32 version;
+    codeCacheKey key;
+    u32 size;
+} codeCacheHeader;
+
+//Too large for the stack
+static codeCacheIndex cacheIndex;
+
+static Result fileOpen(IFile *file, const char *path, u32 pathSize, u32 flags)
+{
+    FS_Path filePath = {PATH_ASCII, pathSize, path},
+            archivePath = {PATH_EMPTY, 1, (u8 *)""};
+
+    return IFile_Open(file, ARCHIVE_SDMC, archivePath, filePath, flags);
+}
+
+static void readIndex(void)
+{
+    IFile file;
+    u64 total;
+
+    bool valid = R_SUCCEEDED(fileOpen(&file, CODE_CACHE_INDEX, sizeof(CODE_CACHE_INDEX), FS_OPEN_READ));
+
+    if(valid)
+    {
+        valid = R_SUCCEEDED(IFile_Read(&file, &total, &cacheIndex, sizeof(cacheIndex))) && total == sizeof(cacheIndex) &&
+                memcmp(cacheIndex.magic, "CIDX", 4) == 0 && cacheIndex.version == CODE_CACHE_VERSION &&
+                cacheIndex.count <= CODE_CACHE_MAX_ENTRIES;
+        IFile_Close(&file);
+    }
+
+    //Images the index doesn't know about are just overwritten when their title is cached again
+    if(!valid)
+    {
+        memcpy(cacheIndex.magic, "CIDX", 4);
+        cacheIndex.version = CODE_CACHE_VERSION;
+        cacheIndex.useCounter = 0;
+        cacheIndex.count = 0;
+    }
+}
+
+static void writeIndex(void)
+{
+    IFile file;
+    u64 total;
+
+    if(R_SUCCEEDED(fileOpen(&file, CODE_CACHE_INDEX, sizeof(CODE_CACHE_INDEX), FS_OPEN_WRITE | FS_OPEN_CREATE)))
+    {
+        IFile_Write(&file, &total, &cacheIndex, sizeof(cacheIndex), FS_WRITE_FLUSH);
+        IFile_Close(&file);
+    }
+}
+
+static void deleteEntryFile(u64 archive, u64 progId)
+{
+    char path[CODE_CACHE_PATH_SIZE];
+    getCodeCachePath(path, progId);
+
+    FS_Path filePath = {PATH_ASCII, sizeof(path), path};
+    FSLDR_DeleteFile(archive, filePath);
+}
+
+bool loadCachedCode(const codeCacheKey *key, u8 *code, u32 size)
+{
+    char path[CODE_CACHE_PATH_SIZE];
+    getCodeCachePath(path, key->progId);
+
+    IFile file;
+    if(R_FAILED(fileOpen(&file, path, sizeof(path), FS_OPEN_READ))) return false;
+
+    codeCacheHeader header;
+    u64 total;
+
+    //On a miss the code may have been partly overwritten, the caller reads it again anyway
+    bool hit = R_SUCCEEDED(IFile_Read(&file, &total, &header, sizeof(header))) && total == sizeof(header) &&
+               memcmp(header.magic, "CODE", 4) == 0 && header.version == CODE_CACHE_VERSION &&
+               memcmp(&header.key, key, sizeof(codeCacheKey)) == 0 && header.size == size &&
+               R_SUCCEEDED(IFile_Read(&file, &total, code, size)) && total == size;
+
+    IFile_Close(&file);
+
+    if(hit)
+    {
+        readIndex();
+
+        int i = findCodeCacheEntry(&cacheIndex, key->progId);
+        if(i >= 0)
+        {
+            cacheIndex.entries[i].lastUse = ++cacheIndex.useCounter;
+            writeIndex();
+        }
+    }
+
+    return hit;
+}
+
+void saveCachedCode(const codeCacheKey *key, const u8 *code, u32 size)
+{
+    u32 fileSize = sizeof(codeCacheHeader) + size;
+    if(fileSize > CODE_CACHE_MAX_SIZE) return;
+
+    u64 archive;
+    FS_Path archivePath = {PATH_EMPTY, 1, (u8 *)""},
+            cachePath = {PATH_ASCII, sizeof("/luma/cache"), "/luma/cache"},
+            codeCachePath = {PATH_ASCII, sizeof(CODE_CACHE_DIR), CODE_CACHE_DIR};
+
+    if(R_FAILED(FSLDR_OpenArchive(&archive, ARCHIVE_SDMC, archivePath))) return;
+
+    //Fails harmlessly if they're already there
+    FSLDR_CreateDirectory(archive, cachePath, 0);
+    FSLDR_CreateDirectory(archive, codeCachePath, 0);
+
+    readIndex();
+
+    //The previous image of the title is replaced, make sure nothing of it is left
+    int i = findCodeCacheEntry(&cacheIndex, key->progId);
+    if(i >= 0) removeCodeCacheEntry(&cacheIndex, i);
+    deleteEntryFile(archive, key->progId);
+
+    u64 evicted;
+    while(evictCodeCacheEntry(&cacheIndex, fileSize, &evicted)) deleteEntryFile(archive, evicted);
+
+    char path[CODE_CACHE_PATH_SIZE];
+    getCodeCachePath(path, key->progId);
+
+    IFile file;
+    codeCacheHeader header;
+    u64 total;
+    bool success = R_SUCCEEDED(fileOpen(&file, path, sizeof(path), FS_OPEN_WRITE | FS_OPEN_CREATE));
+
+    if(success)
+    {
+        memcpy(header.magic, "CODE", 4);
+        header.version = CODE_CACHE_VERSION;
+        memcpy(&header.key, key, sizeof(codeCacheKey));
+        header.size = size;
+
+        //The header goes last, an interrupted write leaves a file that's never a hit
+        file.pos = sizeof(header);
+        success = R_SUCCEEDED(IFile_Write(&file, &total, code, size, FS_WRITE_FLUSH)) && total == size;
+
+        if(success)
+        {
+            file.pos = 0;
+            success = R_SUCCEEDED(IFile_Write(&file, &total, &header, sizeof(header), FS_WRITE_FLUSH)) && total == sizeof(header);
+        }
+
+        IFile_Close(&file);
+    }
+
+    if(success)
+    {
+        codeCacheEntry *entry = &cacheIndex.entries[cacheIndex.count++];
+
+        entry->progId = key->progId;
+        entry->fileSize = fileSize;
+        entry->lastUse = ++cacheIndex.useCounter;
+    }
+
+    //Don't leave a truncated image behind, e.g. if the SD is full
+    else deleteEntryFile(archive, key->progId);
+
+    writeIndex();
+    FSLDR_CloseArchive(archive);
+}
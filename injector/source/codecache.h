@@ -0,0 +1,7 @@
+#pragma once
+
+#include <3ds/types.h>
+#include "codecacheindex.h"
+
+bool loadCachedCode(const codeCacheKey *key, u8 *code, u32 size);
+void saveCachedCode(const codeCacheKey *key, const u8 *code, u32 size);
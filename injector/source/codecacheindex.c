@@ -0,0 +1,112 @@
+#include <3ds/types.h>
+#include "codecacheindex.h"
+#include "memory.h"
+
+/* Sums up the settings patchCode uses for a title, keep in sync with it. Returns false if the result
+   also depends on a file that can't be summed up, like a replacement code section */
+bool getPatchSettings(u64 progId, patchSettings *settings)
+{
+    const CFWInfo info = *getCFWInfo();
+
+    settings->commitHash = info.commitHash;
+    settings->values = 0;
+
+    switch(progId)
+    {
+        case 0x0004013000002C02LL: // NIM
+            settings->values = (BOOTCONFIG(0, 3) != 0) == (BOOTCONFIG(2, 1) && CONFIG(1));
+            break;
+
+        case 0x0004001000021000LL: // USA MSET
+        case 0x0004001000020000LL: // JPN MSET
+        case 0x0004001000022000LL: // EUR MSET
+        case 0x0004001000026000LL: // CHN MSET
+        case 0x0004001000027000LL: // KOR MSET
+        case 0x0004001000028000LL: // TWN MSET
+            if(CONFIG(4)) settings->values = 1 | (BOOTCONFIG(0, 3) << 1) | (BOOTCONFIG(2, 1) << 3);
+            break;
+
+        case 0x0004013000008002LL: // NS
+            settings->values = MULTICONFIG(1);
+            break;
+
+        case 0x0004013000001702LL: // CFG
+            settings->values = secureInfoExists();
+            break;
+
+        default:
+            if(CONFIG(3) && (progId & 0xFFFFFFF000000000LL) >> 0x24 == 0x0004000)
+            {
+                if(titleHasCodeSection(progId)) return false;
+
+                u8 regionId = 0xFF,
+                   languageId = 0xFF;
+
+                loadTitleLocaleConfig(progId, &regionId, &languageId);
+
+                settings->values = (1 << 16) | (languageId << 8) | regionId;
+            }
+            break;
+    }
+
+    return true;
+}
+
+bool makeCodeCacheKey(codeCacheKey *key, u64 progId, const void *exheader, u32 exheaderSize, u32 codeFileSize)
+{
+    const u8 *bytes = (const u8 *)exheader;
+    u32 hash = 2166136261U;
+
+    for(u32 i = 0; i < exheaderSize; i++) hash = (hash ^ bytes[i]) * 16777619U;
+
+    key->progId = progId;
+    key->exheaderHash = hash;
+    key->codeFileSize = codeFileSize;
+
+    return getPatchSettings(progId, &key->settings);
+}
+
+int findCodeCacheEntry(const codeCacheIndex *index, u64 progId)
+{
+    for(u32 i = 0; i < index->count; i++)
+        if(index->entries[i].progId == progId) return i;
+
+    return -1;
+}
+
+void removeCodeCacheEntry(codeCacheIndex *index, u32 i)
+{
+    index->entries[i] = index->entries[--index->count];
+}
+
+/* Returns whether a title has to go for fileSize more bytes to fit, after taking
+   the least recently launched one out of the index */
+bool evictCodeCacheEntry(codeCacheIndex *index, u32 fileSize, u64 *progId)
+{
+    u32 total = 0,
+        oldest = 0;
+
+    for(u32 i = 0; i < index->count; i++)
+    {
+        total += index->entries[i].fileSize;
+        if(index->entries[i].lastUse < index->entries[oldest].lastUse) oldest = i;
+    }
+
+    if(!index->count || (index->count < CODE_CACHE_MAX_ENTRIES && total + fileSize <= CODE_CACHE_MAX_SIZE)) return false;
+
+    *progId = index->entries[oldest].progId;
+    removeCodeCacheEntry(index, oldest);
+
+    return true;
+}
+
+void getCodeCachePath(char *path, u64 progId)
+{
+    memcpy(path, CODE_CACHE_DIR "/0000000000000000.bin", CODE_CACHE_PATH_SIZE);
+
+    for(char *digit = path + sizeof(CODE_CACHE_DIR) + 15; progId; digit--, progId >>= 4)
+    {
+        static const char hexDigits[] = "0123456789ABCDEF";
+        *digit = hexDigits[(u32)(progId & 0xF)];
+    }
+}
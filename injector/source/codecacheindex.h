@@ -0,0 +1,44 @@
+#pragma once
+
+#include <3ds/types.h>
+#include "patcher.h"
+
+/* What the code cache keys its images on and which ones it drops, without touching the SD.
+   codecache.c reads and writes the files, test/codecachetest.c builds this as is */
+
+#define CODE_CACHE_DIR         "/luma/cache/code"
+#define CODE_CACHE_MAX_ENTRIES 32
+#define CODE_CACHE_MAX_SIZE    (48 << 20)
+#define CODE_CACHE_PATH_SIZE   sizeof(CODE_CACHE_DIR "/0000000000000000.bin")
+
+//Everything the patched code of a title depends on. A cached image is only used if all of it matches
+typedef struct codeCacheKey
+{
+    u64 progId;
+    u32 exheaderHash; //Covers the title version and code layout
+    u32 codeFileSize;
+    patchSettings settings;
+} codeCacheKey;
+
+typedef struct codeCacheEntry
+{
+    u64 progId;
+    u32 fileSize;
+    u32 lastUse;
+} codeCacheEntry;
+
+typedef struct codeCacheIndex
+{
+    char magic[4];
+    u32 version;
+    u32 useCounter;
+    u32 count;
+    codeCacheEntry entries[CODE_CACHE_MAX_ENTRIES];
+} codeCacheIndex;
+
+bool getPatchSettings(u64 progId, patchSettings *settings);
+bool makeCodeCacheKey(codeCacheKey *key, u64 progId, const void *exheader, u32 exheaderSize, u32 codeFileSize);
+int findCodeCacheEntry(const codeCacheIndex *index, u64 progId);
+void removeCodeCacheEntry(codeCacheIndex *index, u32 i);
+bool evictCodeCacheEntry(codeCacheIndex *index, u32 fileSize, u64 *progId);
+void getCodeCachePath(char *path, u64 progId);
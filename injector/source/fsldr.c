@@ -107,3 +107,76 @@ Result FSLDR_OpenFileDirectly(Handle* out, FS_ArchiveID archiveId, FS_Path archi
 
   return cmdbuf[1];
 }
+
+// archive handles are u64s, like libctru's FS_Archive
+Result FSLDR_OpenArchive(u64 *archive, FS_ArchiveID id, FS_Path path)
+{
+  u32 *cmdbuf = getThreadCommandBuffer();
+
+  cmdbuf[0] = IPC_MakeHeader(0x80C,3,2); // 0x80C00C2
+  cmdbuf[1] = id;
+  cmdbuf[2] = path.type;
+  cmdbuf[3] = path.size;
+  cmdbuf[4] = IPC_Desc_StaticBuffer(path.size, 0);
+  cmdbuf[5] = (u32)path.data;
+
+  Result ret = 0;
+  if(R_FAILED(ret = svcSendSyncRequest(fsldrHandle))) return ret;
+
+  if(archive) *archive = cmdbuf[2] | ((u64)cmdbuf[3] << 32);
+
+  return cmdbuf[1];
+}
+
+Result FSLDR_CloseArchive(u64 archive)
+{
+  u32 *cmdbuf = getThreadCommandBuffer();
+
+  cmdbuf[0] = IPC_MakeHeader(0x80E,2,0); // 0x80E0080
+  cmdbuf[1] = (u32)archive;
+  cmdbuf[2] = (u32)(archive >> 32);
+
+  Result ret = 0;
+  if(R_FAILED(ret = svcSendSyncRequest(fsldrHandle))) return ret;
+
+  return cmdbuf[1];
+}
+
+Result FSLDR_DeleteFile(u64 archive, FS_Path path)
+{
+  u32 *cmdbuf = getThreadCommandBuffer();
+
+  cmdbuf[0] = IPC_MakeHeader(0x804,5,2); // 0x8040142
+  cmdbuf[1] = 0;
+  cmdbuf[2] = (u32)archive;
+  cmdbuf[3] = (u32)(archive >> 32);
+  cmdbuf[4] = path.type;
+  cmdbuf[5] = path.size;
+  cmdbuf[6] = IPC_Desc_StaticBuffer(path.size, 0);
+  cmdbuf[7] = (u32)path.data;
+
+  Result ret = 0;
+  if(R_FAILED(ret = svcSendSyncRequest(fsldrHandle))) return ret;
+
+  return cmdbuf[1];
+}
+
+Result FSLDR_CreateDirectory(u64 archive, FS_Path path, u32 attributes)
+{
+  u32 *cmdbuf = getThreadCommandBuffer();
+
+  cmdbuf[0] = IPC_MakeHeader(0x809,6,2); // 0x8090182
+  cmdbuf[1] = 0;
+  cmdbuf[2] = (u32)archive;
+  cmdbuf[3] = (u32)(archive >> 32);
+  cmdbuf[4] = path.type;
+  cmdbuf[5] = path.size;
+  cmdbuf[6] = attributes;
+  cmdbuf[7] = IPC_Desc_StaticBuffer(path.size, 0);
+  cmdbuf[8] = (u32)path.data;
+
+  Result ret = 0;
+  if(R_FAILED(ret = svcSendSyncRequest(fsldrHandle))) return ret;
+
+  return cmdbuf[1];
+}
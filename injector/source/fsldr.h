@@ -7,3 +7,7 @@ void fsldrExit(void);
 Result FSLDR_InitializeWithSdkVersion(Handle session, u32 version);
 Result FSLDR_SetPriority(u32 priority);
 Result FSLDR_OpenFileDirectly(Handle* out, FS_ArchiveID archiveId, FS_Path archivePath, FS_Path filePath, u32 openFlags, u32 attributes);
+Result FSLDR_OpenArchive(u64 *archive, FS_ArchiveID id, FS_Path path);
+Result FSLDR_CloseArchive(u64 archive);
+Result FSLDR_DeleteFile(u64 archive, FS_Path path);
+Result FSLDR_CreateDirectory(u64 archive, FS_Path path, u32 attributes);
\ No newline at end of file
@@ -1,14 +1,18 @@
 #include <3ds.h>
 #include "memory.h"
 #include "patcher.h"
+#include "codecache.h"
 #include "exheader.h"
 #include "ifile.h"
 #include "fsldr.h"
 #include "fsreg.h"
 #include "pxipm.h"
 #include "srvsys.h"
+#include "lzss.h"
 
-#define MAX_SESSIONS 1
+#define MAX_SESSIONS 4
+#define FIRST_SESSION 3 // after the notification, the service and the load worker
+#define EXHEADER_CACHE_SIZE 4
 
 const char CODE_PATH[] = {0x01, 0x00, 0x00, 0x00, 0x2E, 0x63, 0x6F, 0x64, 0x65, 0x00, 0x00, 0x00};
 
@@ -23,76 +27,165 @@ typedef struct
   u32 total_size;
 } prog_addrs_t;
 
-static Handle g_handles[MAX_SESSIONS+2];
+static Handle g_handles[MAX_SESSIONS+FIRST_SESSION];
 static int g_active_handles;
-static u64 g_cached_prog_handle;
-static exheader_header g_exheader;
+
+// exheaders of the last programs asked about, PM often registers a few before loading them
+typedef struct
+{
+  u64 prog_handle; // 0 if unused
+  u32 last_use;
+  exheader_header exheader;
+} exheader_cache_entry;
+
+static exheader_cache_entry g_exheader_cache[EXHEADER_CACHE_SIZE];
+static u32 g_exheader_use_counter;
+static u32 g_exheader_hits[5]; // by command id
+static u32 g_exheader_misses[5];
+static LightLock g_exheader_lock;
+
+// LoadProcess is handed to this, so that the other requests are answered meanwhile.
+// The code is put together at a fixed address, so the loads are done one at a time by it
+typedef struct
+{
+  Handle thread; // 0 if it couldn't be created
+  Handle start;
+  Handle done; // waited on along with the sessions
+  Handle session; // to reply to once done, 0 if it was closed meanwhile
+  int busy;
+  int exit;
+  u64 prog_handle;
+  Handle process;
+  Result res;
+  exheader_header exheader;
+} loader_worker;
+
+// LoadProcess requests waiting for the worker, in order. Each session has at most one
+typedef struct
+{
+  Handle session;
+  u64 prog_handle;
+} pending_load;
+
+static loader_worker g_worker;
+static u64 g_worker_stack[0x1000 / sizeof(u64)];
+static pending_load g_pending_loads[MAX_SESSIONS];
+static int g_pending_count;
 static char g_ret_buf[1024];
 
-static int lzss_decompress(u8 *end)
+#define CODE_BLOCK_SIZE 0x40000
+
+// Compressed code being read from the end in blocks, while another thread decodes what has landed
+typedef struct
 {
-  unsigned int v1; // r1@2
-  u8 *v2; // r2@2
-  u8 *v3; // r3@2
-  u8 *v4; // r1@2
-  char v5; // r5@4
-  char v6; // t1@4
-  signed int v7; // r6@4
-  int v9; // t1@7
-  u8 *v11; // r3@8
-  int v12; // r12@8
-  int v13; // t1@8
-  int v14; // t1@8
-  unsigned int v15; // r7@8
-  int v16; // r12@8
-  int ret;
+  lzss_state lzss;
+  const u8 *volatile read_start; // everything from here to the end of the file is in memory
+  volatile bool aborted; // a read failed, the decoder stops where it is
+  Handle block_read;
+} code_stream;
 
-  ret = 0;
-  if ( end )
+static code_stream g_stream;
+static u64 g_stream_stack[0x1000 / sizeof(u64)];
+
+static void stream_decompress(__attribute__((unused)) void *arg)
+{
+  const u8 *read_start;
+
+  // Decoding writes at or above the current input, never over the blocks still being read
+  do
   {
-    v1 = *((u32 *)end - 2);
-    v2 = &end[*((u32 *)end - 1)];
-    v3 = &end[-(v1 >> 24)];
-    v4 = &end[-(v1 & 0xFFFFFF)];
-    while ( v3 > v4 )
+    svcWaitSynchronization(g_stream.block_read, U64_MAX);
+    if (g_stream.aborted)
     {
-      v6 = *(v3-- - 1);
-      v5 = v6;
-      v7 = 8;
-      while ( 1 )
-      {
-        if ( (v7-- < 1) )
-          break;
-        if ( v5 & 0x80 )
-        {
-          v13 = *(v3 - 1);
-          v11 = v3 - 1;
-          v12 = v13;
-          v14 = *(v11 - 1);
-          v3 = v11 - 1;
-          v15 = ((v14 | (v12 << 8)) & 0xFFFF0FFF) + 2;
-          v16 = v12 + 32;
-          do
-          {
-            ret = v2[v15];
-            *(v2-- - 1) = ret;
-            v16 -= 16;
-          }
-          while ( !(v16 < 0) );
-        }
-        else
-        {
-          v9 = *(v3-- - 1);
-          ret = v9;
-          *(v2-- - 1) = v9;
-        }
-        v5 *= 2;
-        if ( v3 <= v4 )
-          return ret;
-      }
+      svcExitThread();
     }
+
+    read_start = g_stream.read_start;
+    lzss_decode_groups(&g_stream.lzss, read_start > g_stream.lzss.in_start ? read_start : g_stream.lzss.in_start);
+  } while (read_start > g_stream.lzss.in_start);
+
+  lzss_decode_tail(&g_stream.lzss);
+  svcExitThread();
+}
+
+// Reads and decompresses the code, so that the SD/NAND latency overlaps with decoding
+static Result stream_code(IFile *file, u8 *code, u32 size)
+{
+  Handle thread;
+  Result res;
+  s32 priority;
+  u64 total;
+  u32 offset = size > CODE_BLOCK_SIZE ? size - CODE_BLOCK_SIZE : 0;
+
+  // the last block holds the footer
+  file->pos = offset;
+  if (R_FAILED(res = IFile_Read(file, &total, code + offset, size - offset)))
+  {
+    return res;
+  }
+
+  lzss_init(&g_stream.lzss, code + size);
+  g_stream.read_start = code + offset;
+  g_stream.aborted = false;
+
+  // a lower priority than ours, so that each read is issued as soon as the previous one is done
+  svcGetThreadPriority(&priority, CUR_THREAD_HANDLE);
+  if (R_FAILED(svcCreateEvent(&g_stream.block_read, RESET_ONESHOT)))
+  {
+    thread = 0;
   }
-  return ret;
+  else if (R_FAILED(svcCreateThread(&thread, stream_decompress, 0, (u32 *)(g_stream_stack + sizeof(g_stream_stack) / sizeof(u64)), priority + 1, -2)))
+  {
+    svcCloseHandle(g_stream.block_read);
+    thread = 0;
+  }
+  else
+  {
+    svcSignalEvent(g_stream.block_read);
+  }
+
+  while (offset > 0)
+  {
+    u32 len = offset > CODE_BLOCK_SIZE ? CODE_BLOCK_SIZE : offset;
+
+    offset -= len;
+    file->pos = offset;
+    if (R_FAILED(res = IFile_Read(file, &total, code + offset, len)))
+    {
+      g_stream.aborted = true;
+      break;
+    }
+
+    g_stream.read_start = code + offset;
+    if (thread)
+    {
+      svcSignalEvent(g_stream.block_read);
+    }
+  }
+
+  // no thread to spare, decode it all now
+  if (!thread)
+  {
+    if (g_stream.aborted)
+    {
+      return res;
+    }
+
+    lzss_decode_groups(&g_stream.lzss, g_stream.lzss.in_start);
+    lzss_decode_tail(&g_stream.lzss);
+    return 0;
+  }
+
+  // wake the decoder up to see that it has to stop, it only ever waits for the next block
+  if (g_stream.aborted)
+  {
+    svcSignalEvent(g_stream.block_read);
+  }
+
+  svcWaitSynchronization(thread, U64_MAX);
+  svcCloseHandle(thread);
+  svcCloseHandle(g_stream.block_read);
+  return g_stream.aborted ? res : 0;
 }
 
 static Result allocate_shared_mem(prog_addrs_t *shared, prog_addrs_t *vaddr, int flags)
@@ -106,7 +199,7 @@ static Result allocate_shared_mem(prog_addrs_t *shared, prog_addrs_t *vaddr, int
   return svcControlMemory(&dummy, shared->text_addr, 0, shared->total_size << 12, (flags & 0xF00) | MEMOP_ALLOC, MEMPERM_READ | MEMPERM_WRITE);
 }
 
-static Result load_code(u64 progid, prog_addrs_t *shared, u64 prog_handle, int is_compressed)
+static Result load_code(u64 progid, const exheader_header *exheader, prog_addrs_t *shared, u64 prog_handle, int is_compressed)
 {
   IFile file;
   FS_Path archivePath;
@@ -114,6 +207,8 @@ static Result load_code(u64 progid, prog_addrs_t *shared, u64 prog_handle, int i
   Result res;
   u64 size;
   u64 total;
+  codeCacheKey cache_key;
+  int cacheable;
 
   archivePath.type = PATH_BINARY;
   archivePath.data = &prog_handle;
@@ -141,23 +236,48 @@ static Result load_code(u64 progid, prog_addrs_t *shared, u64 prog_handle, int i
     return 0xC900464F;
   }
 
-  // read code
-  res = IFile_Read(&file, &total, (void *)shared->text_addr, size);
-  IFile_Close(&file); // done reading
-  if (R_FAILED(res))
+  // compressed titles are kept decompressed and patched on the SD, keyed by everything that went into them
+  cacheable = is_compressed && makeCodeCacheKey(&cache_key, progid, exheader, sizeof(exheader_header), (u32)size);
+  if (cacheable && loadCachedCode(&cache_key, (u8 *)shared->text_addr, shared->total_size << 12))
   {
-    svcBreak(USERBREAK_ASSERT);
+    IFile_Close(&file);
+    return 0;
   }
 
-  // decompress
-  if (is_compressed)
+  // read and decompress code, in blocks if there's enough of it for that to pay off
+  if (is_compressed && size > CODE_BLOCK_SIZE)
   {
-    lzss_decompress((u8 *)shared->text_addr + size);
+    res = stream_code(&file, (u8 *)shared->text_addr, (u32)size);
+    IFile_Close(&file); // done reading
+    if (R_FAILED(res))
+    {
+      svcBreak(USERBREAK_ASSERT);
+    }
+  }
+  else
+  {
+    res = IFile_Read(&file, &total, (void *)shared->text_addr, size);
+    IFile_Close(&file); // done reading
+    if (R_FAILED(res))
+    {
+      svcBreak(USERBREAK_ASSERT);
+    }
+
+    // decompress
+    if (is_compressed)
+    {
+      lzss_decompress((u8 *)shared->text_addr + size);
+    }
   }
 
   // patch
   patchCode(progid, (u8 *)shared->text_addr, shared->total_size << 12);
 
+  if (cacheable)
+  {
+    saveCachedCode(&cache_key, (u8 *)shared->text_addr, shared->total_size << 12);
+  }
+
   return 0;
 }
 
@@ -185,7 +305,67 @@ static Result loader_GetProgramInfo(exheader_header *exheader, u64 prog_handle)
   }
 }
 
-static Result loader_LoadProcess(Handle *process, u64 prog_handle)
+// Copies the first size bytes of the exheader of prog_handle, asking FS or PXIPM for it only if it's not cached
+static Result get_exheader(void *exheader, u32 size, u64 prog_handle, u16 cmdid)
+{
+  exheader_cache_entry *entry;
+  Result res;
+  int i;
+
+  LightLock_Lock(&g_exheader_lock);
+
+  entry = &g_exheader_cache[0];
+  for (i = 0; i < EXHEADER_CACHE_SIZE; i++)
+  {
+    if (g_exheader_cache[i].prog_handle == prog_handle && prog_handle != 0)
+    {
+      g_exheader_hits[cmdid]++;
+      g_exheader_cache[i].last_use = ++g_exheader_use_counter;
+      memcpy(exheader, &g_exheader_cache[i].exheader, size);
+      LightLock_Unlock(&g_exheader_lock);
+      return 0;
+    }
+
+    // an unused entry, or else the least recently used one
+    if (entry->prog_handle != 0 && (g_exheader_cache[i].prog_handle == 0 || g_exheader_cache[i].last_use < entry->last_use))
+    {
+      entry = &g_exheader_cache[i];
+    }
+  }
+
+  g_exheader_misses[cmdid]++;
+  res = loader_GetProgramInfo(&entry->exheader, prog_handle);
+  if (res < 0)
+  {
+    entry->prog_handle = 0;
+  }
+  else
+  {
+    entry->prog_handle = prog_handle;
+    entry->last_use = ++g_exheader_use_counter;
+    memcpy(exheader, &entry->exheader, size);
+  }
+
+  LightLock_Unlock(&g_exheader_lock);
+  return res;
+}
+
+static void invalidate_exheader(u64 prog_handle)
+{
+  int i;
+
+  LightLock_Lock(&g_exheader_lock);
+  for (i = 0; i < EXHEADER_CACHE_SIZE; i++)
+  {
+    if (g_exheader_cache[i].prog_handle == prog_handle)
+    {
+      g_exheader_cache[i].prog_handle = 0;
+    }
+  }
+  LightLock_Unlock(&g_exheader_lock);
+}
+
+static Result loader_LoadProcess(Handle *process, u64 prog_handle, exheader_header *exheader)
 {
   Result res;
   int count;
@@ -199,23 +379,16 @@ static Result loader_LoadProcess(Handle *process, u64 prog_handle)
   u32 data_mem_size;
   u64 progid;
 
-  // make sure the cached info corrosponds to the current prog_handle
-  if (g_cached_prog_handle != prog_handle)
+  if ((res = get_exheader(exheader, sizeof(exheader_header), prog_handle, 1)) < 0)
   {
-    res = loader_GetProgramInfo(&g_exheader, prog_handle);
-    g_cached_prog_handle = prog_handle;
-    if (res < 0)
-    {
-      g_cached_prog_handle = 0;
-      return res;
-    }
+    return res;
   }
 
   // get kernel flags
   flags = 0;
   for (count = 0; count < 28; count++)
   {
-    desc = g_exheader.arm11kernelcaps.descriptors[count];
+    desc = exheader->arm11kernelcaps.descriptors[count];
     if (0x1FE == desc >> 23)
     {
       flags = desc & 0xF00;
@@ -227,24 +400,26 @@ static Result loader_LoadProcess(Handle *process, u64 prog_handle)
   }
 
   // allocate process memory
-  vaddr.text_addr = g_exheader.codesetinfo.text.address;
-  vaddr.text_size = (g_exheader.codesetinfo.text.codesize + 4095) >> 12;
-  vaddr.ro_addr = g_exheader.codesetinfo.ro.address;
-  vaddr.ro_size = (g_exheader.codesetinfo.ro.codesize + 4095) >> 12;
-  vaddr.data_addr = g_exheader.codesetinfo.data.address;
-  vaddr.data_size = (g_exheader.codesetinfo.data.codesize + 4095) >> 12;
-  data_mem_size = (g_exheader.codesetinfo.data.codesize + g_exheader.codesetinfo.bsssize + 4095) >> 12;
+  vaddr.text_addr = exheader->codesetinfo.text.address;
+  vaddr.text_size = (exheader->codesetinfo.text.codesize + 4095) >> 12;
+  vaddr.ro_addr = exheader->codesetinfo.ro.address;
+  vaddr.ro_size = (exheader->codesetinfo.ro.codesize + 4095) >> 12;
+  vaddr.data_addr = exheader->codesetinfo.data.address;
+  vaddr.data_size = (exheader->codesetinfo.data.codesize + 4095) >> 12;
+  data_mem_size = (exheader->codesetinfo.data.codesize + exheader->codesetinfo.bsssize + 4095) >> 12;
   vaddr.total_size = vaddr.text_size + vaddr.ro_size + vaddr.data_size;
+
+  // the code is put together at a fixed address, one process at a time (see loader_worker)
   if ((res = allocate_shared_mem(&shared_addr, &vaddr, flags)) < 0)
   {
     return res;
   }
 
   // load code
-  progid = g_exheader.arm11systemlocalcaps.programid;
-  if ((res = load_code(progid, &shared_addr, prog_handle, g_exheader.codesetinfo.flags.flag & 1)) >= 0)
+  progid = exheader->arm11systemlocalcaps.programid;
+  if ((res = load_code(progid, exheader, &shared_addr, prog_handle, exheader->codesetinfo.flags.flag & 1)) >= 0)
   {
-    memcpy(&codesetinfo.name, g_exheader.codesetinfo.name, 8);
+    memcpy(&codesetinfo.name, exheader->codesetinfo.name, 8);
     codesetinfo.program_id = progid;
     codesetinfo.text_addr = vaddr.text_addr;
     codesetinfo.text_size = vaddr.text_size;
@@ -258,7 +433,7 @@ static Result loader_LoadProcess(Handle *process, u64 prog_handle)
     res = svcCreateCodeSet(&codeset, &codesetinfo, (void *)shared_addr.text_addr, (void *)shared_addr.ro_addr, (void *)shared_addr.data_addr);
     if (res >= 0)
     {
-      res = svcCreateProcess(process, codeset, g_exheader.arm11kernelcaps.descriptors, count);
+      res = svcCreateProcess(process, codeset, exheader->arm11kernelcaps.descriptors, count);
       svcCloseHandle(codeset);
       if (res >= 0)
       {
@@ -345,7 +520,132 @@ static Result loader_UnregisterProgram(u64 prog_handle)
   }
 }
 
-static void handle_commands(void)
+static void reply_load_process(u32 *cmdbuf, Result res, Handle process)
+{
+  cmdbuf[0] = 0x10042;
+  cmdbuf[1] = res;
+  cmdbuf[2] = 16;
+  cmdbuf[3] = process;
+}
+
+static void worker_main(void *arg)
+{
+  loader_worker *worker = (loader_worker *)arg;
+
+  while (1)
+  {
+    svcWaitSynchronization(worker->start, U64_MAX);
+    if (worker->exit)
+    {
+      break;
+    }
+    worker->res = loader_LoadProcess(&worker->process, worker->prog_handle, &worker->exheader);
+    svcSignalEvent(worker->done);
+  }
+
+  svcExitThread();
+}
+
+static void start_worker(void)
+{
+  s32 priority;
+
+  // a lower priority than the dispatcher, so that it answers the other requests right away
+  svcGetThreadPriority(&priority, CUR_THREAD_HANDLE);
+  if (R_FAILED(svcCreateEvent(&g_worker.start, RESET_ONESHOT)) || R_FAILED(svcCreateEvent(&g_worker.done, RESET_ONESHOT)))
+  {
+    svcBreak(USERBREAK_ASSERT);
+  }
+  g_handles[2] = g_worker.done;
+
+  // without it LoadProcess is handled by the dispatcher like the rest
+  if (R_FAILED(svcCreateThread(&g_worker.thread, worker_main, (u32)&g_worker, (u32 *)(g_worker_stack + sizeof(g_worker_stack) / sizeof(u64)), priority + 1, -2)))
+  {
+    g_worker.thread = 0;
+  }
+}
+
+static void stop_worker(void)
+{
+  if (g_worker.thread)
+  {
+    g_worker.exit = 1;
+    svcSignalEvent(g_worker.start);
+    svcWaitSynchronization(g_worker.thread, U64_MAX);
+    svcCloseHandle(g_worker.thread);
+  }
+  svcCloseHandle(g_worker.start);
+  svcCloseHandle(g_worker.done);
+}
+
+// Hands a LoadProcess request to the worker, or queues it until the worker is done with the previous ones
+static void start_load_process(Handle session, u64 prog_handle)
+{
+  if (g_worker.busy)
+  {
+    g_pending_loads[g_pending_count].session = session;
+    g_pending_loads[g_pending_count].prog_handle = prog_handle;
+    g_pending_count++;
+    return;
+  }
+
+  g_worker.busy = 1;
+  g_worker.session = session;
+  g_worker.prog_handle = prog_handle;
+  svcSignalEvent(g_worker.start);
+}
+
+// Replies to the session the worker was busy with and starts the next queued request,
+// returns the session or 0 if there is none left
+static Handle finish_load_process(void)
+{
+  Handle session = g_worker.session;
+  int i;
+
+  g_worker.busy = 0;
+  if (session)
+  {
+    reply_load_process(getThreadCommandBuffer(), g_worker.res, g_worker.process);
+  }
+  else if (R_SUCCEEDED(g_worker.res))
+  {
+    svcCloseHandle(g_worker.process);
+  }
+
+  if (g_pending_count > 0)
+  {
+    start_load_process(g_pending_loads[0].session, g_pending_loads[0].prog_handle);
+    for (i = 1; i < g_pending_count; i++)
+    {
+      g_pending_loads[i-1] = g_pending_loads[i];
+    }
+    g_pending_count--;
+  }
+  return session;
+}
+
+static void session_closed(Handle session)
+{
+  int i, kept;
+
+  if (g_worker.busy && g_worker.session == session)
+  {
+    g_worker.session = 0;
+  }
+
+  // a queued request of the session is never started
+  for (i = 0, kept = 0; i < g_pending_count; i++)
+  {
+    if (g_pending_loads[i].session != session)
+    {
+      g_pending_loads[kept++] = g_pending_loads[i];
+    }
+  }
+  g_pending_count = kept;
+}
+
+// Returns 1 if the reply is left to the load worker
+static int handle_commands(Handle session)
 {
   FS_ProgramInfo title;
   FS_ProgramInfo update;
@@ -362,11 +662,14 @@ static void handle_commands(void)
   {
     case 1: // LoadProcess
     {
-      res = loader_LoadProcess(&handle, *(u64 *)&cmdbuf[1]);
-      cmdbuf[0] = 0x10042;
-      cmdbuf[1] = res;
-      cmdbuf[2] = 16;
-      cmdbuf[3] = handle;
+      prog_handle = *(u64 *)&cmdbuf[1];
+      if (g_worker.thread)
+      {
+        start_load_process(session, prog_handle);
+        return 1;
+      }
+      res = loader_LoadProcess(&handle, prog_handle, &g_worker.exheader);
+      reply_load_process(cmdbuf, res, handle);
       break;
     }
     case 2: // RegisterProgram
@@ -381,36 +684,35 @@ static void handle_commands(void)
     }
     case 3: // UnregisterProgram
     {
-      if (g_cached_prog_handle == prog_handle)
-      {
-        g_cached_prog_handle = 0;
-      }
+      prog_handle = *(u64 *)&cmdbuf[1];
+      invalidate_exheader(prog_handle);
       cmdbuf[0] = 0x30040;
-      cmdbuf[1] = loader_UnregisterProgram(*(u64 *)&cmdbuf[1]);
+      cmdbuf[1] = loader_UnregisterProgram(prog_handle);
       break;
     }
     case 4: // GetProgramInfo
     {
       prog_handle = *(u64 *)&cmdbuf[1];
-      if (prog_handle != g_cached_prog_handle)
-      {
-        res = loader_GetProgramInfo(&g_exheader, prog_handle);
-        if (res >= 0)
-        {
-          g_cached_prog_handle = prog_handle;
-        }
-        else
-        {
-          g_cached_prog_handle = 0;
-        }
-      }
-      memcpy(&g_ret_buf, &g_exheader, 1024);
+      res = get_exheader(&g_ret_buf, sizeof(g_ret_buf), prog_handle, 4);
       cmdbuf[0] = 0x40042;
       cmdbuf[1] = res;
       cmdbuf[2] = 0x1000002;
       cmdbuf[3] = (u32) &g_ret_buf;
       break;
     }
+    case 0x100: // GetExheaderCacheStats, not in Nintendo's loader
+    {
+      cmdbuf[0] = 0x1000140;
+      cmdbuf[1] = 0;
+      // the load worker updates the counters too, under the same lock
+      LightLock_Lock(&g_exheader_lock);
+      cmdbuf[2] = g_exheader_hits[1];
+      cmdbuf[3] = g_exheader_misses[1];
+      cmdbuf[4] = g_exheader_hits[4];
+      cmdbuf[5] = g_exheader_misses[4];
+      LightLock_Unlock(&g_exheader_lock);
+      break;
+    }
     default: // error
     {
       cmdbuf[0] = 0x40;
@@ -418,6 +720,8 @@ static void handle_commands(void)
       break;
     }
   }
+
+  return 0;
 }
 
 static Result should_terminate(int *term_request)
@@ -501,8 +805,10 @@ int main()
     svcBreak(USERBREAK_ASSERT);
   }
 
-  g_active_handles = 2;
-  g_cached_prog_handle = 0;
+  LightLock_Init(&g_exheader_lock);
+  start_worker();
+
+  g_active_handles = FIRST_SESSION;
   index = 1;
 
   reply_target = 0;
@@ -523,7 +829,7 @@ int main()
       {
         if (index == -1)
         {
-          for (i = 2; i < MAX_SESSIONS+2; i++)
+          for (i = FIRST_SESSION; i < g_active_handles; i++)
           {
             if (g_handles[i] == reply_target)
             {
@@ -532,6 +838,7 @@ int main()
             }
           }
         }
+        session_closed(g_handles[index]);
         svcCloseHandle(g_handles[index]);
         g_handles[index] = g_handles[g_active_handles-1];
         g_active_handles--;
@@ -562,7 +869,7 @@ int main()
           {
             svcBreak(USERBREAK_ASSERT);
           }
-          if (g_active_handles < MAX_SESSIONS+2)
+          if (g_active_handles < MAX_SESSIONS+FIRST_SESSION)
           {
             g_handles[g_active_handles] = handle;
             g_active_handles++;
@@ -573,15 +880,23 @@ int main()
           }
           break;
         }
-        default: // session
+        default:
         {
-          handle_commands();
-          reply_target = g_handles[index];
+          if (index < FIRST_SESSION) // worker done
+          {
+            reply_target = finish_load_process();
+          }
+          else if (!handle_commands(g_handles[index])) // session
+          {
+            reply_target = g_handles[index];
+          }
           break;
         }
       }
     }
-  } while (!term_request || g_active_handles != 2);
+  } while (!term_request || g_active_handles != FIRST_SESSION || g_worker.busy);
+
+  stop_worker();
 
   srvSysUnregisterService("Loader");
   svcCloseHandle(*srv_handle);
@@ -0,0 +1,125 @@
+#pragma once
+
+// The decoder of BLZ-compressed code binaries, also built on the host by lzssbench/.
+// The includer provides u8 and u32
+
+// Unaligned words, the ARM11 handles them in hardware
+typedef struct
+{
+  u32 value;
+} __attribute__((packed)) unaligned_u32;
+
+// Copies a back-reference downwards, byte by byte unless the source is at least a word away
+static inline u8 *lzss_copy_match(u8 *out, const u8 **in)
+{
+  u32 hi = *--*in;
+  u32 lo = *--*in;
+  u32 distance = (((hi << 8) | lo) & 0xFFF) + 3;
+  u32 length = (hi >> 4) + 3;
+
+  if (distance >= 4)
+  {
+    for (; length >= 4; length -= 4)
+    {
+      out -= 4;
+      ((unaligned_u32 *)out)->value = ((const unaligned_u32 *)(out + distance))->value;
+    }
+  }
+
+  for (; length != 0; length--, out--)
+  {
+    out[-1] = out[distance - 1];
+  }
+
+  return out;
+}
+
+static inline u8 *lzss_step(u8 *out, const u8 **in, u32 is_match)
+{
+  if (is_match)
+  {
+    return lzss_copy_match(out, in);
+  }
+
+  *--out = *--*in;
+  return out;
+}
+
+typedef struct
+{
+  u8 *out;
+  const u8 *in;
+  const u8 *in_start;
+} lzss_state;
+
+// Reads the footer of a BLZ-compressed code binary ending at end
+static void lzss_init(lzss_state *state, u8 *end)
+{
+  u32 header = *((u32 *)end - 2);
+  state->out = end + *((u32 *)end - 1);
+  state->in = end - (header >> 24);
+  state->in_start = end - (header & 0xFFFFFF);
+}
+
+// Decodes whole groups as long as all of their input is at or above limit, which can't be below in_start
+static void lzss_decode_groups(lzss_state *state, const u8 *limit)
+{
+  u8 *out = state->out;
+  const u8 *in = state->in;
+
+  // A flag byte covers at most 16 bytes of input, far enough from the limit there is no need to check for it
+  while (in - limit > 16)
+  {
+    u32 flags = *--in;
+
+    // Eight literals, the most common group in code
+    if (flags == 0)
+    {
+      out -= 8;
+      in -= 8;
+      ((unaligned_u32 *)out)[1].value = ((const unaligned_u32 *)in)[1].value;
+      ((unaligned_u32 *)out)->value = ((const unaligned_u32 *)in)->value;
+      continue;
+    }
+
+    out = lzss_step(out, &in, flags & 0x80);
+    out = lzss_step(out, &in, flags & 0x40);
+    out = lzss_step(out, &in, flags & 0x20);
+    out = lzss_step(out, &in, flags & 0x10);
+    out = lzss_step(out, &in, flags & 0x08);
+    out = lzss_step(out, &in, flags & 0x04);
+    out = lzss_step(out, &in, flags & 0x02);
+    out = lzss_step(out, &in, flags & 0x01);
+  }
+
+  state->out = out;
+  state->in = in;
+}
+
+// Decodes the rest, once all of the input is there
+static void lzss_decode_tail(lzss_state *state)
+{
+  u8 *out = state->out;
+  const u8 *in = state->in;
+
+  // The last groups may stop halfway through
+  while (in > state->in_start)
+  {
+    u32 flags = *--in;
+
+    for (u32 i = 0; i < 8 && in > state->in_start; i++, flags <<= 1)
+    {
+      out = lzss_step(out, &in, flags & 0x80);
+    }
+  }
+}
+
+// Decodes a BLZ-compressed code binary in place, from the end towards the start
+static void lzss_decompress(u8 *end)
+{
+  lzss_state state;
+
+  lzss_init(&state, end);
+  lzss_decode_groups(&state, state.in_start);
+  lzss_decode_tail(&state);
+}
@@ -5,6 +5,71 @@ void memcpy(void *dest, const void *src, u32 size)
     u8 *destc = (u8 *)dest;
     const u8 *srcc = (const u8 *)src;
 
-    for(u32 i = 0; i < size; i++)
-        destc[i] = srcc[i];
+    //Whole words can only be moved if both buffers share the same alignment
+    if((((u32)destc ^ (u32)srcc) & 3) == 0)
+    {
+        for(; ((u32)destc & 3) && size; size--)
+            *destc++ = *srcc++;
+
+        u32 *dest32 = (u32 *)destc;
+        const u32 *src32 = (const u32 *)srcc;
+
+#if defined(__arm__) && !defined(__thumb__)
+        //Move 32 bytes per ldm/stm burst
+        for(; size >= 32; size -= 32)
+            __asm__ volatile
+            (
+                "ldmia %1!, {r3-r10}\n\t"
+                "stmia %0!, {r3-r10}\n\t"
+                : "+r"(dest32), "+r"(src32)
+                :
+                : "r3", "r4", "r5", "r6", "r7", "r8", "r9", "r10", "memory"
+            );
+#endif
+
+        for(; size >= 4; size -= 4)
+            *dest32++ = *src32++;
+
+        destc = (u8 *)dest32;
+        srcc = (const u8 *)src32;
+    }
+
+    for(; size; size--)
+        *destc++ = *srcc++;
+}
+
+int memcmp(const void *buf1, const void *buf2, u32 size)
+{
+    const u8 *buf1c = (const u8 *)buf1;
+    const u8 *buf2c = (const u8 *)buf2;
+
+    //Compare whole words while they match, the mismatching one is then resolved bytewise
+    if((((u32)buf1c ^ (u32)buf2c) & 3) == 0)
+    {
+        for(; ((u32)buf1c & 3) && size; size--)
+        {
+            int cmp = *buf1c++ - *buf2c++;
+            if(cmp) return cmp;
+        }
+
+        const u32 *buf1w = (const u32 *)buf1c;
+        const u32 *buf2w = (const u32 *)buf2c;
+
+        for(; size >= 4 && *buf1w == *buf2w; size -= 4)
+        {
+            buf1w++;
+            buf2w++;
+        }
+
+        buf1c = (const u8 *)buf1w;
+        buf2c = (const u8 *)buf2w;
+    }
+
+    for(; size; size--)
+    {
+        int cmp = *buf1c++ - *buf2c++;
+        if(cmp) return cmp;
+    }
+
+    return 0;
 }
\ No newline at end of file
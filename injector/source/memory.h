@@ -2,4 +2,5 @@
 
 #include <3ds/types.h>
 
-void memcpy(void *dest, const void *src, u32 size);
\ No newline at end of file
+void memcpy(void *dest, const void *src, u32 size);
+int memcmp(const void *buf1, const void *buf2, u32 size);
\ No newline at end of file
@@ -0,0 +1,2 @@
+//The pattern scanner and patch tables are shared with the ARM9 build
+#include "../../source/patchengine.c"
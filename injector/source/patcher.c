@@ -5,69 +5,6 @@
 
 static CFWInfo info;
 
-static int memcmp(const void *buf1, const void *buf2, u32 size)
-{
-    const u8 *buf1c = (const u8 *)buf1;
-    const u8 *buf2c = (const u8 *)buf2;
-
-    for(u32 i = 0; i < size; i++)
-    {
-        int cmp = buf1c[i] - buf2c[i];
-        if(cmp) return cmp;
-    }
-
-    return 0;
-}
-
-//Quick Search algorithm, adapted from http://igm.univ-mlv.fr/~lecroq/string/node19.html#SECTION00190
-static u8 *memsearch(u8 *startPos, const void *pattern, u32 size, u32 patternSize)
-{
-    const u8 *patternc = (const u8 *)pattern;
-
-    //Preprocessing
-    u32 table[256];
-
-    for(u32 i = 0; i < 256; ++i)
-        table[i] = patternSize + 1;
-    for(u32 i = 0; i < patternSize; ++i)
-        table[patternc[i]] = patternSize - i;
-
-    //Searching
-    u32 j = 0;
-
-    while(j <= size - patternSize)
-    {
-        if(memcmp(patternc, startPos + j, patternSize) == 0)
-            return startPos + j;
-        j += table[startPos[j + patternSize]];
-    }
-
-    return NULL;
-}
-
-static u32 patchMemory(u8 *start, u32 size, const void *pattern, u32 patSize, int offset, const void *replace, u32 repSize, u32 count)
-{
-    u32 i;
-
-    for(i = 0; i < count; i++)
-    {
-        u8 *found = memsearch(start, pattern, size, patSize);
-
-        if(found == NULL) break;
-
-        memcpy(found + offset, replace, repSize);
-
-        u32 at = (u32)(found - start);
-
-        if(at + patSize > size) break;
-
-        size -= at + patSize;
-        start = found + patSize;
-    }
-
-    return i;
-}
-
 static inline size_t strnlen(const char *string, size_t maxlen)
 {
     size_t size;
@@ -106,7 +43,14 @@ static void loadCFWInfo(void)
     }
 }
 
-static bool secureInfoExists(void)
+const CFWInfo *getCFWInfo(void)
+{
+    loadCFWInfo();
+
+    return &info;
+}
+
+bool secureInfoExists(void)
 {
     static bool exists = false;
 
@@ -133,7 +77,7 @@ static void progIdToStr(char *strEnd, u64 progId)
     }
 }
 
-static void loadTitleCodeSection(u64 progId, u8 *code, u32 size)
+static Result openTitleCodeSection(IFile *file, u64 progId)
 {
     /* Here we look for "/luma/code_sections/[u64 titleID in hex, uppercase].bin"
        If it exists it should be a decompressed binary code file */
@@ -141,8 +85,24 @@ static void loadTitleCodeSection(u64 progId, u8 *code, u32 size)
     char path[] = "/luma/code_sections/0000000000000000.bin";
     progIdToStr(path + 35, progId);
 
+    return fileOpen(file, ARCHIVE_SDMC, path, FS_OPEN_READ);
+}
+
+bool titleHasCodeSection(u64 progId)
+{
     IFile file;
-    Result ret = fileOpen(&file, ARCHIVE_SDMC, path, FS_OPEN_READ);
+
+    if(R_FAILED(openTitleCodeSection(&file, progId))) return false;
+
+    IFile_Close(&file);
+
+    return true;
+}
+
+static void loadTitleCodeSection(u64 progId, u8 *code, u32 size)
+{
+    IFile file;
+    Result ret = openTitleCodeSection(&file, progId);
 
     if(R_SUCCEEDED(ret))
     {
@@ -158,7 +118,7 @@ static void loadTitleCodeSection(u64 progId, u8 *code, u32 size)
     }
 }
 
-static int loadTitleLocaleConfig(u64 progId, u8 *regionId, u8 *languageId)
+int loadTitleLocaleConfig(u64 progId, u8 *regionId, u8 *languageId)
 {
     /* Here we look for "/luma/locales/[u64 titleID in hex, uppercase].txt"
        If it exists it should contain, for example, "EUR IT" */
@@ -315,6 +275,7 @@ static void patchCfgGetRegion(u8 *code, u32 size, u8 regionId, u32 CFGUHandleOff
     }
 }
 
+//Anything else this depends on has to be summed up by getPatchSettings in codecacheindex.c too, for the code cache
 void patchCode(u64 progId, u8 *code, u32 size)
 {
     loadCFWInfo();
@@ -335,13 +296,13 @@ void patchCode(u64 progId, u8 *code, u32 size)
                 0x01, 0x00, 0xA0, 0xE3, 0x1E, 0xFF, 0x2F, 0xE1
             };
 
-            //Patch SMDH region checks
-            patchMemory(code, size, 
-                regionFreePattern, 
-                sizeof(regionFreePattern), -16, 
-                regionFreePatch, 
-                sizeof(regionFreePatch), 1
-            );
+            static const patchDescriptor patches[] = {
+                //Patch SMDH region checks
+                {{regionFreePattern, NULL, sizeof(regionFreePattern)}, -16, regionFreePatch, sizeof(regionFreePatch), 1, NULL, RELOC_NONE}
+            };
+            static patchTable table = PATCH_TABLE(patches);
+
+            applyPatches(code, size, &table, 1, NULL, NULL);
 
             break;
         }
@@ -355,32 +316,26 @@ void patchCode(u64 progId, u8 *code, u32 size)
                 0xE3, 0xA0
             };
 
-            //Block silent auto-updates
-            patchMemory(code, size, 
-                blockAutoUpdatesPattern, 
-                sizeof(blockAutoUpdatesPattern), 0, 
-                blockAutoUpdatesPatch, 
-                sizeof(blockAutoUpdatesPatch), 1
-            );
+            static const u8 skipEshopUpdateCheckPattern[] = {
+                0x30, 0xB5, 0xF1, 0xB0
+            };
+            static const u8 skipEshopUpdateCheckPatch[] = {
+                0x00, 0x20, 0x08, 0x60, 0x70, 0x47
+            };
 
-            //Apply only if the updated NAND hasn't been booted
-            if((BOOTCONFIG(0, 3) != 0) == (BOOTCONFIG(2, 1) && CONFIG(1)))
-            {
-                static const u8 skipEshopUpdateCheckPattern[] = {
-                    0x30, 0xB5, 0xF1, 0xB0
-                };
-                static const u8 skipEshopUpdateCheckPatch[] = {
-                    0x00, 0x20, 0x08, 0x60, 0x70, 0x47
-                };
+            static const patchDescriptor patches[] = {
+                //Block silent auto-updates
+                {{blockAutoUpdatesPattern, NULL, sizeof(blockAutoUpdatesPattern)}, 0, blockAutoUpdatesPatch, sizeof(blockAutoUpdatesPatch), 1, NULL, RELOC_NONE},
 
                 //Skip update checks to access the EShop
-                patchMemory(code, size, 
-                    skipEshopUpdateCheckPattern, 
-                    sizeof(skipEshopUpdateCheckPattern), 0, 
-                    skipEshopUpdateCheckPatch, 
-                    sizeof(skipEshopUpdateCheckPatch), 1
-                );
-            }
+                {{skipEshopUpdateCheckPattern, NULL, sizeof(skipEshopUpdateCheckPattern)}, 0, skipEshopUpdateCheckPatch, sizeof(skipEshopUpdateCheckPatch), 1, NULL, RELOC_NONE}
+            };
+            static patchTable table = PATCH_TABLE(patches);
+
+            //Skip the update checks only if the updated NAND hasn't been booted
+            bool skipUpdateChecks = (BOOTCONFIG(0, 3) != 0) == (BOOTCONFIG(2, 1) && CONFIG(1));
+
+            applyPatches(code, size, &table, 1 | ((u32)skipUpdateChecks << 1), NULL, NULL);
 
             break;
         }
@@ -391,12 +346,19 @@ void patchCode(u64 progId, u8 *code, u32 size)
                 0xE0, 0x1E, 0xFF, 0x2F, 0xE1, 0x01, 0x01, 0x01
             };
             
+            //The version byte is past the pattern
+            static const patchDescriptor patches[] = {
+                {{fpdVerPattern, NULL, sizeof(fpdVerPattern)}, 9, NULL, 0, 1, NULL, RELOC_NONE}
+            };
+            static patchTable table = PATCH_TABLE(patches);
+
             static const u8 mostRecentFpdVer = 0x06;
-            
-            u8 *fpdVer = memsearch(code, fpdVerPattern, size, sizeof(fpdVerPattern));
+
+            u8 *fpdVer;
+            applyPatches(code, size, &table, 1, NULL, &fpdVer);
 
             //Allow online access to work with old friends modules, without breaking newer firmwares
-            if(fpdVer != NULL && fpdVer[9] < mostRecentFpdVer) fpdVer[9] = mostRecentFpdVer;
+            if(fpdVer != NULL && *fpdVer < mostRecentFpdVer) *fpdVer = mostRecentFpdVer;
 
             break;
         }
@@ -414,14 +376,19 @@ void patchCode(u64 progId, u8 *code, u32 size)
                 const u32 currentNand = BOOTCONFIG(0, 3);
                 const u32 matchingFirm = BOOTCONFIG(2, 1) == (currentNand != 0);
 
+                static const patchDescriptor patches[] = {
+                    {{verPattern, NULL, sizeof(verPattern) - sizeof(u16)}, 0, NULL, 0, 1, NULL, RELOC_NONE}
+                };
+                static patchTable table = PATCH_TABLE(patches);
+
+                const u16 *verString = !currentNand ? ((matchingFirm) ? u" Sys" : u"SysE") :
+                                                      ((currentNand == 1) ? (matchingFirm ? u" Emu" : u"EmuS") :
+                                                       (currentNand == 2) ? (matchingFirm ? u"Emu2" : u"Em2S") : (matchingFirm ? u"Emu3" : u"Em3S"));
+                u8 *verPos;
+
                 //Patch Ver. string
-                patchMemory(code, size,
-                    verPattern,
-                    sizeof(verPattern) - sizeof(u16), 0,
-                    !currentNand ? ((matchingFirm) ? u" Sys" : u"SysE") :
-                                   ((currentNand == 1) ? (matchingFirm ? u" Emu" : u"EmuS") : ((matchingFirm) ? u"Emu2" : u"Em2S")),
-                    sizeof(verPattern) - sizeof(u16), 1
-                );
+                applyPatches(code, size, &table, 1, NULL, &verPos);
+                if(verPos != NULL) memcpy(verPos, verString, sizeof(verPattern) - sizeof(u16));
             }
 
             break;
@@ -436,23 +403,27 @@ void patchCode(u64 progId, u8 *code, u32 size)
                 0x0B, 0x18, 0x21, 0xC8
             };
 
-            //Disable updates from foreign carts (makes carts region-free)
-            patchMemory(code, size, 
-                stopCartUpdatesPattern, 
-                sizeof(stopCartUpdatesPattern), 0, 
-                stopCartUpdatesPatch,
-                sizeof(stopCartUpdatesPatch), 2
-            );
+            static const u8 cfgN3dsCpuPattern[] = {
+                0x00, 0x40, 0xA0, 0xE1, 0x07, 0x00
+            };
+
+            static const patchDescriptor patches[] = {
+                //Disable updates from foreign carts (makes carts region-free)
+                {{stopCartUpdatesPattern, NULL, sizeof(stopCartUpdatesPattern)}, 0, stopCartUpdatesPatch, sizeof(stopCartUpdatesPatch), 2, NULL, RELOC_NONE},
+
+                //N3DS CPU Clock and L2 cache setting
+                {{cfgN3dsCpuPattern, NULL, sizeof(cfgN3dsCpuPattern)}, 0, NULL, 0, 1, NULL, RELOC_NONE}
+            };
+            static patchTable table = PATCH_TABLE(patches);
 
             u32 cpuSetting = MULTICONFIG(1);
+            u8 *matches[2];
+
+            applyPatches(code, size, &table, 1 | ((cpuSetting != 0) << 1), NULL, matches);
 
             if(cpuSetting)
             {
-                static const u8 cfgN3dsCpuPattern[] = {
-                    0x00, 0x40, 0xA0, 0xE1, 0x07, 0x00
-                };
-
-                u32 *cfgN3dsCpuLoc = (u32 *)memsearch(code, cfgN3dsCpuPattern, size, sizeof(cfgN3dsCpuPattern));
+                u32 *cfgN3dsCpuLoc = (u32 *)matches[1];
 
                 //Patch N3DS CPU Clock and L2 cache setting
                 if(cfgN3dsCpuLoc != NULL)
@@ -474,28 +445,20 @@ void patchCode(u64 progId, u8 *code, u32 size)
                 0x00, 0x26
             };
 
-            //Disable SecureInfo signature check
-            patchMemory(code, size, 
-                secureinfoSigCheckPattern, 
-                sizeof(secureinfoSigCheckPattern), 0, 
-                secureinfoSigCheckPatch, 
-                sizeof(secureinfoSigCheckPatch), 1
-            );
+            static const u16 secureinfoFilenamePattern[] = u"SecureInfo_";
+            static const u16 secureinfoFilenamePatch[] = u"C";
 
-            if(secureInfoExists())
-            {
-                static const u16 secureinfoFilenamePattern[] = u"SecureInfo_";
-                static const u16 secureinfoFilenamePatch[] = u"C";
+            static const patchDescriptor patches[] = {
+                //Disable SecureInfo signature check
+                {{secureinfoSigCheckPattern, NULL, sizeof(secureinfoSigCheckPattern)}, 0, secureinfoSigCheckPatch, sizeof(secureinfoSigCheckPatch), 1, NULL, RELOC_NONE},
 
                 //Use SecureInfo_C
-                patchMemory(code, size, 
-                    secureinfoFilenamePattern, 
-                    sizeof(secureinfoFilenamePattern) - sizeof(u16),
-                    sizeof(secureinfoFilenamePattern) - sizeof(u16), 
-                    secureinfoFilenamePatch, 
-                    sizeof(secureinfoFilenamePatch) - sizeof(u16), 2
-                );
-            }
+                {{secureinfoFilenamePattern, NULL, sizeof(secureinfoFilenamePattern) - sizeof(u16)}, sizeof(secureinfoFilenamePattern) - sizeof(u16),
+                 secureinfoFilenamePatch, sizeof(secureinfoFilenamePatch) - sizeof(u16), 2, NULL, RELOC_NONE}
+            };
+            static patchTable table = PATCH_TABLE(patches);
+
+            applyPatches(code, size, &table, 1 | ((u32)secureInfoExists() << 1), NULL, NULL);
 
             break;
         }
@@ -516,28 +479,17 @@ void patchCode(u64 progId, u8 *code, u32 size)
                 0x00, 0x00, 0xA0, 0xE3, 0x1E, 0xFF, 0x2F, 0xE1 // mov r0, #0; bx lr
             };
             
-            //Disable CRR0 signature (RSA2048 with SHA256) check
-            patchMemory(code, size, 
-                sigCheckPattern, 
-                sizeof(sigCheckPattern), 0, 
-                stub,
-                sizeof(stub), 1
-            );
-            
-            //Disable CRO0/CRR0 SHA256 hash checks (section hashes, and hash table)
-            patchMemory(code, size, 
-                sha256ChecksPattern1, 
-                sizeof(sha256ChecksPattern1), 0, 
-                stub,
-                sizeof(stub), 1
-            );
-            
-            patchMemory(code, size, 
-                sha256ChecksPattern2, 
-                sizeof(sha256ChecksPattern2), 0, 
-                stub,
-                sizeof(stub), 1
-            );
+            static const patchDescriptor patches[] = {
+                //Disable CRR0 signature (RSA2048 with SHA256) check
+                {{sigCheckPattern, NULL, sizeof(sigCheckPattern)}, 0, stub, sizeof(stub), 1, NULL, RELOC_NONE},
+
+                //Disable CRO0/CRR0 SHA256 hash checks (section hashes, and hash table)
+                {{sha256ChecksPattern1, NULL, sizeof(sha256ChecksPattern1)}, 0, stub, sizeof(stub), 1, NULL, RELOC_NONE},
+                {{sha256ChecksPattern2, NULL, sizeof(sha256ChecksPattern2)}, 0, stub, sizeof(stub), 1, NULL, RELOC_NONE}
+            };
+            static patchTable table = PATCH_TABLE(patches);
+
+            applyPatches(code, size, &table, 7, NULL, NULL);
             
             break;
         }
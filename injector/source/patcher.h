@@ -1,6 +1,7 @@
 #pragma once
 
 #include <3ds/types.h>
+#include "../../source/patchengine.h"
 
 #define PATH_MAX 255
 
@@ -22,4 +23,17 @@ typedef struct __attribute__((packed))
     u32 config;
 } CFWInfo;
 
-void patchCode(u64 progId, u8 *code, u32 size);
\ No newline at end of file
+//Everything patchCode's result depends on, besides the code
+typedef struct patchSettings
+{
+    u32 commitHash; //Patches change between Luma3DS builds
+    u32 values;     //Title specific
+} patchSettings;
+
+void patchCode(u64 progId, u8 *code, u32 size);
+
+//What getPatchSettings looks up
+const CFWInfo *getCFWInfo(void);
+bool secureInfoExists(void);
+bool titleHasCodeSection(u64 progId);
+int loadTitleLocaleConfig(u64 progId, u8 *regionId, u8 *languageId);
\ No newline at end of file
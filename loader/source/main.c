@@ -22,14 +22,22 @@
 
 #include "memory.h"
 #include "cache.h"
+#include "../../source/lz4.h"
 
 extern u32 payloadSize; //Defined in start.s
 
+//Keep in sync with source/fs.h, "PAYZ" followed by the decompressed size
+#define PAYLOAD_MAGIC 0x5A594150
+
 void main(void)
 {
     void *payloadAddress = (void *)0x23F00000;
+    const u32 *payload = (const u32 *)0x24F00000;
 
-    memcpy(payloadAddress, (void*)0x24F00000, payloadSize);
+    //Compressed payloads are decoded straight to where they run, loadPayload already checked the size
+    if(payloadSize > 8 && payload[0] == PAYLOAD_MAGIC)
+        decompressLZ4(payloadAddress, payload[1], (const u8 *)(payload + 2), payloadSize - 8);
+    else memcpy(payloadAddress, payload, payloadSize);
 
     flushCaches();
     
@@ -32,6 +32,35 @@ void memcpy(void *dest, const void *src, u32 size)
     u8 *destc = (u8 *)dest;
     const u8 *srcc = (const u8 *)src;
 
-    for(u32 i = 0; i < size; i++)
-        destc[i] = srcc[i];
+    //Whole words can only be moved if both buffers share the same alignment
+    if((((u32)destc ^ (u32)srcc) & 3) == 0)
+    {
+        for(; ((u32)destc & 3) && size; size--)
+            *destc++ = *srcc++;
+
+        u32 *dest32 = (u32 *)destc;
+        const u32 *src32 = (const u32 *)srcc;
+
+#if defined(__arm__) && !defined(__thumb__)
+        //Move 32 bytes per ldm/stm burst
+        for(; size >= 32; size -= 32)
+            __asm__ volatile
+            (
+                "ldmia %1!, {r3-r10}\n\t"
+                "stmia %0!, {r3-r10}\n\t"
+                : "+r"(dest32), "+r"(src32)
+                :
+                : "r3", "r4", "r5", "r6", "r7", "r8", "r9", "r10", "memory"
+            );
+#endif
+
+        for(; size >= 4; size -= 4)
+            *dest32++ = *src32++;
+
+        destc = (u8 *)dest32;
+        srcc = (const u8 *)src32;
+    }
+
+    for(; size; size--)
+        *destc++ = *srcc++;
 }
\ No newline at end of file
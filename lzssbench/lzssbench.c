@@ -0,0 +1,545 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+typedef uint8_t u8;
+typedef uint32_t u32;
+
+#define MIN_MATCH        3
+#define MAX_MATCH        18
+#define MIN_DISTANCE     3
+#define MAX_DISTANCE     0x1002
+#define HASH_BITS        15
+#define CHAIN_DEPTH      64
+#define BENCHMARK_ROUNDS 20
+#define CODE_BLOCK_SIZE  0x40000 //Same as in load_code
+#define READ_LATENCY     0.001   //Seconds per read request
+#define ARM11_SLOWDOWN   20      //Roughly how much slower the 268 MHz ARM11 decodes than a desktop CPU
+
+//The decoder before the rewrite, as decompiled from Nintendo's loader. Only the pointer
+//subtractions are written differently, the original ones rely on 32-bit pointers
+static int referenceDecompress(u8 *end)
+{
+  unsigned int v1; // r1@2
+  u8 *v2; // r2@2
+  u8 *v3; // r3@2
+  u8 *v4; // r1@2
+  char v5; // r5@4
+  char v6; // t1@4
+  signed int v7; // r6@4
+  int v9; // t1@7
+  u8 *v11; // r3@8
+  int v12; // r12@8
+  int v13; // t1@8
+  int v14; // t1@8
+  unsigned int v15; // r7@8
+  int v16; // r12@8
+  int ret;
+
+  ret = 0;
+  if ( end )
+  {
+    v1 = *((u32 *)end - 2);
+    v2 = &end[*((u32 *)end - 1)];
+    v3 = end - (v1 >> 24);
+    v4 = end - (v1 & 0xFFFFFF);
+    while ( v3 > v4 )
+    {
+      v6 = *(v3-- - 1);
+      v5 = v6;
+      v7 = 8;
+      while ( 1 )
+      {
+        if ( (v7-- < 1) )
+          break;
+        if ( v5 & 0x80 )
+        {
+          v13 = *(v3 - 1);
+          v11 = v3 - 1;
+          v12 = v13;
+          v14 = *(v11 - 1);
+          v3 = v11 - 1;
+          v15 = ((v14 | (v12 << 8)) & 0xFFFF0FFF) + 2;
+          v16 = v12 + 32;
+          do
+          {
+            ret = v2[v15];
+            *(v2-- - 1) = ret;
+            v16 -= 16;
+          }
+          while ( !(v16 < 0) );
+        }
+        else
+        {
+          v9 = *(v3-- - 1);
+          ret = v9;
+          *(v2-- - 1) = v9;
+        }
+        v5 *= 2;
+        if ( v3 <= v4 )
+          return ret;
+      }
+    }
+  }
+  return ret;
+}
+
+//The injector's decoder
+#include "../injector/source/lzss.h"
+
+static void *allocate(u32 size)
+{
+    void *buf = malloc(size ? size : 1);
+    if(buf == NULL)
+    {
+        printf("Out of memory\n");
+        exit(1);
+    }
+
+    return buf;
+}
+
+static void write32(u8 *buf, u32 value)
+{
+    buf[0] = value;
+    buf[1] = value >> 8;
+    buf[2] = value >> 16;
+    buf[3] = value >> 24;
+}
+
+static u32 hash(const u8 *pos)
+{
+    return ((pos[0] << 16 | pos[1] << 8 | pos[2]) * 2654435761U) >> (32 - HASH_BITS);
+}
+
+/* Reference BLZ encoder, like the one in the SDK tools: the code is compressed backwards so that it
+   can be decoded in place, and the start is left raw where decoding it in place would overwrite
+   input not read yet. Returns the file size, out must hold size * 9 / 8 + 16 bytes */
+static u32 compressBLZ(u8 *out, const u8 *in, u32 size)
+{
+    u8 *reversed = allocate(size),
+       *stream = allocate(size + size / 8 + 1);
+    u32 *head = allocate(sizeof(u32) << HASH_BITS),
+        *chain = allocate(size * sizeof(u32) + 1);
+
+    for(u32 i = 0; i < size; i++) reversed[i] = in[size - 1 - i];
+    memset(head, 0xFF, sizeof(u32) << HASH_BITS);
+
+    //Best place to stop compressing, as decoded bytes and stream bytes up to there
+    u32 streamSize = 0,
+        flagPos = 0,
+        bestRaw = 0,
+        bestStream = 0;
+    int bestSaving = 0;
+
+    for(u32 pos = 0, op = 0; pos < size; op++)
+    {
+        if(op % 8 == 0)
+        {
+            flagPos = streamSize++;
+            stream[flagPos] = 0;
+        }
+
+        u32 bestLength = 0,
+            bestDistance = 0;
+
+        if(pos + MIN_MATCH <= size)
+        {
+            u32 depth = CHAIN_DEPTH;
+
+            for(u32 candidate = head[hash(reversed + pos)]; candidate != 0xFFFFFFFF && depth--; candidate = chain[candidate])
+            {
+                u32 distance = pos - candidate;
+                if(distance > MAX_DISTANCE) break;
+                if(distance < MIN_DISTANCE) continue;
+
+                u32 length = 0;
+                while(length < MAX_MATCH && pos + length < size && reversed[candidate + length] == reversed[pos + length]) length++;
+
+                if(length > bestLength)
+                {
+                    bestLength = length;
+                    bestDistance = distance;
+                    if(length == MAX_MATCH) break;
+                }
+            }
+        }
+
+        u32 advance = bestLength >= MIN_MATCH ? bestLength : 1;
+
+        if(bestLength >= MIN_MATCH)
+        {
+            u32 field = ((bestLength - MIN_MATCH) << 12) | (bestDistance - MIN_DISTANCE);
+
+            stream[flagPos] |= 0x80 >> (op % 8);
+            stream[streamSize++] = field >> 8;
+            stream[streamSize++] = field;
+        }
+        else stream[streamSize++] = reversed[pos];
+
+        for(u32 i = 0; i < advance; i++, pos++)
+            if(pos + MIN_MATCH <= size)
+            {
+                u32 h = hash(reversed + pos);
+                chain[pos] = head[h];
+                head[h] = pos;
+            }
+
+        //The output always stays above the input left to read as long as the saving only grows
+        int saving = (int)pos - (int)streamSize;
+        if(saving > bestSaving)
+        {
+            bestSaving = saving;
+            bestRaw = pos;
+            bestStream = streamSize;
+        }
+    }
+
+    u32 rawSize = size - bestRaw,
+        padding = (4 - (rawSize + bestStream) % 4) % 4,
+        fileSize = rawSize + bestStream + padding + 8;
+
+    memcpy(out, in, rawSize);
+    for(u32 i = 0; i < bestStream; i++) out[rawSize + i] = stream[bestStream - 1 - i];
+    memset(out + rawSize + bestStream, 0xFF, padding);
+
+    write32(out + fileSize - 8, ((padding + 8) << 24) | (bestStream + padding + 8));
+    write32(out + fileSize - 4, size - fileSize);
+
+    free(reversed);
+    free(stream);
+    free(head);
+    free(chain);
+
+    return fileSize;
+}
+
+//Something like a code binary: instruction words from a small set with varying fields, then strings and tables
+static void generateCode(u8 *buf, u32 size, u32 seed)
+{
+    static const u32 opcodes[] = {
+        0xE92D4000, 0xE8BD8000, 0xE1A00000, 0xE3A00000, 0xE5900000, 0xE5800000, 0xE2800000, 0xE3500000,
+        0x0A000000, 0x1A000000, 0xEB000000, 0xE12FFF1E, 0xE59F0000, 0xE0800000, 0xE1500000, 0xEF000000
+    };
+    static const char *strings[] = {"%s: failed with 0x%08X\n", "rom:/", "data:/save", "Allocation failed", "OK"};
+
+    srand(seed);
+
+    u32 codeSize = size / 4 * 3 & ~3,
+        pos = 0;
+
+    for(; pos < codeSize; pos += 4)
+    {
+        u32 word = opcodes[rand() % 16];
+
+        //Registers and immediates, branches get mostly short offsets
+        if((word & 0x0E000000) == 0x0A000000) word |= ((rand() % 64) - 32) & 0xFFFFFF;
+        else if(rand() % 4) word |= (rand() % 4) << 12 | (rand() % 4) << 16 | (rand() % 8) << 2;
+        else word |= rand() & 0xFFF;
+
+        write32(buf + pos, word);
+    }
+
+    while(pos < size)
+    {
+        if(rand() % 3)
+        {
+            const char *string = strings[rand() % 5];
+            for(u32 i = 0; string[i] && pos < size; i++) buf[pos++] = string[i];
+            if(pos < size) buf[pos++] = 0;
+        }
+        else for(u32 i = 0; i < 16 && pos < size; i++) buf[pos++] = i % 4 ? 0 : (u8)rand();
+    }
+}
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+//Decodes in place like load_code does, returns the time spent decoding
+static double decode(void (*decompress)(u8 *), u8 *buf, const u8 *file, u32 fileSize, u32 size)
+{
+    memcpy(buf, file, fileSize);
+    memset(buf + fileSize, 0xCC, size - fileSize);
+
+    double start = now();
+    decompress(buf + fileSize);
+
+    return now() - start;
+}
+
+static void reference(u8 *end)
+{
+    referenceDecompress(end);
+}
+
+static int check(const char *name, const u8 *code, u32 size, int benchmark)
+{
+    u8 *file = allocate(size + size / 8 + 16),
+       *referenceOut = allocate(size + size / 8 + 16),
+       *testOut = allocate(size + size / 8 + 16);
+    u32 fileSize = compressBLZ(file, code, size);
+    int failed = 0;
+
+    //The injector only decodes code that got smaller
+    if(fileSize >= size) goto done;
+
+    decode(reference, referenceOut, file, fileSize, size);
+    decode(lzss_decompress, testOut, file, fileSize, size);
+
+    if(memcmp(referenceOut, code, size) != 0)
+    {
+        printf("%s: the reference encoder or decoder is broken\n", name);
+        failed = 1;
+    }
+    else if(memcmp(testOut, referenceOut, size) != 0)
+    {
+        u32 i = 0;
+        while(testOut[i] == referenceOut[i]) i++;
+
+        printf("%s: mismatch at byte 0x%X of 0x%X, %02X instead of %02X\n", name, i, size, testOut[i], referenceOut[i]);
+        failed = 1;
+    }
+    else if(benchmark)
+    {
+        double referenceTime = 0,
+               testTime = 0;
+
+        for(u32 i = 0; i < BENCHMARK_ROUNDS; i++)
+        {
+            referenceTime += decode(reference, referenceOut, file, fileSize, size);
+            testTime += decode(lzss_decompress, testOut, file, fileSize, size);
+        }
+
+        referenceTime = referenceTime * 1000 / BENCHMARK_ROUNDS;
+        testTime = testTime * 1000 / BENCHMARK_ROUNDS;
+
+        printf("%s: 0x%X -> 0x%X bytes, %.3f ms per decode before, %.3f ms after (%.1fx)\n", name, size, fileSize,
+               referenceTime, testTime, testTime > 0 ? referenceTime / testTime : 0);
+    }
+
+done:
+    free(file);
+    free(referenceOut);
+    free(testOut);
+
+    return failed;
+}
+
+/* Simulated SD/NAND: a read takes READ_LATENCY plus the transfer time at the given bandwidth,
+   during which the CPU is free like while FS waits for the hardware */
+static double bandwidth;
+
+static void readFile(u8 *dest, const u8 *file, u32 offset, u32 len)
+{
+    double delay = READ_LATENCY + len / bandwidth;
+    struct timespec ts = {(time_t)delay, (long)((delay - (time_t)delay) * 1e9)};
+
+    nanosleep(&ts, NULL);
+    memcpy(dest + offset, file + offset, len);
+}
+
+//Stretches the decoding done since start to the time it would take on the ARM11
+static void decodedSince(double start)
+{
+    double end = start + (now() - start) * ARM11_SLOWDOWN;
+    while(now() < end);
+}
+
+//One-shot event like the kernel's
+typedef struct
+{
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    int signaled;
+} event;
+
+static void signalEvent(event *e)
+{
+    pthread_mutex_lock(&e->mutex);
+    e->signaled = 1;
+    pthread_cond_signal(&e->cond);
+    pthread_mutex_unlock(&e->mutex);
+}
+
+static void waitEvent(event *e)
+{
+    pthread_mutex_lock(&e->mutex);
+    while(!e->signaled) pthread_cond_wait(&e->cond, &e->mutex);
+    e->signaled = 0;
+    pthread_mutex_unlock(&e->mutex);
+}
+
+//Keep in sync with stream_code in injector/source/loader.c
+static struct
+{
+    lzss_state lzss;
+    const u8 *volatile readStart;
+    event blockRead;
+} stream = {.blockRead = {PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, 0}};
+
+static void *streamDecompress(__attribute__((unused)) void *arg)
+{
+    const u8 *readStart;
+
+    do
+    {
+        waitEvent(&stream.blockRead);
+        readStart = stream.readStart;
+
+        double start = now();
+        lzss_decode_groups(&stream.lzss, readStart > stream.lzss.in_start ? readStart : stream.lzss.in_start);
+        decodedSince(start);
+    } while(readStart > stream.lzss.in_start);
+
+    double start = now();
+    lzss_decode_tail(&stream.lzss);
+    decodedSince(start);
+
+    return NULL;
+}
+
+static void streamCode(u8 *code, const u8 *file, u32 size)
+{
+    pthread_t thread;
+    u32 offset = size > CODE_BLOCK_SIZE ? size - CODE_BLOCK_SIZE : 0;
+
+    readFile(code, file, offset, size - offset);
+
+    lzss_init(&stream.lzss, code + size);
+    stream.readStart = code + offset;
+
+    pthread_create(&thread, NULL, streamDecompress, NULL);
+    signalEvent(&stream.blockRead);
+
+    while(offset > 0)
+    {
+        u32 len = offset > CODE_BLOCK_SIZE ? CODE_BLOCK_SIZE : offset;
+
+        offset -= len;
+        readFile(code, file, offset, len);
+
+        stream.readStart = code + offset;
+        signalEvent(&stream.blockRead);
+    }
+
+    pthread_join(thread, NULL);
+}
+
+//Loads the code like load_code did before, one read and then the decoding
+static void serialCode(u8 *code, const u8 *file, u32 size)
+{
+    readFile(code, file, 0, size);
+
+    double start = now();
+    lzss_decompress(code + size);
+    decodedSince(start);
+}
+
+//Times loading the code both ways at a few bandwidths, and checks that streaming doesn't change the result
+static int simulate(const char *name, const u8 *code, u32 size)
+{
+    static const double bandwidths[] = {5e6, 20e6, 80e6};
+    u8 *file = allocate(size + size / 8 + 16),
+       *serialOut = allocate(size + size / 8 + 16),
+       *streamOut = allocate(size + size / 8 + 16);
+    u32 fileSize = compressBLZ(file, code, size);
+    int failed = 0;
+
+    if(fileSize >= size) goto done;
+
+    double decodeTime = decode(lzss_decompress, serialOut, file, fileSize, size) * 1000 * ARM11_SLOWDOWN;
+
+    for(u32 i = 0; i < sizeof(bandwidths) / sizeof(bandwidths[0]); i++)
+    {
+        bandwidth = bandwidths[i];
+
+        memset(serialOut, 0xCC, size);
+        memset(streamOut, 0xCC, size);
+
+        double start = now();
+        serialCode(serialOut, file, fileSize);
+        double serialTime = (now() - start) * 1000;
+
+        start = now();
+        streamCode(streamOut, file, fileSize);
+        double streamTime = (now() - start) * 1000;
+
+        if(memcmp(serialOut, code, size) != 0 || memcmp(streamOut, code, size) != 0)
+        {
+            printf("%s: streamed load doesn't match\n", name);
+            failed = 1;
+            break;
+        }
+
+        printf("%s at %.0f MB/s: %.1f ms to read and decode, %.1f ms streamed (decoding alone %.1f ms on the ARM11)\n", name,
+               bandwidth / 1e6, serialTime, streamTime, decodeTime);
+    }
+
+done:
+    free(file);
+    free(serialOut);
+    free(streamOut);
+
+    return failed;
+}
+
+int main(void)
+{
+    static const u32 codeSizes[] = {0x100000, 0x300000, 0x600000};
+    int failed = 0;
+
+    //Small and odd sizes, runs (distance 3 matches) and data that barely compresses
+    for(u32 size = 1; size < 0x20000; size = size * 5 / 3 + 7)
+    {
+        u8 *code = allocate(size);
+        char name[32];
+
+        generateCode(code, size, size);
+        sprintf(name, "code 0x%X", size);
+        failed |= check(name, code, size, 0);
+
+        for(u32 i = 0; i < size; i++) code[i] = (i / 200) & 1 ? (u8)(i % 3) : (u8)rand() % (size % 7 + 2);
+        sprintf(name, "runs 0x%X", size);
+        failed |= check(name, code, size, 0);
+
+        free(code);
+    }
+
+    if(failed) return 1;
+
+    printf("Output matches the reference decoder\n");
+
+    for(u32 i = 0; i < sizeof(codeSizes) / sizeof(codeSizes[0]); i++)
+    {
+        u8 *code = allocate(codeSizes[i]);
+        char name[32];
+
+        generateCode(code, codeSizes[i], i + 1);
+        sprintf(name, "%u MB code", codeSizes[i] >> 20);
+        failed |= check(name, code, codeSizes[i], 1);
+
+        free(code);
+    }
+
+    for(u32 i = 0; i < sizeof(codeSizes) / sizeof(codeSizes[0]); i++)
+    {
+        u8 *code = allocate(codeSizes[i]);
+        char name[32];
+
+        generateCode(code, codeSizes[i], i + 1);
+        sprintf(name, "%u MB code", codeSizes[i] >> 20);
+        failed |= simulate(name, code, codeSizes[i]);
+
+        free(code);
+    }
+
+    return failed;
+}
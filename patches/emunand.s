@@ -18,10 +18,34 @@ nand_sd:
 
     str r1, [r0, #4]  ; Set object to be SD
     ldr r2, [r0, #8]  ; Get sector to read
-    cmp r2, #0  ; For GW compatibility, see if we're trying to read the ncsd header (sector 0)
 
-    ldr r3, [nand_offset]
-    add r2, r3  ; Add the offset to the NAND in the SD.
+    ; Binary search the last extent starting at or before the sector.
+    ; A raw emuNAND is a single extent starting at the offset to the NAND in the SD.
+    push {r8-r10}
+    ldr r1, [extents_address]
+    ldr r3, [extent_count]
+    mov r8, #0  ; First candidate
+
+    extent_search:
+        cmp r3, #1
+        ble extent_found
+        mov r9, r3, lsr #1
+        add r10, r8, r9
+        ldr r12, [r1, r10, lsl #3]  ; NAND sector the middle extent starts at
+        cmp r12, r2
+        movls r8, r10
+        sub r3, r9
+        b extent_search
+
+    extent_found:
+        add r1, r1, r8, lsl #3
+        ldmia r1, {r3, r12}
+        sub r2, r3
+        add r2, r12  ; Move the sector to the extent's place in the SD.
+        pop {r8-r10}
+
+    ldr r3, [r0, #8]
+    cmp r3, #0  ; For GW compatibility, see if we're trying to read the ncsd header (sector 0)
 
     ldreq r3, [ncsd_header_offset]
     addeq r2, r3  ; If we're reading the ncsd header, add the offset of that sector.
@@ -41,6 +65,8 @@ nand_sd:
         bx r0
 .pool
 sdmmc:	                .ascii "SDMC"
-nand_offset:		.ascii "NAND"       ; for rednand this should be 1
 ncsd_header_offset:	.ascii "NCSD"       ; depends on nand manufacturer + emunand type (GW/RED)
-.close
\ No newline at end of file
+extent_count:		.ascii "EXTC"       ; 1 for raw emuNANDs
+extents_address:	.ascii "EXTA"       ; where the table below ends up in memory
+extents:		.fill 8 * MAX_FILE_EXTENTS, 0     ; (NAND sector, SD sector) pairs sorted by NAND sector, -equ'd from source/fs.h
+.close
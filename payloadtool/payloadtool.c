@@ -0,0 +1,303 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef uint8_t u8;
+typedef uint32_t u32;
+
+//The decoder the firmware uses
+#include "../source/lz4.h"
+
+//Keep in sync with source/fs.h
+#define PAYLOAD_MAGIC       "PAYZ"
+#define PAYLOAD_HEADER_SIZE 8
+#define PAYLOAD_MAX_SIZE    0xFFE00
+
+#define HASH_BITS       16
+#define MIN_MATCH       4
+#define MAX_OFFSET      0xFFFF
+#define LAST_LITERALS   5  //The LZ4 format wants the last bytes to be literals
+#define MATCH_LIMIT     12 //and no match to start this close to the end
+#define TEST_SIZE       0x40000
+
+static void usage(const char *name)
+{
+    printf("Usage: %s <payload.bin> <packed.bin>   compress a payload\n"
+           "       %s -d <packed.bin> <payload.bin> decompress a payload\n"
+           "       %s -t                           round trip test on generated data\n", name, name, name);
+    exit(0);
+}
+
+static u8 *readFile(const char *path, u32 *size)
+{
+    FILE *fp = fopen(path, "rb");
+    if(fp == NULL)
+    {
+        printf("Couldn't open %s\n", path);
+        exit(1);
+    }
+
+    fseek(fp, 0, SEEK_END);
+    *size = ftell(fp);
+    rewind(fp);
+
+    u8 *buf = malloc(*size ? *size : 1);
+    if(buf == NULL || fread(buf, 1, *size, fp) != *size)
+    {
+        printf("Couldn't read %s\n", path);
+        exit(1);
+    }
+
+    fclose(fp);
+
+    return buf;
+}
+
+static void writeFile(const char *path, const u8 *buf, u32 size)
+{
+    FILE *fp = fopen(path, "wb");
+    if(fp == NULL || fwrite(buf, 1, size, fp) != size)
+    {
+        printf("Couldn't write %s\n", path);
+        exit(1);
+    }
+
+    fclose(fp);
+}
+
+static u32 read32(const u8 *buf)
+{
+    return buf[0] | (buf[1] << 8) | (buf[2] << 16) | ((u32)buf[3] << 24);
+}
+
+static void write32(u8 *buf, u32 value)
+{
+    buf[0] = value;
+    buf[1] = value >> 8;
+    buf[2] = value >> 16;
+    buf[3] = value >> 24;
+}
+
+static u32 hash(const u8 *pos)
+{
+    return (read32(pos) * 2654435761U) >> (32 - HASH_BITS);
+}
+
+static u8 *writeLength(u8 *out, u32 length)
+{
+    for(; length >= 255; length -= 255) *out++ = 255;
+    *out++ = length;
+
+    return out;
+}
+
+static u8 *writeSequence(u8 *out, const u8 *literals, u32 literalCount, u32 offset, u32 matchLength)
+{
+    u8 *token = out++;
+
+    *token = (literalCount >= 15 ? 15 : literalCount) << 4;
+    if(literalCount >= 15) out = writeLength(out, literalCount - 15);
+
+    memcpy(out, literals, literalCount);
+    out += literalCount;
+
+    //Sequence with literals only
+    if(!matchLength) return out;
+
+    *out++ = offset;
+    *out++ = offset >> 8;
+
+    matchLength -= MIN_MATCH;
+    *token |= matchLength >= 15 ? 15 : matchLength;
+    if(matchLength >= 15) out = writeLength(out, matchLength - 15);
+
+    return out;
+}
+
+//Greedy LZ4 block compressor, out must hold size + size / 255 + 16 bytes
+static u32 compressLZ4(u8 *out, const u8 *in, u32 size)
+{
+    static u32 table[1 << HASH_BITS];
+    u8 *outStart = out;
+    u32 anchor = 0,
+        pos = 0;
+
+    memset(table, 0xFF, sizeof(table));
+
+    while(size > MATCH_LIMIT && pos < size - MATCH_LIMIT)
+    {
+        u32 h = hash(in + pos),
+            candidate = table[h];
+
+        table[h] = pos;
+
+        if(candidate == 0xFFFFFFFF || pos - candidate > MAX_OFFSET || read32(in + candidate) != read32(in + pos))
+        {
+            pos++;
+            continue;
+        }
+
+        u32 length = MIN_MATCH;
+        while(pos + length < size - LAST_LITERALS && in[candidate + length] == in[pos + length]) length++;
+
+        out = writeSequence(out, in + anchor, pos - anchor, pos - candidate, length);
+        pos += length;
+        anchor = pos;
+    }
+
+    out = writeSequence(out, in + anchor, size - anchor, 0, 0);
+
+    return out - outStart;
+}
+
+static u8 *allocate(u32 size)
+{
+    u8 *buf = malloc(size ? size : 1);
+    if(buf == NULL)
+    {
+        printf("Out of memory\n");
+        exit(1);
+    }
+
+    return buf;
+}
+
+//Returns the packed size, out must hold PAYLOAD_HEADER_SIZE + size + size / 255 + 16 bytes
+static u32 pack(u8 *out, const u8 *in, u32 size)
+{
+    memcpy(out, PAYLOAD_MAGIC, 4);
+    write32(out + 4, size);
+
+    return PAYLOAD_HEADER_SIZE + compressLZ4(out + PAYLOAD_HEADER_SIZE, in, size);
+}
+
+//Returns whether the packed payload decodes back to the original
+static int checkRoundTrip(const u8 *packed, u32 packedSize, const u8 *in, u32 size)
+{
+    if(read32(packed + 4) != size) return 0;
+
+    u8 *check = allocate(size);
+    int matches = decompressLZ4(check, size, packed + PAYLOAD_HEADER_SIZE, packedSize - PAYLOAD_HEADER_SIZE) == size &&
+                  memcmp(check, in, size) == 0;
+
+    free(check);
+
+    return matches;
+}
+
+static void compress(const char *inPath, const char *outPath)
+{
+    u32 size;
+    u8 *in = readFile(inPath, &size);
+
+    if(size > PAYLOAD_MAX_SIZE)
+    {
+        printf("%s is bigger than the %u bytes a payload can take\n", inPath, PAYLOAD_MAX_SIZE);
+        exit(1);
+    }
+
+    u8 *out = allocate(PAYLOAD_HEADER_SIZE + size + size / 255 + 16);
+    u32 outSize = pack(out, in, size);
+
+    //Luma3DS boots raw payloads as they are, so never store a bigger file
+    if(outSize >= size)
+    {
+        printf("%s doesn't compress, writing it raw\n", inPath);
+        writeFile(outPath, in, size);
+    }
+    else
+    {
+        if(!checkRoundTrip(out, outSize, in, size))
+        {
+            printf("Round trip check failed\n");
+            exit(1);
+        }
+
+        writeFile(outPath, out, outSize);
+        printf("%u -> %u bytes (%.1fx)\n", size, outSize, (double)size / outSize);
+    }
+
+    free(in);
+    free(out);
+}
+
+static void decompress(const char *inPath, const char *outPath)
+{
+    u32 size;
+    u8 *in = readFile(inPath, &size);
+
+    if(size <= PAYLOAD_HEADER_SIZE || memcmp(in, PAYLOAD_MAGIC, 4) != 0)
+    {
+        printf("Not a compressed payload\n");
+        exit(1);
+    }
+
+    u32 decompressedSize = read32(in + 4);
+    u8 *out = allocate(decompressedSize);
+
+    if(decompressLZ4(out, decompressedSize, in + PAYLOAD_HEADER_SIZE, size - PAYLOAD_HEADER_SIZE) != decompressedSize)
+    {
+        printf("Corrupted payload\n");
+        exit(1);
+    }
+
+    writeFile(outPath, out, decompressedSize);
+
+    free(in);
+    free(out);
+}
+
+static void test(void)
+{
+    static const char *names[] = {"empty", "tiny", "zeros", "random", "code-like", "long runs"};
+    u8 *in = allocate(TEST_SIZE),
+       *out = allocate(PAYLOAD_HEADER_SIZE + TEST_SIZE + TEST_SIZE / 255 + 16);
+    int failed = 0;
+
+    srand(1);
+
+    for(u32 kind = 0; kind < sizeof(names) / sizeof(names[0]); kind++)
+        for(u32 size = kind == 0 ? 0 : 1; size <= TEST_SIZE; size = size * 3 + 1)
+        {
+            for(u32 i = 0; i < size; i++)
+            {
+                switch(kind)
+                {
+                    case 2: in[i] = 0; break;
+                    case 3: in[i] = rand(); break;
+                    //Repeated instruction words with a few changing bytes, like ARM code
+                    case 4: in[i] = i % 4 == 3 ? 0xE5 : (i % 4 == 0 ? rand() % 8 : (u8)(i / 64)); break;
+                    case 5: in[i] = (i / 300) & 1 ? 0xFF : (u8)(i / 7); break;
+                    default: in[i] = i; break;
+                }
+            }
+
+            u32 outSize = pack(out, in, size);
+
+            if(!checkRoundTrip(out, outSize, in, size))
+            {
+                printf("Round trip failed: %s, %u bytes\n", names[kind], size);
+                failed = 1;
+            }
+
+            if(kind == 0) break;
+        }
+
+    free(in);
+    free(out);
+
+    if(failed) exit(1);
+
+    printf("All round trips passed\n");
+}
+
+int main(int argc, char **argv)
+{
+    if(argc == 2 && strcmp(argv[1], "-t") == 0) test();
+    else if(argc == 4 && strcmp(argv[1], "-d") == 0) decompress(argv[2], argv[3]);
+    else if(argc == 3 && argv[1][0] != '-') compress(argv[1], argv[2]);
+    else usage(argv[0]);
+
+    return 0;
+}
@@ -26,28 +26,37 @@
 #include "utils.h"
 #include "screen.h"
 #include "draw.h"
+#include "ui.h"
 #include "buttons.h"
 #include "pin.h"
 
 bool readConfig(const char *configPath)
 {
-    if(fileRead(&configData, configPath) != sizeof(cfgData) ||
+    u32 size = fileRead(&configData, configPath, sizeof(cfgData));
+
+    //1.0 files end before the emuNAND locations, which are then just looked for again
+    bool isVersion10 = size == sizeof(cfgData) - sizeof(configData.emuNands) && configData.formatVersionMinor == 0;
+
+    if(!(size == sizeof(cfgData) || isVersion10) ||
        memcmp(configData.magic, "CONF", 4) != 0 ||
        configData.formatVersionMajor != CONFIG_VERSIONMAJOR ||
-       configData.formatVersionMinor != CONFIG_VERSIONMINOR)
+       (configData.formatVersionMinor != CONFIG_VERSIONMINOR && !isVersion10))
     {
         configData.config = 0;
+        memset32(configData.emuNands, 0, sizeof(configData.emuNands));
         return false;
     }
 
+    if(isVersion10) memset32(configData.emuNands, 0, sizeof(configData.emuNands));
+
     return true;
 }
 
-void writeConfig(const char *configPath, u32 configTemp)
+void writeConfig(const char *configPath, u32 configTemp, bool emuNandsChanged)
 {
-    /* If the configuration is different from previously, overwrite it.
+    /* If the configuration or the emuNAND locations are different from previously, overwrite it.
        Just the no-forcing flag being set is not enough */
-    if((configTemp & 0xFFFFFFEF) != configData.config)
+    if((configTemp & 0xFFFFFFEF) != configData.config || emuNandsChanged)
     {
         //Merge the new options and new boot configuration
         configData.config = (configData.config & 0xFFFFFFC0) | (configTemp & 0x3F);
@@ -67,13 +76,14 @@ void writeConfig(const char *configPath, u32 configTemp)
 
 void configMenu(bool oldPinStatus)
 {
-    initScreens();
+    uiInit();
 
-    drawString(CONFIG_TITLE, 10, 10, COLOR_TITLE);
-    drawString("Press A to select, START to save", 10, 30, COLOR_WHITE);
+    uiAddRow(10, 10, CONFIG_TITLE, COLOR_TITLE);
+    uiAddRow(10, 30, "Press A to select, START to save", COLOR_WHITE);
 
     const char *multiOptionsText[]  = { "Screen brightness: 4( ) 3( ) 2( ) 1( )",
-                                        "New 3DS CPU: Off( ) Clock( ) L2( ) Clock+L2( )" };
+                                        "New 3DS CPU: Off( ) Clock( ) L2( ) Clock+L2( )",
+                                        "Second EmuNAND: 2( ) 3( )" };
 
     const char *singleOptionsText[] = { "( ) Autoboot SysNAND",
                                         "( ) Use SysNAND FIRM if booting with R (A9LH)",
@@ -83,15 +93,17 @@ void configMenu(bool oldPinStatus)
                                         "( ) Enable experimental TwlBg patches",
                                         "( ) Show GBA boot screen in patched AGB_FIRM",
                                         "( ) Display splash screen before payloads",
-                                        "( ) Use a PIN" };
+                                        "( ) Use a PIN",
+                                        "( ) Load the FIRM while showing the splash" };
 
+    //Options with less than 4 choices end their positions with a 0
     struct multiOption {
-        int posXs[4];
-        int posY;
+        u32 posXs[4];
         u32 enabled;
     } multiOptions[] = {
         { .posXs = {21, 26, 31, 36} },
-        { .posXs = {17, 26, 32, 44} }
+        { .posXs = {17, 26, 32, 44} },
+        { .posXs = {18, 23, 0, 0} }
     };
 
     //Calculate the amount of the various kinds of options and pre-select the first single one
@@ -100,42 +112,43 @@ void configMenu(bool oldPinStatus)
         totalIndexes = multiOptionsAmount + singleOptionsAmount - 1,
         selectedOption = multiOptionsAmount;
 
-    struct singleOption {
-        int posY;
-        bool enabled;
-    } singleOptions[singleOptionsAmount];
+    bool singleOptions[singleOptionsAmount];
 
     //Parse the existing options
     for(u32 i = 0; i < multiOptionsAmount; i++)
         multiOptions[i].enabled = MULTICONFIG(i);
     for(u32 i = 0; i < singleOptionsAmount; i++)
-        singleOptions[i].enabled = CONFIG(i);
+        singleOptions[i] = CONFIG(i);
 
     //Character to display a selected option
     char selected = 'x';
 
-    int endPos = 42;
+    //The options take one row each, in the same order as their indexes
+    u32 firstOptionRow = 2;
+    int posY = 42;
 
     //Display all the multiple choice options in white
     for(u32 i = 0; i < multiOptionsAmount; i++)
     {
-        multiOptions[i].posY = endPos + SPACING_Y;
-        endPos = drawString(multiOptionsText[i], 10, multiOptions[i].posY, COLOR_WHITE);
-        drawCharacter(selected, 10 + multiOptions[i].posXs[multiOptions[i].enabled] * SPACING_X, multiOptions[i].posY, COLOR_WHITE);
+        posY += SPACING_Y;
+        uiAddRow(10, posY, multiOptionsText[i], COLOR_WHITE);
+        uiSetCharacter(firstOptionRow + i, multiOptions[i].posXs[multiOptions[i].enabled], selected);
     }
 
-    endPos += SPACING_Y / 2;
+    posY += SPACING_Y / 2;
     u32 color = COLOR_RED;
 
     //Display all the normal options in white except for the first one
     for(u32 i = 0; i < singleOptionsAmount; i++)
     {
-        singleOptions[i].posY = endPos + SPACING_Y;
-        endPos = drawString(singleOptionsText[i], 10, singleOptions[i].posY, color);
-        if(singleOptions[i].enabled) drawCharacter(selected, 10 + SPACING_X, singleOptions[i].posY, color);
+        posY += SPACING_Y;
+        uiAddRow(10, posY, singleOptionsText[i], color);
+        if(singleOptions[i]) uiSetCharacter(firstOptionRow + multiOptionsAmount + i, 1, selected);
         color = COLOR_WHITE;
     }
 
+    uiFlush();
+
     u32 pressed = 0;
 
     //Boring configuration menu
@@ -172,55 +185,35 @@ void configMenu(bool oldPinStatus)
 
             if(selectedOption == oldSelectedOption) continue;
 
-            //The user moved to a different option, print the old option in white and the new one in red. Only print 'x's if necessary
-            if(oldSelectedOption < multiOptionsAmount)
-            {
-                drawString(multiOptionsText[oldSelectedOption], 10, multiOptions[oldSelectedOption].posY, COLOR_WHITE);
-                drawCharacter(selected, 10 + multiOptions[oldSelectedOption].posXs[multiOptions[oldSelectedOption].enabled] * SPACING_X, multiOptions[oldSelectedOption].posY, COLOR_WHITE);
-            }
-            else
-            {
-                u32 singleOldSelected = oldSelectedOption - multiOptionsAmount;
-                drawString(singleOptionsText[singleOldSelected], 10, singleOptions[singleOldSelected].posY, COLOR_WHITE);
-                if(singleOptions[singleOldSelected].enabled) drawCharacter(selected, 10 + SPACING_X, singleOptions[singleOldSelected].posY, COLOR_WHITE);
-            }
-
-            if(selectedOption < multiOptionsAmount)
-                drawString(multiOptionsText[selectedOption], 10, multiOptions[selectedOption].posY, COLOR_RED);
-            else
-            {
-                u32 singleSelected = selectedOption - multiOptionsAmount;
-                drawString(singleOptionsText[singleSelected], 10, singleOptions[singleSelected].posY, COLOR_RED);
-            }
+            //The user moved to a different option, show the old option in white and the new one in red
+            uiSetColor(firstOptionRow + oldSelectedOption, COLOR_WHITE);
+            uiSetColor(firstOptionRow + selectedOption, COLOR_RED);
         }
         else
         {
-            //The selected option's status changed, print the 'x's accordingly
+            //The selected option's status changed, move or toggle its 'x'
             if(selectedOption < multiOptionsAmount)
             {
-                u32 oldEnabled = multiOptions[selectedOption].enabled;
-                drawCharacter(selected, 10 + multiOptions[selectedOption].posXs[oldEnabled] * SPACING_X, multiOptions[selectedOption].posY, COLOR_BLACK);
-                multiOptions[selectedOption].enabled = oldEnabled == 3 ? 0 : oldEnabled + 1;
+                struct multiOption *option = &multiOptions[selectedOption];
+
+                uiSetCharacter(firstOptionRow + selectedOption, option->posXs[option->enabled], ' ');
+                option->enabled = option->enabled == 3 || !option->posXs[option->enabled + 1] ? 0 : option->enabled + 1;
+                uiSetCharacter(firstOptionRow + selectedOption, option->posXs[option->enabled], selected);
 
                 if(!selectedOption)
-                    updateBrightness(multiOptions[selectedOption].enabled);
+                    updateBrightness(option->enabled);
             }
             else
             {
-                bool oldEnabled = singleOptions[selectedOption - multiOptionsAmount].enabled;
-                singleOptions[selectedOption - multiOptionsAmount].enabled = !oldEnabled;
-                if(oldEnabled) drawCharacter(selected, 10 + SPACING_X, singleOptions[selectedOption - multiOptionsAmount].posY, COLOR_BLACK);
+                bool *enabled = &singleOptions[selectedOption - multiOptionsAmount];
+
+                *enabled = !*enabled;
+                uiSetCharacter(firstOptionRow + selectedOption, 1, *enabled ? selected : ' ');
             }
         }
 
-        //In any case, if the current option is enabled (or a multiple choice option is selected) we must display a red 'x'
-        if(selectedOption < multiOptionsAmount)
-            drawCharacter(selected, 10 + multiOptions[selectedOption].posXs[multiOptions[selectedOption].enabled] * SPACING_X, multiOptions[selectedOption].posY, COLOR_RED);
-        else
-        {
-            u32 singleSelected = selectedOption - multiOptionsAmount;
-            if(singleOptions[singleSelected].enabled) drawCharacter(selected, 10 + SPACING_X, singleOptions[singleSelected].posY, COLOR_RED);
-        }
+        //Only the changed glyphs get redrawn
+        uiFlush();
     }
 
     //Preserve the last-used boot options (last 12 bits)
@@ -230,7 +223,7 @@ void configMenu(bool oldPinStatus)
     for(u32 i = 0; i < multiOptionsAmount; i++)
         configData.config |= multiOptions[i].enabled << (i * 2 + 6);
     for(u32 i = 0; i < singleOptionsAmount; i++)
-        configData.config |= (singleOptions[i].enabled ? 1 : 0) << (i + 16);
+        configData.config |= (singleOptions[i] ? 1 : 0) << (i + 16);
 
     if(CONFIG(8)) newPin(oldPinStatus);
     else if(oldPinStatus) fileDelete("/luma/pin.bin");
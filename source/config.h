@@ -29,7 +29,27 @@
 #define BOOTCONFIG(a, b) ((configData.config >> a) & b)
 
 #define CONFIG_VERSIONMAJOR 1
-#define CONFIG_VERSIONMINOR 0
+#define CONFIG_VERSIONMINOR 1
+
+//One per emuNAND that can be booted, FIRMWARE_EMUNAND being the first
+#define EMUNAND_MAX_SLOTS 3
+
+typedef enum EmuNandType
+{
+    EMUNAND_NONE = 0,
+    EMUNAND_REDNAND = 1,
+    EMUNAND_GATEWAY = 2,
+    EMUNAND_FILE = 3 //A NAND image in /luma/emunandN.bin, offset being its first sector
+} EmuNandType;
+
+//Where an emuNAND was last found on the SD, so that booting it only takes a read of its header
+typedef struct __attribute__((packed))
+{
+    u32 offset,
+        header,
+        nandSize, //Of the console it was found for
+        type;
+} emuNandLocation;
 
 typedef struct __attribute__((packed))
 {
@@ -37,10 +57,13 @@ typedef struct __attribute__((packed))
     u16 formatVersionMajor, formatVersionMinor;
 
     u32 config;
+
+    //Added in 1.1
+    emuNandLocation emuNands[EMUNAND_MAX_SLOTS];
 } cfgData;
 
 extern cfgData configData;
 
 bool readConfig(const char *configPath);
-void writeConfig(const char *configPath, u32 configTemp);
+void writeConfig(const char *configPath, u32 configTemp, bool emuNandsChanged);
 void configMenu(bool oldPinStatus);
\ No newline at end of file
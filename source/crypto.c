@@ -27,6 +27,10 @@
 #include "crypto.h"
 #include "memory.h"
 #include "fatfs/sdmmc/sdmmc.h"
+#include "emunand.h"
+#ifdef CRYPTO_SOFTWARE
+#include "swcrypto.h"
+#endif
 
 /****************************************************************
 *                  Crypto libs
@@ -34,7 +38,7 @@
 
 /* original version by megazig */
 
-#ifndef __thumb__
+#if defined(__arm__) && !defined(__thumb__)
 #define BSWAP32(x) {\
     __asm__\
     (\
@@ -60,7 +64,7 @@ __asm__\
         : "cc"\
     );\
 }
-#else
+#elif defined(__arm__)
 #define BSWAP32(x) {x = __builtin_bswap32(x);}
 
 #define ADD_u128_u32(u128_0, u128_1, u128_2, u128_3, u32_0) {\
@@ -76,7 +80,96 @@ __asm__\
         : "cc", "r4"\
     );\
 }
-#endif /*__thumb__*/
+#else
+//Host builds of the tests
+#define BSWAP32(x) {x = __builtin_bswap32(x);}
+
+#define ADD_u128_u32(u128_0, u128_1, u128_2, u128_3, u32_0) {\
+    u32 carry = ((u128_0) += (u32_0)) < (u32_0);\
+    carry = ((u128_1) += carry) < carry;\
+    carry = ((u128_2) += carry) < carry;\
+    (u128_3) += carry;\
+}
+#endif /*__arm__*/
+
+static void aes_advctr(void *ctr, u32 val, u32 mode)
+{
+    u32 *ctr32 = (u32 *)ctr;
+    
+    int i;
+    if(mode & AES_INPUT_BE)
+    {
+        for(i = 0; i < 4; ++i) // Endian swap
+            BSWAP32(ctr32[i]);
+    }
+    
+    if(mode & AES_INPUT_NORMAL)
+    {
+        ADD_u128_u32(ctr32[3], ctr32[2], ctr32[1], ctr32[0], val);
+    }
+    else
+    {
+        ADD_u128_u32(ctr32[0], ctr32[1], ctr32[2], ctr32[3], val);
+    }
+    
+    if(mode & AES_INPUT_BE)
+    {
+        for(i = 0; i < 4; ++i) // Endian swap
+            BSWAP32(ctr32[i]);
+    }
+}
+
+#ifdef CRYPTO_SOFTWARE
+
+/* Software backend: only AES_INPUT_BE | AES_INPUT_NORMAL IVs and SHA-256 are supported,
+   which is all this file uses */
+
+static void aes_setkey(u8 keyslot, const void *key, u32 keyType, __attribute__((unused)) u32 mode)
+{
+    if(keyslot <= 0x03) return; // Ignore TWL keys for now
+    swAesSetKey(keyslot, key, keyType);
+}
+
+static void aes_use_keyslot(u8 keyslot)
+{
+    if(keyslot > 0x3F)
+        return;
+
+    swAesUseKeyslot(keyslot);
+}
+
+// The IV is taken from the aes() arguments
+static void aes_setiv(__attribute__((unused)) const void *iv, __attribute__((unused)) u32 mode)
+{
+}
+
+static void aes(void *dst, const void *src, u32 blockCount, void *iv, u32 mode, __attribute__((unused)) u32 ivMode)
+{
+    swAes(dst, src, blockCount, iv, mode & AES_ALL_MODES);
+}
+
+// There's nothing to overlap with, so CTR batches complete right away
+static void aes_ctr_start(void *dst, const void *src, u32 blockCount, const void *ctr)
+{
+    u8 __attribute__((aligned(4))) tmpCTR[0x10];
+    memcpy(tmpCTR, ctr, 0x10);
+    swAes(dst, src, blockCount, tmpCTR, AES_CTR_MODE);
+}
+
+static void aes_batch_pump_idle(void)
+{
+}
+
+static void aes_batch_finish(void)
+{
+}
+
+static void sha(void *res, const void *src, u32 size, __attribute__((unused)) u32 mode)
+{
+    swSha256(res, src, size);
+}
+
+#else
 
 static void aes_setkey(u8 keyslot, const void *key, u32 keyType, u32 mode)
 {
@@ -122,33 +215,6 @@ static void aes_setiv(const void *iv, u32 mode)
     }
 }
 
-static void aes_advctr(void *ctr, u32 val, u32 mode)
-{
-    u32 *ctr32 = (u32 *)ctr;
-    
-    int i;
-    if(mode & AES_INPUT_BE)
-    {
-        for(i = 0; i < 4; ++i) // Endian swap
-            BSWAP32(ctr32[i]);
-    }
-    
-    if(mode & AES_INPUT_NORMAL)
-    {
-        ADD_u128_u32(ctr32[3], ctr32[2], ctr32[1], ctr32[0], val);
-    }
-    else
-    {
-        ADD_u128_u32(ctr32[0], ctr32[1], ctr32[2], ctr32[3], val);
-    }
-    
-    if(mode & AES_INPUT_BE)
-    {
-        for(i = 0; i < 4; ++i) // Endian swap
-            BSWAP32(ctr32[i]);
-    }
-}
-
 static void aes_change_ctrmode(void *ctr, u32 fromMode, u32 toMode)
 {
     u32 *ctr32 = (u32 *)ctr;
@@ -171,37 +237,75 @@ static void aes_change_ctrmode(void *ctr, u32 fromMode, u32 toMode)
     }
 }
 
-static void aes_batch(void *dst, const void *src, u32 blockCount)
+static struct
+{
+    const u32 *src32;
+    u32 *dst32;
+    u32 wbc;
+    u32 rbc;
+} aesBatch;
+
+static void aes_batch_start(void *dst, const void *src, u32 blockCount)
 {
     *REG_AESBLKCNT = blockCount << 16;
     *REG_AESCNT |=  AES_CNT_START;
     
-    const u32 *src32    = (const u32 *)src;
-    u32 *dst32          = (u32 *)dst;
-    
-    u32 wbc = blockCount;
-    u32 rbc = blockCount;
+    aesBatch.src32 = (const u32 *)src;
+    aesBatch.dst32 = (u32 *)dst;
+    aesBatch.wbc = blockCount;
+    aesBatch.rbc = blockCount;
+}
+
+// Move at most one block in each direction, returns true while the batch is still running
+static bool aes_batch_pump(void)
+{
+    if(aesBatch.wbc && ((*REG_AESCNT & 0x1F) <= 0xC)) // There's space for at least 4 ints
+    {
+        *REG_AESWRFIFO = *aesBatch.src32++;
+        *REG_AESWRFIFO = *aesBatch.src32++;
+        *REG_AESWRFIFO = *aesBatch.src32++;
+        *REG_AESWRFIFO = *aesBatch.src32++;
+        aesBatch.wbc--;
+    }
     
-    while(rbc)
+    if(aesBatch.rbc && ((*REG_AESCNT & (0x1F << 0x5)) >= (0x4 << 0x5))) // At least 4 ints available for read
     {
-        if(wbc && ((*REG_AESCNT & 0x1F) <= 0xC)) // There's space for at least 4 ints
-        {
-            *REG_AESWRFIFO = *src32++;
-            *REG_AESWRFIFO = *src32++;
-            *REG_AESWRFIFO = *src32++;
-            *REG_AESWRFIFO = *src32++;
-            wbc--;
-        }
-        
-        if(rbc && ((*REG_AESCNT & (0x1F << 0x5)) >= (0x4 << 0x5))) // At least 4 ints available for read
-        {
-            *dst32++ = *REG_AESRDFIFO;
-            *dst32++ = *REG_AESRDFIFO;
-            *dst32++ = *REG_AESRDFIFO;
-            *dst32++ = *REG_AESRDFIFO;
-            rbc--;
-        }
+        *aesBatch.dst32++ = *REG_AESRDFIFO;
+        *aesBatch.dst32++ = *REG_AESRDFIFO;
+        *aesBatch.dst32++ = *REG_AESRDFIFO;
+        *aesBatch.dst32++ = *REG_AESRDFIFO;
+        aesBatch.rbc--;
     }
+
+    return aesBatch.rbc != 0;
+}
+
+static void aes_batch_pump_idle(void)
+{
+    aes_batch_pump();
+}
+
+static void aes_batch_finish(void)
+{
+    while(aes_batch_pump());
+}
+
+static void aes_batch(void *dst, const void *src, u32 blockCount)
+{
+    aes_batch_start(dst, src, blockCount);
+    aes_batch_finish();
+}
+
+// Start a CTR batch of at most 0xFFFF blocks with the current keyslot, aes_batch_finish() completes it
+static void aes_ctr_start(void *dst, const void *src, u32 blockCount, const void *ctr)
+{
+    *REG_AESCNT =   AES_CTR_MODE |
+                    AES_CNT_INPUT_ORDER | AES_CNT_OUTPUT_ORDER |
+                    AES_CNT_INPUT_ENDIAN | AES_CNT_OUTPUT_ENDIAN |
+                    AES_CNT_FLUSH_READ | AES_CNT_FLUSH_WRITE;
+
+    aes_setiv(ctr, AES_INPUT_BE | AES_INPUT_NORMAL);
+    aes_batch_start(dst, src, blockCount);
 }
 
 static void aes(void *dst, const void *src, u32 blockCount, void *iv, u32 mode, u32 ivMode)
@@ -290,6 +394,8 @@ static void sha(void *res, const void *src, u32 size, u32 mode)
     memcpy(res, (void *)REG_SHA_HASH, hashSize);
 }
 
+#endif /*CRYPTO_SOFTWARE*/
+
 /****************************************************************
 *                  NAND/FIRM crypto
 ****************************************************************/
@@ -299,6 +405,9 @@ static u8 nandSlot;
 
 static u32 fatStart;
 
+//Sectors read per CTRNAND pipeline step
+#define NAND_CHUNK_SECTORS 0x40
+
 //Initialize the CTRNAND crypto
 void ctrNandInit(void)
 {
@@ -324,26 +433,44 @@ void ctrNandInit(void)
     }
 }
 
-//Read and decrypt from the selected CTRNAND
+/* Read and decrypt from the selected CTRNAND. Sectors are read in chunks, and
+   the previous chunk is fed to the AES engine while the SDMMC driver waits on the card */
 u32 ctrNandRead(u32 sector, u32 sectorCount, u8 *outbuf)
 {
     u8 __attribute__((aligned(4))) tmpCTR[0x10];
     memcpy(tmpCTR, nandCTR, 0x10);
     aes_advctr(tmpCTR, ((sector + fatStart) * 0x200) / AES_BLOCK_SIZE, AES_INPUT_BE | AES_INPUT_NORMAL);
 
-    //Read
-    u32 result;
-    if(firmSource == FIRMWARE_SYSNAND)
-        result = sdmmc_nand_readsectors(sector + fatStart, sectorCount, outbuf);
-    else
+    sector += fatStart;
+    if(firmSource != FIRMWARE_SYSNAND) sector = emuNandSector(sector);
+
+    aes_use_keyslot(nandSlot);
+    sdmmc_set_idle_callback(aes_batch_pump_idle);
+
+    u32 result = 0;
+    while(sectorCount != 0 && result == 0)
     {
-        sector += emuOffset;
-        result = sdmmc_sdcard_readsectors(sector + fatStart, sectorCount, outbuf);
+        u32 chunkSectors = sectorCount > NAND_CHUNK_SECTORS ? NAND_CHUNK_SECTORS : sectorCount,
+            chunkBlocks = chunkSectors * 0x200 / AES_BLOCK_SIZE;
+
+        //Read
+        if(firmSource == FIRMWARE_SYSNAND)
+            result = sdmmc_nand_readsectors(sector, chunkSectors, outbuf);
+        else
+            result = sdmmc_sdcard_readsectors(sector, chunkSectors, outbuf);
+
+        //Finish decrypting the previous chunk, then start on this one
+        aes_batch_finish();
+        aes_ctr_start(outbuf, outbuf, chunkBlocks, tmpCTR);
+        aes_advctr(tmpCTR, chunkBlocks, AES_INPUT_BE | AES_INPUT_NORMAL);
+
+        sector += chunkSectors;
+        sectorCount -= chunkSectors;
+        outbuf += chunkSectors * 0x200;
     }
 
-    //Decrypt
-    aes_use_keyslot(nandSlot);
-    aes(outbuf, outbuf, sectorCount * 0x200 / AES_BLOCK_SIZE, tmpCTR, AES_CTR_MODE, AES_INPUT_BE | AES_INPUT_NORMAL);
+    sdmmc_set_idle_callback(NULL);
+    aes_batch_finish();
 
     return result;
 }
@@ -383,9 +510,42 @@ void decryptExeFs(u8 *inbuf)
     aes(inbuf - 0x200, exeFsOffset, exeFsSize / AES_BLOCK_SIZE, ncchCTR, AES_CTR_MODE, AES_INPUT_BE | AES_INPUT_NORMAL);
 }
 
+static u8 __attribute__((aligned(4))) exeFsCTR[0x10];
+static const u8 *firmData;
+
+/* Prepare to decrypt a FIRM ExeFS piece by piece with decryptExeFsRange,
+   and decrypt the FIRM header at the start of the buffer */
+void initExeFsDecryption(u8 *inbuf)
+{
+    //The FIRM follows the 0x200 bytes ExeFS header
+    firmData = inbuf + *(u32 *)(inbuf + 0x1A0) * 0x200 + 0x200;
+
+    memset32(exeFsCTR, 0, 0x10);
+    for(u32 i = 0; i < 8; i++)
+        exeFsCTR[7 - i] = *(inbuf + 0x108 + i);
+    exeFsCTR[8] = 2;
+
+    aes_setkey(0x2C, inbuf, AES_KEYY, AES_INPUT_BE | AES_INPUT_NORMAL);
+
+    decryptExeFsRange(inbuf, 0, 0x200);
+}
+
+//Decrypt size bytes starting at the given offset of the FIRM to dest
+void decryptExeFsRange(void *dest, u32 offset, u32 size)
+{
+    u8 __attribute__((aligned(4))) tmpCTR[0x10];
+    memcpy(tmpCTR, exeFsCTR, 0x10);
+    aes_advctr(tmpCTR, (0x200 + offset) / AES_BLOCK_SIZE, AES_INPUT_BE | AES_INPUT_NORMAL);
+
+    aes_use_keyslot(0x2C);
+    aes(dest, firmData + offset, size / AES_BLOCK_SIZE, tmpCTR, AES_CTR_MODE, AES_INPUT_BE | AES_INPUT_NORMAL);
+}
+
 /* ARM9Loader replacement
    Originally adapted from: https://github.com/Reisyukaku/ReiNand/blob/228c378255ba693133dec6f3368e14d386f2cde7/source/crypto.c#L233 */
-void arm9Loader(u8 *arm9Section)
+/* Set the keys arm9loader would and, if decryptArm9Bin is set, decrypt the ARM9 binary in place.
+   The section header is left untouched, so this also works on an already decrypted section */
+void arm9Loader(u8 *arm9Section, bool decryptArm9Bin)
 {
     //Determine the arm9loader version
     u32 a9lVersion;
@@ -439,7 +599,7 @@ void arm9Loader(u8 *arm9Section)
     aes_use_keyslot(arm9BinSlot);
 
     //Decrypt arm9bin
-    aes(arm9Section + 0x800, arm9Section + 0x800, arm9BinSize / AES_BLOCK_SIZE, arm9BinCTR, AES_CTR_MODE, AES_INPUT_BE | AES_INPUT_NORMAL);
+    if(decryptArm9Bin) aes(arm9Section + 0x800, arm9Section + 0x800, arm9BinSize / AES_BLOCK_SIZE, arm9BinCTR, AES_CTR_MODE, AES_INPUT_BE | AES_INPUT_NORMAL);
 
     //Set >=9.6 KeyXs
     if(a9lVersion == 2 && !isDevUnit)
@@ -467,4 +627,9 @@ void computePinHash(u8 *out, u8 *in, u32 blockCount)
     aes(cipherText, in, blockCount, cid, AES_CBC_ENCRYPT_MODE, AES_INPUT_BE | AES_INPUT_NORMAL);
 
     sha(out, cipherText, 0x10, SHA_256_MODE);
+}
+
+void sha256(void *res, const void *src, u32 size)
+{
+    sha(res, src, size, SHA_256_MODE);
 }
\ No newline at end of file
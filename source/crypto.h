@@ -99,7 +99,6 @@
 #define SHA_224_HASH_SIZE   (224 / 8)
 #define SHA_1_HASH_SIZE     (160 / 8)
 
-extern u32 emuOffset;
 extern bool isN3DS, isDevUnit;
 extern FirmwareSource firmSource;
 
@@ -107,5 +106,8 @@ void ctrNandInit(void);
 u32 ctrNandRead(u32 sector, u32 sectorCount, u8 *outbuf);
 void setRSAMod0DerivedKeys(void);
 void decryptExeFs(u8 *inbuf);
-void arm9Loader(u8 *arm9Section);
-void computePinHash(u8 *out, u8 *in, u32 blockCount);
\ No newline at end of file
+void initExeFsDecryption(u8 *inbuf);
+void decryptExeFsRange(void *dest, u32 offset, u32 size);
+void arm9Loader(u8 *arm9Section, bool decryptArm9Bin);
+void computePinHash(u8 *out, u8 *in, u32 blockCount);
+void sha256(void *res, const void *src, u32 size);
\ No newline at end of file
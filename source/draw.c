@@ -29,7 +29,19 @@
 #include "screen.h"
 #include "utils.h"
 #include "fs.h"
+#include "memory.h"
+#include "cache.h"
 #include "font.h"
+#include "lz4.h"
+#include "glyph.h"
+
+//The splash is read here while the ARM11 initializes the screens, then copied or decompressed to the framebuffers by it
+#define SPLASH_BUFFER ((u8 *)0x24E00000)
+
+//How long the splash stays on screen, and when that's over if the wait was deferred
+#define SPLASH_SECONDS 3
+
+static u64 splashEndTicks = 0;
 
 static inline int strlen(const char *string)
 {
@@ -40,45 +52,75 @@ static inline int strlen(const char *string)
     return stringEnd - string;
 }
 
-bool loadSplash(void)
+static void copySplash(u8 *dest, u32 destSize, const u8 *src, u32 srcSize)
 {
+    const splashHeader *header = (const splashHeader *)src;
+
+    if(srcSize > sizeof(splashHeader) && memcmp(header->magic, SPLASH_MAGIC, 4) == 0)
+    {
+        if(header->decompressedSize < destSize) destSize = header->decompressedSize;
+        decompressLZ4(dest, destSize, src + sizeof(splashHeader), srcSize - sizeof(splashHeader));
+    }
+    else memcpy(dest, src, srcSize < destSize ? srcSize : destSize);
+}
+
+bool loadSplash(bool deferDelay)
+{
+    static u32 splashSizes[2];
+
+    void ARM11(__attribute__((unused)) u32 arg)
+    {
+        copySplash(fb->top_left, SCREEN_TOP_FBSIZE, SPLASH_BUFFER, splashSizes[0]);
+        copySplash(fb->bottom, SCREEN_BOTTOM_FBSIZE, SPLASH_BUFFER + SCREEN_TOP_FBSIZE, splashSizes[1]);
+    }
+
+    /* Each image is opened once, the screens start initializing as soon as there's one to show.
+       Images bigger than their framebuffer, compressed or not, are skipped */
+    splashSizes[0] = fileRead(SPLASH_BUFFER, "/luma/splash.bin", SCREEN_TOP_FBSIZE);
+    if(splashSizes[0]) initScreens();
+
+    splashSizes[1] = fileRead(SPLASH_BUFFER + SCREEN_TOP_FBSIZE, "/luma/splashbottom.bin", SCREEN_BOTTOM_FBSIZE);
+
     //Don't delay boot nor init the screens if no splash image is on the SD
-    if(getFileSize("/luma/splash.bin") + getFileSize("/luma/splashbottom.bin") == 0)
-        return false;
-    
-    initScreens();
+    if(!splashSizes[0] && !splashSizes[1]) return false;
+    if(!splashSizes[0]) initScreens();
+
+    flushDCacheRange(splashSizes, sizeof(splashSizes));
+    flushDCacheRange(SPLASH_BUFFER, SCREEN_TOP_FBSIZE + splashSizes[1]);
+    arm11Submit(ARM11, 0);
 
-    fileRead(fb->top_left, "/luma/splash.bin");
-    fileRead(fb->bottom, "/luma/splashbottom.bin");
+    waitScreens();
 
-    chrono(3);
+    //Either keep the splash on screen now, or let the FIRM load behind it and wait in launchFirm
+    if(deferDelay) splashEndTicks = chronoTicks() + SPLASH_SECONDS * TICKS_PER_SEC;
+    else chrono(SPLASH_SECONDS);
 
     return true;
 }
 
-void drawCharacter(char character, int posX, int posY, u32 color)
+void waitSplash(void)
 {
-    u8 *const select = fb->top_left;
+    while(chronoTicks() < splashEndTicks);
+}
 
-    for(int y = 0; y < 8; y++)
-    {
-        char charPos = font[character * 8 + y];
+void drawCharacter(char character, int posX, int posY, u32 color)
+{
+    //The framebuffers may still be being set up or cleared
+    waitScreens();
 
-        for(int x = 7; x >= 0; x--)
-            if ((charPos >> x) & 1)
-            {
-                int screenPos = (posX * SCREEN_TOP_HEIGHT * 3 + (SCREEN_TOP_HEIGHT - y - posY - 1) * 3) + (7 - x) * 3 * SCREEN_TOP_HEIGHT;
+    blitGlyph(fb->top_left, character, posX, posY, color, false);
+}
 
-                select[screenPos] = color >> 16;
-                select[screenPos + 1] = color >> 8;
-                select[screenPos + 2] = color;
-            }
-    }
+void drawCell(u8 *framebuffer, char character, int posX, int posY, u32 color)
+{
+    blitGlyph(framebuffer, character, posX, posY, color, true);
 }
 
 int drawString(const char *string, int posX, int posY, u32 color)
 {
-    for(int i = 0, line_i = 0; i < strlen(string); i++, line_i++)
+    int length = strlen(string);
+
+    for(int i = 0, line_i = 0; i < length; i++, line_i++)
     {
         if(string[i] == '\n')
         {
@@ -31,6 +31,18 @@
 
 #define SCREEN_TOP_WIDTH  400
 #define SCREEN_TOP_HEIGHT 240
+#define SCREEN_TOP_FBSIZE (SCREEN_TOP_WIDTH * SCREEN_TOP_HEIGHT * 3)
+#define SCREEN_BOTTOM_WIDTH  320
+#define SCREEN_BOTTOM_FBSIZE (SCREEN_BOTTOM_WIDTH * SCREEN_TOP_HEIGHT * 3)
+
+//Splashes may be a raw framebuffer, or this header followed by an LZ4 block (see splashtool/)
+#define SPLASH_MAGIC "SPLZ"
+
+typedef struct splashHeader
+{
+    char magic[4];
+    u32 decompressedSize;
+} splashHeader;
 
 #define SPACING_Y 10
 #define SPACING_X 8
@@ -40,6 +52,8 @@
 #define COLOR_RED   0x0000FF
 #define COLOR_BLACK 0x000000
 
-bool loadSplash(void);
+bool loadSplash(bool deferDelay);
+void waitSplash(void);
 void drawCharacter(char character, int posX, int posY, u32 color);
+void drawCell(u8 *framebuffer, char character, int posX, int posY, u32 color);
 int drawString(const char *string, int posX, int posY, u32 color);
\ No newline at end of file
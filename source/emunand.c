@@ -22,106 +22,263 @@
 
 #include "emunand.h"
 #include "memory.h"
+#include "patches.h"
+#include "config.h"
+#include "fs.h"
 #include "fatfs/sdmmc/sdmmc.h"
 #include "../build/emunandpatch.h"
 
-void locateEmuNAND(u32 *off, u32 *head, FirmwareSource *emuNAND)
+static u8 temp[0x200];
+
+//Where the chosen emuNAND is, as (NAND sector, SD sector) pairs. A raw emuNAND is a single one
+static u32 emuExtents[MAX_FILE_EXTENTS * 2],
+           emuExtentCount;
+
+static bool hasNCSDHeader(u32 sector)
 {
-    static u8 temp[0x200];
+    return !sdmmc_sdcard_readsectors(sector, 1, temp) && *(u32 *)(temp + 0x100) == NCSD_MAGIC;
+}
 
-    const u32 nandSize = getMMCDevice(0)->total_size;
-    u32 nandOffset = *emuNAND == FIRMWARE_EMUNAND ? 0 :
-                                  (nandSize > 0x200000 ? 0x400000 : 0x200000);
+//Checks all the slots in the SD's unpartitioned area in one go
+static void scanEmuNANDs(u32 nandSize)
+{
+    //Each emuNAND takes up the NAND size rounded up to 1GB or 2GB
+    const u32 slotSize = nandSize > 0x200000 ? 0x400000 : 0x200000;
+    u32 areaEnd = 0xFFFFFFFF;
 
-    //Check for RedNAND
-    if(!sdmmc_sdcard_readsectors(nandOffset + 1, 1, temp) &&
-       *(u32 *)(temp + 0x100) == NCSD_MAGIC)
+    //The area ends at the first partition, if the MBR says where
+    if(!sdmmc_sdcard_readsectors(0, 1, temp) && temp[0x1FE] == 0x55 && temp[0x1FF] == 0xAA)
     {
-        *off = nandOffset + 1;
-        *head = nandOffset + 1;
+        u32 firstPartition = temp[0x1C6] | (temp[0x1C7] << 8) | (temp[0x1C8] << 16) | ((u32)temp[0x1C9] << 24);
+        if(firstPartition) areaEnd = firstPartition;
     }
 
-    //Check for Gateway emuNAND
-    else if(!sdmmc_sdcard_readsectors(nandOffset + nandSize, 1, temp) &&
-            *(u32 *)(temp + 0x100) == NCSD_MAGIC)
+    for(u32 i = 0; i < EMUNAND_MAX_SLOTS; i++)
+    {
+        u32 nandOffset = i * slotSize;
+        emuNandLocation found = {0, 0, nandSize, EMUNAND_NONE};
+
+        //Check for RedNAND
+        if(nandOffset + 1 < areaEnd && hasNCSDHeader(nandOffset + 1))
+        {
+            found.offset = nandOffset + 1;
+            found.header = nandOffset + 1;
+            found.type = EMUNAND_REDNAND;
+        }
+
+        //Check for Gateway emuNAND
+        else if(nandOffset + nandSize < areaEnd && hasNCSDHeader(nandOffset + nandSize))
+        {
+            found.offset = nandOffset;
+            found.header = nandOffset + nandSize;
+            found.type = EMUNAND_GATEWAY;
+        }
+
+        //A NAND image's slot stays as it is, it's checked again when it's picked
+        if(found.type != EMUNAND_NONE || configData.emuNands[i].type != EMUNAND_FILE) configData.emuNands[i] = found;
+    }
+}
+
+//Maps /luma/emunandN.bin for a slot, and records it if the hook can redirect to it
+static bool mapEmuNandFile(u32 slot, u32 nandSize)
+{
+    char path[] = "/luma/emunand1.bin";
+    path[13] = '1' + slot;
+
+    u32 fileSectors;
+    emuExtentCount = fileExtents(path, emuExtents, &fileSectors);
+
+    if(!emuExtentCount || fileSectors < nandSize || !hasNCSDHeader(emuExtents[1])) return false;
+
+    /* Process9 only goes through the hook when it sets up a partition, which gets moved as a whole
+       to where its first sector is. So no partition can span two fragments of the file */
+    const u32 *partitions = (const u32 *)(temp + 0x120);
+
+    for(u32 i = 0; i < 8; i++)
+    {
+        u32 start = partitions[i * 2],
+            size = partitions[i * 2 + 1];
+
+        if(!size) continue;
+
+        u32 j = emuExtentCount - 1;
+        while(emuExtents[j * 2] > start) j--;
+
+        u32 extentEnd = j + 1 < emuExtentCount ? emuExtents[(j + 1) * 2] : fileSectors;
+        if(start + size > extentEnd) return false;
+    }
+
+    //Sector 0 is the NCSD header in a NAND image, no need for the GW offset
+    emuNandLocation location = {emuExtents[1], 0, nandSize, EMUNAND_FILE};
+    configData.emuNands[slot] = location;
+
+    return true;
+}
+
+//Checks the stored location of an emuNAND, and makes it the one the reads go to
+static bool useEmuNAND(u32 slot, u32 nandSize)
+{
+    const emuNandLocation *location = &configData.emuNands[slot];
+
+    if(location->type == EMUNAND_NONE || location->nandSize != nandSize) return false;
+
+    //The cluster chain is looked up again on every boot, the file might have been replaced
+    if(location->type == EMUNAND_FILE) return mapEmuNandFile(slot, nandSize);
+
+    if(!hasNCSDHeader(location->header)) return false;
+
+    emuExtents[0] = 0;
+    emuExtents[1] = location->offset;
+    emuExtentCount = 1;
+
+    return true;
+}
+
+bool locateEmuNAND(u32 *off, u32 *head, FirmwareSource *emuNAND)
+{
+    const u32 nandSize = getMMCDevice(0)->total_size;
+    u32 slot = *emuNAND - 1;
+
+    emuNandLocation previous[EMUNAND_MAX_SLOTS];
+    memcpy(previous, configData.emuNands, sizeof(previous));
+
+    //Trust the stored location if its header is still there, else look at all of them again
+    if(!useEmuNAND(slot, nandSize))
     {
-        *off = nandOffset;
-        *head = nandOffset + nandSize;
+        scanEmuNANDs(nandSize);
+
+        //NAND images are only used for slots without an emuNAND in the unpartitioned area
+        if(!useEmuNAND(slot, nandSize) && !mapEmuNandFile(slot, nandSize))
+        {
+            /* Fallback to the first emuNAND if the chosen one doesn't exist,
+               or to SysNAND if there isn't any */
+            slot = 0;
+            *emuNAND = useEmuNAND(0, nandSize) || mapEmuNandFile(0, nandSize) ? FIRMWARE_EMUNAND : FIRMWARE_SYSNAND;
+        }
     }
 
-    /* Fallback to the first emuNAND if there's no second one,
-       or to SysNAND if there isn't any */
-    else
+    if(*emuNAND != FIRMWARE_SYSNAND)
     {
-        *emuNAND = (*emuNAND == FIRMWARE_EMUNAND2) ? FIRMWARE_EMUNAND : FIRMWARE_SYSNAND;
-        if(*emuNAND) locateEmuNAND(off, head, emuNAND);
+        *off = configData.emuNands[slot].offset;
+        *head = configData.emuNands[slot].header;
     }
+
+    return memcmp(previous, configData.emuNands, sizeof(previous)) != 0;
+}
+
+//Where a sector of the chosen emuNAND is in the SD
+u32 emuNandSector(u32 sector)
+{
+    u32 i = emuExtentCount - 1;
+    while(emuExtents[i * 2] > sector) i--;
+
+    return sector - emuExtents[i * 2] + emuExtents[i * 2 + 1];
+}
+
+//Identifies the extent table patched in, for the FIRM cache
+u32 emuNandLayout(void)
+{
+    u32 hash = 2166136261U;
+
+    for(u32 i = 0; i < emuExtentCount * 2; i++)
+        hash = (hash ^ emuExtents[i]) * 16777619U;
+
+    return hash;
 }
 
 static inline void *getEmuCode(u8 *pos, u32 size)
 {
-    const u8 pattern[] = {0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0x00};
+    static const u8 pattern[] = {0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0x00};
+
+    //Looking for the last free space before Process9, which is 0x455 bytes past this
+    static const patchDescriptor patches[] = {
+        {{pattern, NULL, 6}, 0x455, NULL, 0, 1, NULL, RELOC_NONE}
+    };
+    static patchTable table = PATCH_TABLE(patches);
+
+    u8 *emuCode;
+    applyPatches(pos + 0x13500, size - 0x13500, &table, 1, NULL, &emuCode);
 
-    //Looking for the last free space before Process9
-    return memsearch(pos + 0x13500, pattern, size - 0x13500, 6) + 0x455;
+    return emuCode;
 }
 
 static inline u32 getSDMMC(u8 *pos, u32 size)
 {
     //Look for struct code
-    const u8 pattern[] = {0x21, 0x20, 0x18, 0x20};
-    const u8 *off = memsearch(pos, pattern, size, 4);
+    const u8 *off = findProcess9Pattern(PATTERN_SDMMC, pos, size);
 
     return *(u32 *)(off + 9) + *(u32 *)(off + 0xD);
 }
 
 static inline void patchNANDRW(u8 *pos, u32 size, u32 branchOffset)
 {
-    const u16 nandRedir[2] = {0x4C00, 0x47A0};
+    static const u16 nandRedir[2] = {0x4C00, 0x47A0};
 
-    //Look for read/write code
-    const u8 pattern[] = {0x1E, 0x00, 0xC8, 0x05};
+    //Call the emuNAND code from the read code, and from the write code in the 0x100 bytes after it
+    static const patchDescriptor patches[] = {
+        {{nandRWPattern, NULL, sizeof(nandRWPattern)}, -6, nandRedir, 4, 2, NULL, RELOC_ABS32}
+    };
+    static patchTable table = PATCH_TABLE(patches);
 
-    u16 *readOffset = (u16 *)memsearch(pos, pattern, size, 4) - 3,
-        *writeOffset = (u16 *)memsearch((u8 *)(readOffset + 5), pattern, 0x100, 4) - 3;
+    //Look for read/write code
+    u8 *readOffset = findProcess9Pattern(PATTERN_NAND_RW, pos, size);
 
-    *readOffset = nandRedir[0];
-    readOffset[1] = nandRedir[1];
-    ((u32 *)readOffset)[1] = branchOffset;
-    *writeOffset = nandRedir[0];
-    writeOffset[1] = nandRedir[1];
-    ((u32 *)writeOffset)[1] = branchOffset;
+    applyPatches(readOffset, 6 + sizeof(nandRWPattern) + 0x100, &table, 1, &branchOffset, NULL);
 }
 
 static inline void patchMPU(u8 *pos, u32 size)
 {
-    const u32 mpuPatch[3] = {0x00360003, 0x00200603, 0x001C0603};
+    //Look for MPU pattern, the region settings 6 and 9 words past it are changed too
+    static const u32 mpuPattern[10] = {0x00240003},
+                     mpuPatch[10] = {[0] = 0x00360003, [6] = 0x00200603, [9] = 0x001C0603},
+                     mpuPatchMask[10] = {[0] = 0xFFFFFFFF, [6] = 0xFFFFFFFF, [9] = 0xFFFFFFFF};
+    static const u8 mpuMask[sizeof(mpuPattern)] = {0xFF, 0xFF, 0xFF, 0xFF};
 
-    //Look for MPU pattern
-    const u8 pattern[] = {0x03, 0x00, 0x24, 0x00};
+    static const patchDescriptor patches[] = {
+        {{mpuPattern, mpuMask, sizeof(mpuPattern)}, 0, mpuPatch, sizeof(mpuPatch), 1, (const u8 *)mpuPatchMask, RELOC_NONE}
+    };
+    static patchTable table = PATCH_TABLE(patches);
 
-    u32 *off = (u32 *)memsearch(pos, pattern, size, 4);
-
-    off[0] = mpuPatch[0];
-    off[6] = mpuPatch[1];
-    off[9] = mpuPatch[2];
+    applyPatches(pos, size, &table, 1, NULL, NULL);
 }
 
-void patchEmuNAND(u8 *arm9Section, u32 arm9SectionSize, u8 *process9Offset, u32 process9Size, u32 emuOffset, u32 emuHeader, u32 branchAdditive)
+typedef enum EmuCodeValue
 {
+    EMU_SDMMC = 0,
+    EMU_HEADER,
+    EMU_EXTENT_COUNT,
+    EMU_EXTENTS,
+    EMU_VALUES
+} EmuCodeValue;
+
+void patchEmuNAND(u8 *arm9Section, u32 arm9SectionSize, u8 *process9Offset, u32 process9Size, u32 emuHeader, u32 branchAdditive)
+{
+    //What the emuNAND code gets, indexed by EmuCodeValue
+    static const patchDescriptor emuCodePatches[EMU_VALUES] = {
+        {{"SDMC", NULL, 4}, 0, NULL, 0, 1, NULL, RELOC_ABS32},
+        {{"NCSD", NULL, 4}, 0, NULL, 0, 1, NULL, RELOC_ABS32},
+        {{"EXTC", NULL, 4}, 0, NULL, 0, 1, NULL, RELOC_ABS32},
+
+        //The table follows its address, which is where it's going to be once Process9 runs
+        {{"EXTA", NULL, 4}, 0, NULL, 0, 1, NULL, RELOC_ADDRESS32}
+    };
+    static patchTable emuCodeTable = PATCH_TABLE(emuCodePatches);
+
     //Copy emuNAND code
     void *emuCodeOffset = getEmuCode(arm9Section, arm9SectionSize);
     memcpy(emuCodeOffset, emunand, emunand_size);
 
-    //Add the data of the found emuNAND
-    u32 *pos_offset = (u32 *)memsearch(emuCodeOffset, "NAND", emunand_size, 4),
-        *pos_header = (u32 *)memsearch(emuCodeOffset, "NCSD", emunand_size, 4);
-    *pos_offset = emuOffset;
-    *pos_header = emuHeader;
+    //Add the SDMMC struct and the data of the found emuNAND
+    const u32 values[EMU_VALUES] = {
+        getSDMMC(process9Offset, process9Size),
+        emuHeader,
+        emuExtentCount,
+        4 - branchAdditive
+    };
+    u8 *pos[EMU_VALUES];
 
-    //Find and add the SDMMC struct
-    u32 *pos_sdmmc = (u32 *)memsearch(emuCodeOffset, "SDMC", emunand_size, 4);
-    *pos_sdmmc = getSDMMC(process9Offset, process9Size);
+    applyPatches(emuCodeOffset, emunand_size, &emuCodeTable, (1u << EMU_VALUES) - 1, values, pos);
+    memcpy(pos[EMU_EXTENTS] + 4, emuExtents, emuExtentCount * 8);
 
     //Add emuNAND hooks
     u32 branchOffset = (u32)emuCodeOffset - branchAdditive;
@@ -26,5 +26,7 @@
 
 #define NCSD_MAGIC 0x4453434E
 
-void locateEmuNAND(u32 *off, u32 *head, FirmwareSource *emuNAND);
-void patchEmuNAND(u8 *arm9Section, u32 arm9SectionSize, u8 *process9Offset, u32 process9Size, u32 emuOffset, u32 emuHeader, u32 branchAdditive);
\ No newline at end of file
+bool locateEmuNAND(u32 *off, u32 *head, FirmwareSource *emuNAND);
+u32 emuNandSector(u32 sector);
+u32 emuNandLayout(void);
+void patchEmuNAND(u8 *arm9Section, u32 arm9SectionSize, u8 *process9Offset, u32 process9Size, u32 emuHeader, u32 branchAdditive);
\ No newline at end of file
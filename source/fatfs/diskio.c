@@ -10,11 +10,98 @@
 #include "diskio.h"		/* FatFs lower layer API */
 #include "sdmmc/sdmmc.h"
 #include "../crypto.h"
+#include "../memory.h"
 
 /* Definitions of physical drive number for each media */
 #define SDCARD        0
 #define CTRNAND       1
 
+/* Sector cache geometry. Requests of CACHE_BYPASS sectors or more are file
+   data and go straight to the drivers, smaller ones (FAT, directories) are
+   served from the cache and extended by READ_AHEAD sectors on a miss */
+#define CACHE_SECTORS 64
+#define READ_AHEAD    8
+#define CACHE_BYPASS  16
+#define MAX_TRANSFER  0x8000
+
+/* Cache and read staging buffers live in otherwise unused FCRAM, above the stack */
+#define CACHE_DATA    ((BYTE (*)[0x200])0x27E00000)
+#define STAGING_BUF   ((BYTE *)(0x27E00000 + CACHE_SECTORS * 0x200))
+
+typedef struct {
+	DWORD sector;
+	DWORD lastUse;
+	BYTE pdrv;
+	BYTE valid;
+} CacheEntry;
+
+static CacheEntry cache[CACHE_SECTORS];
+static DWORD cacheTick,
+             cacheHits,
+             cacheMisses;
+
+static int cacheLookup(BYTE pdrv, DWORD sector)
+{
+        for(int i = 0; i < CACHE_SECTORS; i++)
+            if(cache[i].valid && cache[i].pdrv == pdrv && cache[i].sector == sector) return i;
+
+        return -1;
+}
+
+static void cacheInsert(BYTE pdrv, DWORD sector, const BYTE *data)
+{
+        int slot = cacheLookup(pdrv, sector);
+
+        //Reuse the slot holding this sector, else the first free or least recently used one
+        if(slot == -1)
+        {
+            slot = 0;
+            for(int i = 0; i < CACHE_SECTORS; i++)
+            {
+                if(!cache[i].valid)
+                {
+                    slot = i;
+                    break;
+                }
+                if(cache[i].lastUse < cache[slot].lastUse) slot = i;
+            }
+        }
+
+        memcpy(CACHE_DATA[slot], data, 0x200);
+        cache[slot].pdrv = pdrv;
+        cache[slot].sector = sector;
+        cache[slot].lastUse = ++cacheTick;
+        cache[slot].valid = 1;
+}
+
+static void cacheInvalidate(BYTE pdrv)
+{
+        for(int i = 0; i < CACHE_SECTORS; i++)
+            if(cache[i].pdrv == pdrv) cache[i].valid = 0;
+}
+
+static DWORD readSectors(BYTE pdrv, DWORD sector, UINT count, BYTE *buff)
+{
+        //Whole file fragments can be requested, but the block count registers are 16-bit
+        while(count > MAX_TRANSFER)
+        {
+            DWORD res = readSectors(pdrv, sector, MAX_TRANSFER, buff);
+            if(res) return res;
+
+            sector += MAX_TRANSFER;
+            count -= MAX_TRANSFER;
+            buff += MAX_TRANSFER * 0x200;
+        }
+
+        return pdrv == SDCARD ? sdmmc_sdcard_readsectors(sector, count, buff) : ctrNandRead(sector, count, buff);
+}
+
+void disk_getCacheStats(DWORD *hits, DWORD *misses)
+{
+        *hits = cacheHits;
+        *misses = cacheMisses;
+}
+
 /*-----------------------------------------------------------------------*/
 /* Get Drive Status                                                      */
 /*-----------------------------------------------------------------------*/
@@ -47,6 +134,8 @@ DSTATUS disk_initialize (
                 break;
         }
 
+        cacheInvalidate(pdrv);
+
 	return RES_OK;
 }
 
@@ -63,16 +152,49 @@ DRESULT disk_read (
 	UINT count		/* Number of sectors to read */
 )
 {
-        switch(pdrv)
+        if(pdrv > CTRNAND) return RES_PARERR;
+
+        //Large reads are file contents, don't let them flush the cache
+        if(count >= CACHE_BYPASS)
+            return readSectors(pdrv, sector, count, buff) ? RES_PARERR : RES_OK;
+
+        while(count)
         {
-            case SDCARD:
-                if(sdmmc_sdcard_readsectors(sector, count, (BYTE *)buff))
-		    return RES_PARERR;
-                break;
-            case CTRNAND:
-                if(ctrNandRead(sector, count, (BYTE *)buff))
-		    return RES_PARERR;
-                break;
+            int slot = cacheLookup(pdrv, sector);
+
+            if(slot != -1)
+            {
+                cacheHits++;
+                cache[slot].lastUse = ++cacheTick;
+                memcpy(buff, CACHE_DATA[slot], 0x200);
+                buff += 0x200;
+                sector++;
+                count--;
+                continue;
+            }
+
+            //Fetch the whole run of missing sectors plus the read-ahead in one command
+            UINT run = 1;
+            while(run < count && cacheLookup(pdrv, sector + run) == -1) run++;
+
+            cacheMisses += run;
+
+            UINT total = run + READ_AHEAD;
+
+            //The read-ahead may run past the end of the medium, retry with the exact range
+            if(readSectors(pdrv, sector, total, STAGING_BUF))
+            {
+                total = run;
+                if(readSectors(pdrv, sector, total, STAGING_BUF)) return RES_PARERR;
+            }
+
+            for(UINT i = 0; i < total; i++)
+                cacheInsert(pdrv, sector + i, STAGING_BUF + i * 0x200);
+
+            memcpy(buff, STAGING_BUF, run * 0x200);
+            buff += run * 0x200;
+            sector += run;
+            count -= run;
         }
 
         return RES_OK;
@@ -92,6 +214,8 @@ DRESULT disk_write (
 	UINT count			/* Number of sectors to write */
 )
 {
+        cacheInvalidate(pdrv);
+
         if(pdrv == SDCARD && sdmmc_sdcard_writesectors(sector, count, (BYTE *)buff))
             return RES_PARERR;
 
@@ -1415,6 +1415,34 @@ DWORD clmt_clust (	/* <2:Error, >=2:Cluster number */
 	return cl + *tbl;	/* Return the cluster number */
 }
 
+
+
+
+/*-----------------------------------------------------------------------*/
+/* FAT handling - Get contiguous clusters with link map table            */
+/*-----------------------------------------------------------------------*/
+
+static
+DWORD clmt_run (	/* 0:Error, >=1:Number of clusters from the one containing ofs to the end of its fragment */
+	FIL* fp,		/* Pointer to the file object */
+	FSIZE_t ofs		/* File offset */
+)
+{
+	DWORD cl, ncl, *tbl;
+	FATFS *fs = fp->obj.fs;
+
+
+	tbl = fp->cltbl + 1;	/* Top of CLMT */
+	cl = (DWORD)(ofs / SS(fs) / fs->csize);	/* Cluster order from top of the file */
+	for (;;) {
+		ncl = *tbl++;			/* Number of cluters in the fragment */
+		if (ncl == 0) return 0;	/* End of table? (error) */
+		if (cl < ncl) break;	/* In this fragment? */
+		cl -= ncl; tbl++;		/* Next fragment */
+	}
+	return ncl - cl;	/* Return the clusters left in the fragment */
+}
+
 #endif	/* _USE_FASTSEEK */
 
 
@@ -3492,12 +3520,24 @@ FRESULT f_read (
 			sect += csect;
 			cc = btr / SS(fs);					/* When remaining bytes >= sector size, */
 			if (cc) {							/* Read maximum contiguous sectors directly */
-				if (csect + cc > fs->csize) {	/* Clip at cluster boundary */
-					cc = fs->csize - csect;
+				if (csect + cc > fs->csize) {
+#if _USE_FASTSEEK
+					if (fp->cltbl) {			/* Clip at the end of the fragment, its clusters are contiguous */
+						DWORD ncl = clmt_run(fp, fp->fptr);
+						if (ncl == 0) ABORT(fs, FR_INT_ERR);
+						if (csect + cc > ncl * fs->csize) cc = (UINT)(ncl * fs->csize - csect);
+					} else
+#endif
+					{							/* Clip at cluster boundary */
+						cc = fs->csize - csect;
+					}
 				}
 				if (disk_read(fs->drv, rbuff, sect, cc) != RES_OK) {
 					ABORT(fs, FR_DISK_ERR);
 				}
+#if _USE_FASTSEEK
+				fp->clust += (csect + cc - 1) / fs->csize;	/* Move to the cluster of the last sector read */
+#endif
 #if !_FS_READONLY && _FS_MINIMIZE <= 2			/* Replace one of the read sectors with cached data if it contains a dirty sector */
 #if _FS_TINY
 				if (fs->wflag && fs->winsect - sect < cc) {
@@ -8,6 +8,15 @@
 struct mmcdevice handleNAND;
 struct mmcdevice handleSD;
 
+static sdmmc_idle_callback idleCallback = NULL;
+
+#ifdef SDMMC_REGISTER_MODEL
+//The controller is simulated by the host test harness, see test/sdmmctest.c
+u16 sdmmc_read16(u16 reg);
+void sdmmc_write16(u16 reg, u16 val);
+u32 sdmmc_read32(u16 reg);
+void sdmmc_write32(u16 reg, u32 val);
+#else
 static inline u16 sdmmc_read16(u16 reg) {
     return *(vu16*)(SDMMC_BASE + reg);
 }
@@ -23,6 +32,7 @@ static inline u32 sdmmc_read32(u16 reg) {
 static inline void sdmmc_write32(u16 reg, u32 val) {
     *(vu32*)(SDMMC_BASE + reg) = val;
 }
+#endif
 
 static inline void sdmmc_mask16(u16 reg, const u16 clear, const u16 set) {
     u16 val = sdmmc_read16(reg);
@@ -39,6 +49,11 @@ static inline void setckl(u32 data)
 }
 
 
+void sdmmc_set_idle_callback(sdmmc_idle_callback callback)
+{
+    idleCallback = callback;
+}
+
 mmcdevice *getMMCDevice(int drive)
 {
     if(drive==0) return &handleNAND;
@@ -78,7 +93,12 @@ static void __attribute__((noinline)) sdmmc_send_command(struct mmcdevice *ctx,
     sdmmc_write16(REG_SDIRMASK1,0);
     sdmmc_write16(REG_SDSTATUS0,0);
     sdmmc_write16(REG_SDSTATUS1,0);
+#ifdef DATA32_SUPPORT
+    if (readdata) sdmmc_mask16(REG_SDDATACTL32, 0x1000, 0x800);
+    if (writedata) sdmmc_mask16(REG_SDDATACTL32, 0x800, 0x1000);
+#else
     sdmmc_mask16(REG_SDDATACTL32,0x1800,0);
+#endif
 
     sdmmc_write16(REG_SDCMDARG0,args &0xFFFF);
     sdmmc_write16(REG_SDCMDARG1,args >> 16);
@@ -89,35 +109,102 @@ static void __attribute__((noinline)) sdmmc_send_command(struct mmcdevice *ctx,
 
     bool useBuf = ( NULL != dataPtr );
 
+    //Aligned buffers are moved a whole FIFO word at a time, the others go through the byte path
+#ifdef DATA32_SUPPORT
+    bool useWords = ((u32)dataPtr & 3) == 0;
+#else
+    bool useWords = ((u32)dataPtr & 1) == 0;
+#endif
+
     u16 status0 = 0;
     while(true) {
+        bool moved = false;
         u16 status1 = sdmmc_read16(REG_SDSTATUS1);
+#ifdef DATA32_SUPPORT
+        u16 ctl32 = sdmmc_read16(REG_SDDATACTL32);
+        if (ctl32 & 0x100) { //32-bit RX FIFO full
+#else
         if (status1 & TMIO_STAT1_RXRDY) {
+#endif
             if (readdata && useBuf) {
                 sdmmc_mask16(REG_SDSTATUS1, TMIO_STAT1_RXRDY, 0);
                 //sdmmc_write16(REG_SDSTATUS1,~TMIO_STAT1_RXRDY);
                 if (size > 0x1FF) {
-                    for(int i = 0; i<0x200; i+=2) {
-                        u16 data = sdmmc_read16(REG_SDFIFO);
-                        *dataPtr++ = data & 0xFF;
-                        *dataPtr++ = data >> 8;
+#ifdef DATA32_SUPPORT
+                    if (useWords) {
+                        vu32 *dataPtr32 = (vu32 *)dataPtr;
+                        for(int i = 0; i<0x200; i+=4)
+                            *dataPtr32++ = sdmmc_read32(REG_SDFIFO32);
+                        dataPtr = (vu8 *)dataPtr32;
+                    } else {
+                        for(int i = 0; i<0x200; i+=4) {
+                            u32 data = sdmmc_read32(REG_SDFIFO32);
+                            *dataPtr++ = data & 0xFF;
+                            *dataPtr++ = (data >> 8) & 0xFF;
+                            *dataPtr++ = (data >> 16) & 0xFF;
+                            *dataPtr++ = data >> 24;
+                        }
+                    }
+#else
+                    if (useWords) {
+                        vu16 *dataPtr16 = (vu16 *)dataPtr;
+                        for(int i = 0; i<0x200; i+=2)
+                            *dataPtr16++ = sdmmc_read16(REG_SDFIFO);
+                        dataPtr = (vu8 *)dataPtr16;
+                    } else {
+                        for(int i = 0; i<0x200; i+=2) {
+                            u16 data = sdmmc_read16(REG_SDFIFO);
+                            *dataPtr++ = data & 0xFF;
+                            *dataPtr++ = data >> 8;
+                        }
                     }
+#endif
                     size -= 0x200;
+                    moved = true;
                 }
             }
         }
 
+#ifdef DATA32_SUPPORT
+        if (!(ctl32 & 0x200)) { //32-bit TX FIFO not full
+#else
         if (status1 & TMIO_STAT1_TXRQ) {
+#endif
             if (writedata && useBuf) {
                 sdmmc_mask16(REG_SDSTATUS1, TMIO_STAT1_TXRQ, 0);
                 //sdmmc_write16(REG_SDSTATUS1,~TMIO_STAT1_TXRQ);
                 if (size > 0x1FF) {
-                    for (int i = 0; i<0x200; i+=2) {
-                        u16 data = *dataPtr++;
-                        data |= *dataPtr++ << 8;
-                        sdmmc_write16(REG_SDFIFO, data);
+#ifdef DATA32_SUPPORT
+                    if (useWords) {
+                        vu32 *dataPtr32 = (vu32 *)dataPtr;
+                        for (int i = 0; i<0x200; i+=4)
+                            sdmmc_write32(REG_SDFIFO32, *dataPtr32++);
+                        dataPtr = (vu8 *)dataPtr32;
+                    } else {
+                        for (int i = 0; i<0x200; i+=4) {
+                            u32 data = *dataPtr++;
+                            data |= (u32)*dataPtr++ << 8;
+                            data |= (u32)*dataPtr++ << 16;
+                            data |= (u32)*dataPtr++ << 24;
+                            sdmmc_write32(REG_SDFIFO32, data);
+                        }
                     }
+#else
+                    if (useWords) {
+                        vu16 *dataPtr16 = (vu16 *)dataPtr;
+                        for (int i = 0; i<0x200; i+=2)
+                            sdmmc_write16(REG_SDFIFO, *dataPtr16++);
+                        dataPtr = (vu8 *)dataPtr16;
+                    } else {
+                        for (int i = 0; i<0x200; i+=2) {
+                            u16 data = *dataPtr++;
+                            data |= *dataPtr++ << 8;
+                            sdmmc_write16(REG_SDFIFO, data);
+                        }
+                    }
+#endif
                     size -= 0x200;
+                    moved = true;
                 }
             }
         }
@@ -126,6 +213,8 @@ static void __attribute__((noinline)) sdmmc_send_command(struct mmcdevice *ctx,
             break;
         }
 
+        if (!moved && idleCallback != NULL) idleCallback();
+
         if (!(status1 & TMIO_STAT1_CMD_BUSY)) {
             status0 = sdmmc_read16(REG_SDSTATUS0);
             if (sdmmc_read16(REG_SDSTATUS0) & TMIO_STAT0_CMDRESPEND)
@@ -156,7 +245,10 @@ u32 __attribute__((noinline)) sdmmc_sdcard_writesectors(u32 sector_no, u32 numse
         sector_no <<= 9;
     inittarget(&handleSD);
     sdmmc_write16(REG_SDSTOP,0x100);
-
+#ifdef DATA32_SUPPORT
+    sdmmc_write16(REG_SDBLKCOUNT32,numsectors);
+    sdmmc_write16(REG_SDBLKLEN32,0x200);
+#endif
     sdmmc_write16(REG_SDBLKCOUNT,numsectors);
     handleSD.data = in;
     handleSD.size = numsectors << 9;
@@ -170,7 +262,10 @@ u32 __attribute__((noinline)) sdmmc_sdcard_readsectors(u32 sector_no, u32 numsec
         sector_no <<= 9;
     inittarget(&handleSD);
     sdmmc_write16(REG_SDSTOP,0x100);
-
+#ifdef DATA32_SUPPORT
+    sdmmc_write16(REG_SDBLKCOUNT32,numsectors);
+    sdmmc_write16(REG_SDBLKLEN32,0x200);
+#endif
     sdmmc_write16(REG_SDBLKCOUNT,numsectors);
     handleSD.data = out;
     handleSD.size = numsectors << 9;
@@ -184,7 +279,10 @@ u32 __attribute__((noinline)) sdmmc_nand_readsectors(u32 sector_no, u32 numsecto
         sector_no <<= 9;
     inittarget(&handleNAND);
     sdmmc_write16(REG_SDSTOP,0x100);
-
+#ifdef DATA32_SUPPORT
+    sdmmc_write16(REG_SDBLKCOUNT32,numsectors);
+    sdmmc_write16(REG_SDBLKLEN32,0x200);
+#endif
     sdmmc_write16(REG_SDBLKCOUNT,numsectors);
 
     handleNAND.data = out;
@@ -245,9 +343,15 @@ static void InitSD()
     *(vu16*)0x10006100 &= 0xEFFFu; //SDDATACTL32
     *(vu16*)0x10006100 |= 0x402u; //SDDATACTL32
     *(vu16*)0x100060D8 = (*(vu16*)0x100060D8 & 0xFFDD) | 2;
+#ifdef DATA32_SUPPORT
+    //Keep the 32-bit data port enabled
+    *(vu16*)0x100060D8 &= 0xFFDFu; //SDDATACTL
+    *(vu16*)0x10006104 = 512; //SDBLKLEN32
+#else
     *(vu16*)0x10006100 &= 0xFFFDu; //SDDATACTL32
     *(vu16*)0x100060D8 &= 0xFFDDu; //SDDATACTL
     *(vu16*)0x10006104 = 0; //SDBLKLEN32
+#endif
     *(vu16*)0x10006108 = 1; //SDBLKCOUNT32
     *(vu16*)0x100060E0 &= 0xFFFEu; //SDRESET
     *(vu16*)0x100060E0 |= 1u; //SDRESET
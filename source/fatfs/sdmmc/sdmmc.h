@@ -6,6 +6,11 @@
 
 #include "common.h"
 
+//Move sector data through the 32-bit FIFO instead of the 16-bit one
+#ifndef SDMMC_FIFO16
+#define DATA32_SUPPORT
+#endif
+
 #define SDMMC_BASE              0x10006000u
 
 #define REG_SDCMD               0x00
@@ -118,8 +123,13 @@ typedef struct mmcdevice {
     u32 res;
 } mmcdevice;
 
+typedef void (*sdmmc_idle_callback)(void);
+
 mmcdevice *getMMCDevice(int drive);
 
+//Register a short function to run whenever a transfer is waiting on the card
+void sdmmc_set_idle_callback(sdmmc_idle_callback callback);
+
 void sdmmc_sdcard_init();
 u32 sdmmc_sdcard_readsectors(u32 sector_no, u32 numsectors, vu8 *out);
 u32 sdmmc_sdcard_writesectors(u32 sector_no, u32 numsectors, vu8 *in);
@@ -33,6 +33,7 @@
 #include "screen.h"
 #include "buttons.h"
 #include "pin.h"
+#include "profile.h"
 #include "../build/injector.h"
 
 extern u16 launchedFirmTIDLow[8]; //Defined in start.s
@@ -40,7 +41,13 @@ extern u16 launchedFirmTIDLow[8]; //Defined in start.s
 static firmHeader *const firm = (firmHeader *)0x24000000;
 static const firmSectionHeader *section;
 
-u32 emuOffset;
+//Set when the sections were decrypted straight to their load addresses
+static bool sectionsInPlace = false;
+
+//Size of each section once loaded, section0 changes size when 3ds_injector is injected
+static u32 sectionSizes[4];
+
+static u32 emuOffset;
 
 bool isN3DS,
      isDevUnit,
@@ -60,6 +67,9 @@ void main(void)
     FirmwareSource nandType;
     ConfigurationStatus needConfig;
 
+    //Start the 67MHz chrono, it's used to time the boot stages and delays
+    startChrono(0);
+
     //Detect the console being used
     isN3DS = PDN_MPCORE_CFG == 7;
 
@@ -68,11 +78,13 @@ void main(void)
 
     //Mount filesystems. CTRNAND will be mounted only if/when needed
     mountFs();
+    profileStage(STAGE_MOUNT_FS);
 
     const char configPath[] = "/luma/config.bin";
 
     //Attempt to read the configuration file
     needConfig = readConfig(configPath) ? MODIFY_CONFIGURATION : CREATE_CONFIGURATION;
+    profileStage(STAGE_READ_CONFIG);
 
     //Determine if this is a firmlaunch boot
     if(launchedFirmTIDLow[5] != 0)
@@ -152,7 +164,7 @@ void main(void)
             }
             else
             {
-                if(CONFIG(7) && loadSplash()) pressed = HID_PAD;
+                if(CONFIG(7) && loadSplash(false)) pressed = HID_PAD;
 
                 /* If L and R/A/Select or one of the single payload buttons are pressed,
                    chainload an external payload */
@@ -160,7 +172,8 @@ void main(void)
 
                 if(shouldLoadPayload) loadPayload(pressed);
 
-                if(!CONFIG(7)) loadSplash();
+                //Unless it's needed to choose a payload, the FIRM can be loaded while the splash is shown
+                if(!CONFIG(7)) loadSplash(CONFIG(9));
 
                 //Determine if the user chose to use the SysNAND FIRM as default for a R boot
                 bool useSysAsDefault = isA9lh ? CONFIG(1) : false;
@@ -181,35 +194,62 @@ void main(void)
                 }
 
                 /* If we're booting emuNAND the second emuNAND is set as default and B isn't pressed,
-                   or vice-versa, boot the second emuNAND */
-                if(nandType != FIRMWARE_SYSNAND && (CONFIG(2) == !(pressed & BUTTON_B))) nandType = FIRMWARE_EMUNAND2;
+                   or vice-versa, boot the second emuNAND (which may be the one in the third slot) */
+                if(nandType != FIRMWARE_SYSNAND && (CONFIG(2) == !(pressed & BUTTON_B)))
+                    nandType = MULTICONFIG(2) ? FIRMWARE_EMUNAND3 : FIRMWARE_EMUNAND2;
             }
         }
     }
 
+    profileStage(STAGE_BOOT_OPTIONS);
+
+    bool emuNandsChanged = false;
+
     //If we need to boot emuNAND, make sure it exists
     if(nandType != FIRMWARE_SYSNAND)
     {
-        locateEmuNAND(&emuOffset, &emuHeader, &nandType);
+        emuNandsChanged = locateEmuNAND(&emuOffset, &emuHeader, &nandType);
         if(nandType == FIRMWARE_SYSNAND) firmSource = FIRMWARE_SYSNAND;
     }
 
     //Same if we're using emuNAND as the FIRM source
     else if(firmSource != FIRMWARE_SYSNAND)
-        locateEmuNAND(&emuOffset, &emuHeader, &firmSource);
+        emuNandsChanged = locateEmuNAND(&emuOffset, &emuHeader, &firmSource);
+
+    profileStage(STAGE_LOCATE_EMUNAND);
 
     if(!isFirmlaunch)
     {
         configTemp |= (u32)nandType | ((u32)firmSource << 2);
-        writeConfig(configPath, configTemp);
+        writeConfig(configPath, configTemp, emuNandsChanged);
+        profileStage(STAGE_WRITE_CONFIG);
     }
 
-    u32 firmVersion = loadFirm(&firmType, firmSource);
+    firmCacheKey cacheKey = {
+        .commitHash = COMMIT_HASH,
+        .console = (u32)isN3DS | ((u32)isDevUnit << 1),
+        .nandType = (u32)nandType,
+        .firmSource = (u32)firmSource,
+        .emuOffset = emuOffset,
+        .emuHeader = nandType != FIRMWARE_SYSNAND ? emuHeader : 0,
+        .emuLayout = nandType != FIRMWARE_SYSNAND ? emuNandLayout() : 0,
+        .config = configData.config
+    };
+    bool loadedFromCache;
+
+    u32 firmVersion = loadFirm(&firmType, firmSource, &cacheKey, &loadedFromCache);
 
     switch(firmType)
     {
         case NATIVE_FIRM:
-            patchNativeFirm(firmVersion, nandType, emuHeader, isA9lh);
+            if(loadedFromCache) setCachedNativeFirmKeys(firmVersion, isA9lh);
+            else
+            {
+                patchNativeFirm(firmVersion, nandType, emuHeader, isA9lh);
+
+                //Only FIRMs from CTRNAND are cached, they're loaded in place
+                if(sectionsInPlace) saveCachedFirm(firm, &cacheKey, sectionSizes);
+            }
             break;
         case SAFE_FIRM:
         case NATIVE_FIRM2X:
@@ -221,15 +261,40 @@ void main(void)
             break;
     }
 
+    profileStage(STAGE_FIRM_PATCH);
+    profileSave((u32)firmType, (u32)isN3DS | ((u32)isA9lh << 1) | ((u32)isFirmlaunch << 2) | ((u32)nandType << 3) | ((u32)firmSource << 5));
+
     launchFirm(firmType);
 }
 
-static inline u32 loadFirm(FirmwareType *firmType, FirmwareSource firmSource)
+static inline u32 loadFirm(FirmwareType *firmType, FirmwareSource firmSource, firmCacheKey *cacheKey, bool *fromCache)
 {
     section = firm->section;
+    *fromCache = false;
+
+    u32 firmVersion;
+
+    if(*firmType == NATIVE_FIRM)
+    {
+        //Only look up the FIRM version first, a cached copy may be usable
+        firmVersion = firmRead(NULL, (u32)*firmType);
+
+        cacheKey->firmType = (u32)*firmType;
+        cacheKey->firmVersion = firmVersion;
+
+        //Old O3DS FIRMs are handled below
+        if((isN3DS || firmVersion >= 0x25) && loadCachedFirm(firm, cacheKey, sectionSizes))
+        {
+            sectionsInPlace = true;
+            *fromCache = true;
+
+            return firmVersion;
+        }
+    }
 
     //Load FIRM from CTRNAND
-    u32 firmVersion = firmRead(firm, (u32)*firmType);
+    firmVersion = firmRead(firm, (u32)*firmType);
+    profileStage(STAGE_FIRM_READ);
 
     if(!isN3DS && *firmType == NATIVE_FIRM)
     {
@@ -247,7 +312,7 @@ static inline u32 loadFirm(FirmwareType *firmType, FirmwareSource firmSource)
         //We can't boot a 3.x/4.x NATIVE_FIRM, load one from SD
         else if(firmVersion < 0x25)
         {
-            if(!fileRead(firm, "/luma/firmware.bin") || (((u32)section[2].address >> 8) & 0xFF) != 0x68)
+            if(!fileRead(firm, "/luma/firmware.bin", FIRM_MAX_SIZE) || (((u32)section[2].address >> 8) & 0xFF) != 0x68)
                 error("An old unsupported FIRM has been detected.\nCopy firmware.bin in /luma to boot");
 
             //No assumption regarding FIRM version
@@ -255,20 +320,57 @@ static inline u32 loadFirm(FirmwareType *firmType, FirmwareSource firmSource)
         }
     }
 
-    if(firmVersion != 0xFFFFFFFF) decryptExeFs((u8 *)firm);
+    if(firmVersion != 0xFFFFFFFF)
+    {
+        //The legacy FIRM patches use offsets into the whole FIRM, so those are decrypted in the buffer
+        if(*firmType == TWL_FIRM || *firmType == AGB_FIRM) decryptExeFs((u8 *)firm);
+        else
+        {
+            initExeFsDecryption((u8 *)firm);
+            decryptFirmSections(*firmType == NATIVE_FIRM);
+        }
+    }
+
+    profileStage(STAGE_FIRM_DECRYPT);
 
     return firmVersion;
 }
 
+static inline u8 *getSectionData(u32 sectionNum)
+{
+    return sectionsInPlace ? section[sectionNum].address : (u8 *)firm + section[sectionNum].offset;
+}
+
+static inline void decryptFirmSections(bool injectModules)
+{
+    //If we're booting NATIVE_FIRM, section0 needs to be decrypted separately to inject 3ds_injector
+    u32 sectionNum;
+    if(injectModules)
+    {
+        sectionSizes[0] = decryptSection0AndInjectSystemModules();
+        sectionNum = 1;
+    }
+    else sectionNum = 0;
+
+    //Decrypt FIRM sections to respective memory locations, patches are then applied there
+    for(; sectionNum < 4 && section[sectionNum].size; sectionNum++)
+    {
+        decryptExeFsRange(section[sectionNum].address, section[sectionNum].offset, section[sectionNum].size);
+        sectionSizes[sectionNum] = section[sectionNum].size;
+    }
+
+    sectionsInPlace = true;
+}
+
 static inline void patchNativeFirm(u32 firmVersion, FirmwareSource nandType, u32 emuHeader, bool isA9lh)
 {
-    u8 *arm9Section = (u8 *)firm + section[2].offset;
-    u8 *arm11Section1 = (u8 *)firm + section[1].offset;
+    u8 *arm9Section = getSectionData(2);
+    u8 *arm11Section1 = getSectionData(1);
 
     if(isN3DS)
     {
         //Decrypt ARM9Bin and patch ARM9 entrypoint to skip arm9loader
-        arm9Loader(arm9Section);
+        arm9Loader(arm9Section, true);
         firm->arm9Entry = (u8 *)0x801B01C;
     }
 
@@ -280,14 +382,17 @@ static inline void patchNativeFirm(u32 firmVersion, FirmwareSource nandType, u32
         process9MemAddr;
     u8 *process9Offset = getProcess9(arm9Section + 0x15000, section[2].size - 0x15000, &process9Size, &process9MemAddr);
 
-    //Apply signature patches
-    patchSignatureChecks(process9Offset, process9Size);
+    bool is11 = firmVersion >= (isN3DS ? 0x21 : 0x52);
+
+    /* Apply signature patches and, on 11.0 FIRMs, anti-anti-DG patches.
+       Everything the other Process9 patches need is located in the same pass */
+    patchProcess9(process9Offset, process9Size, (1u << PATTERN_SIG_CHECK) | (1u << PATTERN_SIG_CHECK2) | ((u32)is11 << PATTERN_TITLE_INSTALL));
 
     //Apply emuNAND patches
     if(nandType != FIRMWARE_SYSNAND)
     {
-        u32 branchAdditive = (u32)firm + section[2].offset - (u32)section[2].address;
-        patchEmuNAND(arm9Section, section[2].size, process9Offset, process9Size, emuOffset, emuHeader, branchAdditive);
+        u32 branchAdditive = (u32)arm9Section - (u32)section[2].address;
+        patchEmuNAND(arm9Section, section[2].size, process9Offset, process9Size, emuHeader, branchAdditive);
     }
 
     //Apply FIRM0/1 writes patches on sysNAND to protect A9LH
@@ -296,25 +401,27 @@ static inline void patchNativeFirm(u32 firmVersion, FirmwareSource nandType, u32
     //Apply firmlaunch patches
     patchFirmlaunches(process9Offset, process9Size, process9MemAddr);
 
-    //11.0 FIRM patches
-    if(firmVersion >= (isN3DS ? 0x21 : 0x52))
-    {
-        //Apply anti-anti-DG patches
-        patchTitleInstallMinVersionCheck(process9Offset, process9Size);
-
-        //Restore svcBackdoor
-        reimplementSvcBackdoor(arm11Section1, section[1].size);
-    }
+    //Restore svcBackdoor on 11.0 FIRMs
+    if(is11) reimplementSvcBackdoor(arm11Section1, section[1].size);
 
     implementSvcGetCFWInfo(arm11Section1, section[1].size);
 }
 
+static inline void setCachedNativeFirmKeys(u32 firmVersion, bool isA9lh)
+{
+    //The cached ARM9 binary is already decrypted, only set the keys arm9loader would
+    if(isN3DS) arm9Loader(section[2].address, false);
+
+    //Same as in patchNativeFirm
+    else if(!isA9lh && firmVersion >= 0x29) setRSAMod0DerivedKeys();
+}
+
 static inline void patchLegacyFirm(FirmwareType firmType)
 {
     if(isN3DS)
     {
         //Decrypt ARM9Bin and patch ARM9 entrypoint to skip arm9loader
-        arm9Loader((u8 *)firm + section[3].offset);
+        arm9Loader((u8 *)firm + section[3].offset, true);
         firm->arm9Entry = (u8 *)0x801301C;
     }
 
@@ -325,12 +432,12 @@ static inline void patchLegacyFirm(FirmwareType firmType)
 
 static inline void patch2xNativeAndSafeFirm(void)
 {
-    u8 *arm9Section = (u8 *)firm + section[2].offset;
+    u8 *arm9Section = getSectionData(2);
 
     if(isN3DS)
     {
         //Decrypt ARM9Bin and patch ARM9 entrypoint to skip arm9loader
-        arm9Loader(arm9Section);
+        arm9Loader(arm9Section, true);
         firm->arm9Entry = (u8 *)0x801B01C;
 
         patchFirmWrites(arm9Section, section[2].size);
@@ -338,6 +445,33 @@ static inline void patch2xNativeAndSafeFirm(void)
     else patchOldFirmWrites(arm9Section, section[2].size);
 }
 
+static inline u32 decryptSection0AndInjectSystemModules(void)
+{
+    u8 *pos = section[0].address;
+
+    for(u32 offset = section[0].offset, end = offset + section[0].size; offset < end;)
+    {
+        //Decrypt the NCCH and exheader headers first, to get the module size and name
+        decryptExeFsRange(pos, offset, 0x400);
+        u32 size = *(u32 *)(pos + 0x104) * 0x200;
+
+        if(memcmp(pos + 0x200, "loader", 7) == 0)
+        {
+            memcpy(pos, injector, injector_size);
+            pos += injector_size;
+        }
+        else
+        {
+            decryptExeFsRange(pos + 0x400, offset + 0x400, size - 0x400);
+            pos += size;
+        }
+
+        offset += size;
+    }
+
+    return pos - section[0].address;
+}
+
 static inline void copySection0AndInjectSystemModules(void)
 {
     u8 *arm11Section0 = (u8 *)firm + section[0].offset;
@@ -371,28 +505,37 @@ static inline void copySection0AndInjectSystemModules(void)
 
 static inline void launchFirm(FirmwareType firmType)
 {
-    //If we're booting NATIVE_FIRM, section0 needs to be copied separately to inject 3ds_injector
-    u32 sectionNum;
-    if(firmType == NATIVE_FIRM)
+    if(!sectionsInPlace)
     {
-        copySection0AndInjectSystemModules();
-        sectionNum = 1;
-    }
-    else sectionNum = 0;
+        //If we're booting NATIVE_FIRM, section0 needs to be copied separately to inject 3ds_injector
+        u32 sectionNum;
+        if(firmType == NATIVE_FIRM)
+        {
+            copySection0AndInjectSystemModules();
+            sectionNum = 1;
+        }
+        else sectionNum = 0;
 
-    //Copy FIRM sections to respective memory locations
-    for(; sectionNum < 4 && section[sectionNum].size; sectionNum++)
-        memcpy(section[sectionNum].address, (u8 *)firm + section[sectionNum].offset, section[sectionNum].size);
+        //Copy FIRM sections to respective memory locations
+        for(; sectionNum < 4 && section[sectionNum].size; sectionNum++)
+            memcpy(section[sectionNum].address, (u8 *)firm + section[sectionNum].offset, section[sectionNum].size);
+    }
 
     //Determine the ARM11 entry to use
     vu32 *arm11;
     if(isFirmlaunch) arm11 = (u32 *)0x1FFFFFFC;
     else
     {
+        //Keep a splash shown during the FIRM load on screen for its full time
+        waitSplash();
+
         deinitScreens();
         arm11 = (u32 *)0x1FFFFFF8;
     }
 
+    //Hand the timers over stopped, as they were found
+    stopChrono();
+
     //Set ARM11 kernel entrypoint
     *arm11 = (u32)firm->arm11Entry;
 
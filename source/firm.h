@@ -23,30 +23,13 @@
 #pragma once
 
 #include "types.h"
+#include "firmcache.h"
 
 #define CFG_BOOTENV    (*(vu32 *)0x10010000)
 #define CFG_UNITINFO   (*(vu8  *)0x10010010)
 #define PDN_MPCORE_CFG (*(vu32 *)0x10140FFC)
 #define PDN_SPI_CNT    (*(vu32 *)0x101401C0)
 
-//FIRM Header layout
-typedef struct firmSectionHeader {
-    u32 offset;
-    u8 *address;
-    u32 size;
-    u32 procType;
-    u8 hash[0x20];
-} firmSectionHeader;
-
-typedef struct firmHeader {
-    u32 magic;
-    u32 reserved1;
-    u8 *arm11Entry;
-    u8 *arm9Entry;
-    u8 reserved2[0x30];
-    firmSectionHeader section[4];
-} firmHeader;
-
 typedef enum ConfigurationStatus
 {
     DONT_CONFIGURE = 0,
@@ -54,9 +37,13 @@ typedef enum ConfigurationStatus
     CREATE_CONFIGURATION = 2
 } ConfigurationStatus;
  
-static inline u32 loadFirm(FirmwareType *firmType, FirmwareSource firmSource);
+static inline u32 loadFirm(FirmwareType *firmType, FirmwareSource firmSource, firmCacheKey *cacheKey, bool *fromCache);
+static inline u8 *getSectionData(u32 sectionNum);
+static inline void decryptFirmSections(bool injectModules);
 static inline void patchNativeFirm(u32 firmVersion, FirmwareSource nandType, u32 emuHeader, bool isA9lh);
+static inline void setCachedNativeFirmKeys(u32 firmVersion, bool isA9lh);
 static inline void patchLegacyFirm(FirmwareType firmType);
 static inline void patch2xNativeAndSafeFirm(void);
+static inline u32 decryptSection0AndInjectSystemModules(void);
 static inline void copySection0AndInjectSystemModules(void);
 static inline void launchFirm(FirmwareType firmType);
\ No newline at end of file
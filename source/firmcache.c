@@ -0,0 +1,161 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b of GPLv3 applies to this file: Requiring preservation of specified
+*   reasonable legal notices or author attributions in that material or in the Appropriate Legal
+*   Notices displayed by works containing it.
+*/
+
+/*
+*   The decrypted and patched NATIVE_FIRM is the same from boot to boot as long as nothing in
+*   firmCacheKey changes, so it's saved to the SD and loaded straight to the section addresses
+*/
+
+#include "firmcache.h"
+#include "memory.h"
+#include "crypto.h"
+#include "fs.h"
+#include "screen.h"
+#include "fatfs/ff.h"
+
+#define CACHE_PATH    "/luma/cache/native_firm.bin"
+#define CACHE_VERSION 3
+
+typedef struct firmCacheHeader
+{
+    char magic[4];
+    u32 version;
+    u8 headerHash[SHA_256_HASH_SIZE]; //Of everything after it
+    firmCacheKey key;
+    u32 sectionSizes[4];
+    u8 sectionHashes[4][SHA_256_HASH_SIZE];
+    firmHeader firm;
+} firmCacheHeader;
+
+static void hashCacheHeader(void *res, const firmCacheHeader *header)
+{
+    const u8 *start = (const u8 *)&header->key;
+
+    sha256(res, start, (u32)((const u8 *)(header + 1) - start));
+}
+
+//A NATIVE_FIRM section is loaded either to ARM9 memory or to AXI WRAM, below the ARM11 queue and entrypoint
+static bool isValidSection(const u8 *address, u32 size)
+{
+    u32 start = (u32)address,
+        arm9End = isN3DS ? 0x08180000 : 0x08100000;
+
+    return (start >= 0x08006000 && start <= arm9End && size <= arm9End - start) ||
+           (start >= 0x1FF00000 && start <= ARM11_QUEUE_ADDRESS && size <= ARM11_QUEUE_ADDRESS - start);
+}
+
+bool loadCachedFirm(firmHeader *firm, const firmCacheKey *key, u32 *sectionSizes)
+{
+    firmCacheHeader header;
+    FIL file;
+    unsigned int read;
+
+    if(f_open(&file, CACHE_PATH, FA_READ) != FR_OK) return false;
+
+    //Read each section with as few commands as the file's fragmentation allows
+    DWORD clmt[CLMT_SIZE];
+    clmt[0] = CLMT_SIZE;
+    file.cltbl = clmt;
+    if(f_lseek(&file, CREATE_LINKMAP) != FR_OK) file.cltbl = NULL;
+
+    bool valid = f_read(&file, &header, sizeof(header), &read) == FR_OK && read == sizeof(header) &&
+                 memcmp(header.magic, "FCHE", 4) == 0 && header.version == CACHE_VERSION &&
+                 memcmp(&header.key, key, sizeof(firmCacheKey)) == 0;
+
+    u8 __attribute__((aligned(4))) hash[SHA_256_HASH_SIZE];
+
+    //Nothing is read to memory before the header is known to be intact and only points at section memory
+    if(valid)
+    {
+        hashCacheHeader(hash, &header);
+        valid = memcmp(hash, header.headerHash, SHA_256_HASH_SIZE) == 0;
+    }
+
+    for(u32 i = 0; valid && i < 4; i++)
+        valid = !header.sectionSizes[i] || isValidSection(header.firm.section[i].address, header.sectionSizes[i]);
+
+    //Sections are read to their load addresses. If anything is wrong, the FIRM is rebuilt over them
+    for(u32 i = 0; valid && i < 4; i++)
+    {
+        u32 size = header.sectionSizes[i];
+
+        if(!size) continue;
+
+        u8 *dest = header.firm.section[i].address;
+
+        valid = f_read(&file, dest, size, &read) == FR_OK && read == size;
+
+        if(valid)
+        {
+            sha256(hash, dest, size);
+            valid = memcmp(hash, header.sectionHashes[i], SHA_256_HASH_SIZE) == 0;
+        }
+    }
+
+    f_close(&file);
+
+    if(valid)
+    {
+        memcpy(firm, &header.firm, sizeof(firmHeader));
+        memcpy(sectionSizes, header.sectionSizes, sizeof(header.sectionSizes));
+    }
+
+    return valid;
+}
+
+void saveCachedFirm(const firmHeader *firm, const firmCacheKey *key, const u32 *sectionSizes)
+{
+    firmCacheHeader header;
+
+    memcpy(header.magic, "FCHE", 4);
+    header.version = CACHE_VERSION;
+    memcpy(&header.key, key, sizeof(firmCacheKey));
+    memcpy(&header.firm, firm, sizeof(firmHeader));
+
+    for(u32 i = 0; i < 4; i++)
+    {
+        header.sectionSizes[i] = sectionSizes[i];
+        if(sectionSizes[i]) sha256(header.sectionHashes[i], firm->section[i].address, sectionSizes[i]);
+    }
+
+    hashCacheHeader(header.headerHash, &header);
+
+    FIL file;
+
+    if(f_open(&file, CACHE_PATH, FA_WRITE | FA_CREATE_ALWAYS) != FR_OK)
+    {
+        createDirectory("luma/cache");
+        if(f_open(&file, CACHE_PATH, FA_WRITE | FA_CREATE_ALWAYS) != FR_OK) return;
+    }
+
+    unsigned int written;
+    bool success = f_write(&file, &header, sizeof(header), &written) == FR_OK && written == sizeof(header);
+
+    for(u32 i = 0; success && i < 4; i++)
+        if(sectionSizes[i])
+            success = f_write(&file, firm->section[i].address, sectionSizes[i], &written) == FR_OK && written == sectionSizes[i];
+
+    f_close(&file);
+
+    //Don't leave a truncated cache behind, e.g. if the SD is full
+    if(!success) fileDelete(CACHE_PATH);
+}
@@ -0,0 +1,43 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b of GPLv3 applies to this file: Requiring preservation of specified
+*   reasonable legal notices or author attributions in that material or in the Appropriate Legal
+*   Notices displayed by works containing it.
+*/
+
+#pragma once
+
+#include "types.h"
+
+//Everything the decrypted and patched FIRM depends on. A cached FIRM is only used if all of it matches
+typedef struct firmCacheKey
+{
+    u32 commitHash;
+    u32 firmType;
+    u32 firmVersion;
+    u32 console;    //Bit 0: N3DS, bit 1: dev unit
+    u32 nandType;
+    u32 firmSource;
+    u32 emuOffset;
+    u32 emuHeader;
+    u32 emuLayout;  //Where the fragments of an emuNAND image are
+    u32 config;
+} firmCacheKey;
+
+bool loadCachedFirm(firmHeader *firm, const firmCacheKey *key, u32 *sectionSizes);
+void saveCachedFirm(const firmHeader *firm, const firmCacheKey *key, const u32 *sectionSizes);
@@ -26,6 +26,7 @@
 #include "screen.h"
 #include "fatfs/ff.h"
 #include "buttons.h"
+#include "utils.h"
 #include "../build/loader.h"
 
 static FATFS sdFs,
@@ -37,7 +38,8 @@ void mountFs(void)
     f_mount(&nandFs, "1:", 0);
 }
 
-u32 fileRead(void *dest, const char *path)
+//Files bigger than maxSize aren't read, and count as missing
+u32 fileRead(void *dest, const char *path, u32 maxSize)
 {
     FIL file;
     u32 size;
@@ -46,8 +48,20 @@ u32 fileRead(void *dest, const char *path)
     {
         unsigned int read;
         size = f_size(&file);
-        if(dest != NULL)
+        if(size > maxSize) size = 0;
+        else if(dest != NULL)
+        {
+            /* Map the cluster chain up front, so that f_read issues one disk read per fragment
+               (a single one for a contiguous file) instead of one per cluster */
+            DWORD clmt[CLMT_SIZE];
+            clmt[0] = CLMT_SIZE;
+            file.cltbl = clmt;
+
+            //Too fragmented, follow the FAT instead
+            if(f_lseek(&file, CREATE_LINKMAP) != FR_OK) file.cltbl = NULL;
+
             f_read(&file, dest, size, &read);
+        }
         f_close(&file);
     }
     else size = 0;
@@ -55,9 +69,39 @@ u32 fileRead(void *dest, const char *path)
     return size;
 }
 
-u32 getFileSize(const char *path)
+/* Maps a file to the SD, as (file sector, SD sector) pairs sorted by file sector.
+   Returns how many there are, 0 if the file doesn't exist, is empty or too fragmented */
+u32 fileExtents(const char *path, u32 *extents, u32 *sectorCount)
 {
-    return fileRead(NULL, path);
+    FIL file;
+    u32 count = 0;
+
+    if(f_open(&file, path, FA_READ) == FR_OK)
+    {
+        DWORD clmt[CLMT_SIZE];
+        clmt[0] = CLMT_SIZE;
+        file.cltbl = clmt;
+
+        if(f_lseek(&file, CREATE_LINKMAP) == FR_OK)
+        {
+            const FATFS *fs = file.obj.fs;
+            u32 fileSector = 0;
+
+            //Each fragment is a cluster count followed by its first cluster
+            for(const DWORD *fragment = clmt + 1; *fragment; fragment += 2, count++)
+            {
+                extents[count * 2] = fileSector;
+                extents[count * 2 + 1] = fs->database + (fragment[1] - 2) * fs->csize;
+                fileSector += fragment[0] * fs->csize;
+            }
+
+            *sectorCount = f_size(&file) / 0x200;
+        }
+
+        f_close(&file);
+    }
+
+    return count;
 }
 
 bool fileWrite(const void *buffer, const char *path, u32 size)
@@ -76,6 +120,23 @@ bool fileWrite(const void *buffer, const char *path, u32 size)
     return false;
 }
 
+bool fileAppend(const void *buffer, const char *path, u32 size)
+{
+    FIL file;
+
+    if(f_open(&file, path, FA_WRITE | FA_OPEN_ALWAYS) == FR_OK)
+    {
+        unsigned int written;
+        f_lseek(&file, f_size(&file));
+        f_write(&file, buffer, size, &written);
+        f_close(&file);
+
+        return true;
+    }
+
+    return false;
+}
+
 void fileDelete(const char *path)
 {
     f_unlink(path);
@@ -120,11 +181,26 @@ void loadPayload(u32 pressed)
         path[14] = '/';
         memcpy(&path[15], info.altname, 13);
 
-        loaderAddress[1] = fileRead((void *)0x24F00000, path);
+        const payloadHeader *header = (const payloadHeader *)0x24F00000;
+        u32 payloadSize = fileRead((void *)header, path, PAYLOAD_MAX_SIZE);
+
+        //The chainloader trusts the size of compressed payloads, refuse the ones that wouldn't fit, and the too big raw ones
+        if(info.fsize > PAYLOAD_MAX_SIZE || (payloadSize > sizeof(payloadHeader) && memcmp(header->magic, PAYLOAD_MAGIC, 4) == 0 &&
+           header->decompressedSize > PAYLOAD_MAX_SIZE))
+            error("The payload is too big to be loaded");
+
+        if(!payloadSize) return;
+
+        loaderAddress[1] = payloadSize;
 
         flushDCacheRange(loaderAddress, loader_size);
         flushICacheRange(loaderAddress, loader_size);
 
+        stopChrono();
+
+        //The payload expects the screens to be ready and the ARM11 to be idle
+        waitScreens();
+
         ((void (*)())loaderAddress)();
     }
 }
@@ -181,7 +257,8 @@ u32 firmRead(void *dest, u32 firmType)
         tempVersion >>= 4;
     }
 
-    fileRead(dest, path);
+    //Just find the version if there's no destination
+    if(dest != NULL) fileRead(dest, path, FIRM_MAX_SIZE);
 
     return firmVersion;
 }
\ No newline at end of file
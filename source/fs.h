@@ -26,12 +26,34 @@
 
 #define PATTERN(a)      a "_*.bin"
 
+//Most fragments fileExtents can map, patches/emunand.s gets it from here
+#define MAX_FILE_EXTENTS 16
+
+//Cluster link map size for up to MAX_FILE_EXTENTS fragments: 2 items each, plus the table size and terminator
+#define CLMT_SIZE       (MAX_FILE_EXTENTS * 2 + 2)
+
+//Payloads may be raw, or this header followed by an LZ4 block (see payloadtool/)
+#define PAYLOAD_MAGIC    "PAYZ"
+
+//Payloads run from 0x23F00000 and can't grow into the framebuffer struct
+#define PAYLOAD_MAX_SIZE 0xFFE00
+
+//FIRMs are read to 0x24000000, and can't grow into the splash buffer
+#define FIRM_MAX_SIZE    0xE00000
+
+typedef struct payloadHeader
+{
+    char magic[4];
+    u32 decompressedSize;
+} payloadHeader;
+
 extern bool isN3DS;
 
 void mountFs(void);
-u32 fileRead(void *dest, const char *path);
-u32 getFileSize(const char *path);
+u32 fileRead(void *dest, const char *path, u32 maxSize);
+u32 fileExtents(const char *path, u32 *extents, u32 *sectorCount);
 bool fileWrite(const void *buffer, const char *path, u32 size);
+bool fileAppend(const void *buffer, const char *path, u32 size);
 void fileDelete(const char *path);
 void createDirectory(const char *path);
 void loadPayload(u32 pressed);
@@ -0,0 +1,108 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b of GPLv3 applies to this file: Requiring preservation of specified
+*   reasonable legal notices or author attributions in that material or in the Appropriate Legal
+*   Notices displayed by works containing it.
+*/
+
+/*
+*   The glyph renderer of source/draw.c, also built on the host by drawbench/.
+*   The includer provides the integer types, font and SCREEN_TOP_HEIGHT
+*/
+
+#pragma once
+
+//Glyphs rotated like the framebuffers: each byte is a column, bit 0 being its bottom pixel
+static u8 fontColumns[sizeof(font)];
+static bool fontRotated = false;
+
+//Byte enables for the 3 bytes of each of 4 pixels
+static const u16 pixelBytes[16] = {
+    0x000, 0x007, 0x038, 0x03F, 0x1C0, 0x1C7, 0x1F8, 0x1FF,
+    0xE00, 0xE07, 0xE38, 0xE3F, 0xFC0, 0xFC7, 0xFF8, 0xFFF
+};
+
+//Word masks for 4 byte enables
+static const u32 byteMasks[16] = {
+    0x00000000, 0x000000FF, 0x0000FF00, 0x0000FFFF, 0x00FF0000, 0x00FF00FF, 0x00FFFF00, 0x00FFFFFF,
+    0xFF000000, 0xFF0000FF, 0xFF00FF00, 0xFF00FFFF, 0xFFFF0000, 0xFFFF00FF, 0xFFFFFF00, 0xFFFFFFFF
+};
+
+static void rotateFont(void)
+{
+    for(u32 i = 0; i < sizeof(font); i += 8)
+        for(u32 x = 0; x < 8; x++)
+        {
+            u8 column = 0;
+
+            for(u32 y = 0; y < 8; y++)
+                if((font[i + y] >> (7 - x)) & 1) column |= 1 << (7 - y);
+
+            fontColumns[i + x] = column;
+        }
+
+    fontRotated = true;
+}
+
+//Opaque glyphs also paint the rest of their cell black
+static void blitGlyph(u8 *framebuffer, char character, int posX, int posY, u32 color, bool opaque)
+{
+    if(!fontRotated) rotateFont();
+
+    //A glyph column is 8 pixels (24 bytes) in a row, starting from its bottom one
+    u8 *const columnPos = framebuffer + (posX * SCREEN_TOP_HEIGHT + SCREEN_TOP_HEIGHT - posY - 8) * 3;
+    u32 shift = (uintptr_t)columnPos & 3,
+        *words = (u32 *)(columnPos - shift);
+
+    //The color repeats every 3 words, starting at the same alignment as the column
+    static u32 colorWords[3],
+               lastColor = 0xFFFFFFFF,
+               lastShift;
+
+    if(color != lastColor || shift != lastShift)
+    {
+        for(u32 i = 0; i < 3; i++) colorWords[i] = 0;
+
+        for(u32 i = 0; i < 12; i++)
+        {
+            u32 component = (i + 3 - shift) % 3;
+            colorWords[i / 4] |= ((color >> (16 - component * 8)) & 0xFF) << (i % 4 * 8);
+        }
+
+        lastColor = color;
+        lastShift = shift;
+    }
+
+    const u8 *glyph = &fontColumns[(u8)character * 8];
+
+    for(u32 x = 0; x < 8; x++, words += SCREEN_TOP_HEIGHT * 3 / 4)
+    {
+        u32 bytes = (pixelBytes[glyph[x] & 0xF] | (pixelBytes[glyph[x] >> 4] << 12)) << shift,
+            cell = opaque ? 0xFFFFFFU << shift : bytes;
+
+        //Whole words are written without reading them back
+        for(u32 i = 0; cell; i++, bytes >>= 4, cell >>= 4)
+        {
+            u32 mask = byteMasks[bytes & 0xF],
+                cellMask = byteMasks[cell & 0xF];
+
+            if(cellMask == 0xFFFFFFFF) words[i] = colorWords[i % 3] & mask;
+            else if(cellMask) words[i] = (words[i] & ~cellMask) | (colorWords[i % 3] & mask);
+        }
+    }
+}
@@ -0,0 +1,91 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b of GPLv3 applies to this file: Requiring preservation of specified
+*   reasonable legal notices or author attributions in that material or in the Appropriate Legal
+*   Notices displayed by works containing it.
+*/
+
+/*
+*   The LZ4 block decoder of compressed splashes and payloads, included by source/draw.c,
+*   loader/source/main.c and the host tools that make those files.
+*   The includer provides u8, u32 and memcpy
+*/
+
+#pragma once
+
+static u32 readLZ4Length(const u8 **in, const u8 *inEnd)
+{
+    u32 length = 0,
+        byte;
+
+    do
+    {
+        if(*in >= inEnd) break;
+        byte = *(*in)++;
+        length += byte;
+    }
+    while(byte == 255);
+
+    return length;
+}
+
+//Decodes straight into the destination, stopping at the first malformed sequence
+static u32 decompressLZ4(u8 *dest, u32 destSize, const u8 *src, u32 srcSize)
+{
+    const u8 *in = src,
+             *inEnd = src + srcSize;
+    u8 *out = dest,
+       *outEnd = dest + destSize;
+
+    while(in < inEnd)
+    {
+        u32 token = *in++,
+            length = token >> 4;
+
+        if(length == 15) length += readLZ4Length(&in, inEnd);
+        if(length > (u32)(inEnd - in) || length > (u32)(outEnd - out)) break;
+
+        memcpy(out, in, length);
+        in += length;
+        out += length;
+
+        //The last sequence only has literals
+        if(inEnd - in < 2) break;
+
+        u32 offset = in[0] | (in[1] << 8);
+        in += 2;
+
+        length = token & 0xF;
+        if(length == 15) length += readLZ4Length(&in, inEnd);
+        length += 4;
+
+        if(offset == 0 || offset > (u32)(out - dest) || length > (u32)(outEnd - out)) break;
+
+        const u8 *match = out - offset;
+
+        //Overlapping matches repeat the last offset bytes, which is how solid colors are stored
+        if(offset >= length)
+        {
+            memcpy(out, match, length);
+            out += length;
+        }
+        else while(length--) *out++ = *match++;
+    }
+
+    return out - dest;
+}
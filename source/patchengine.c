@@ -0,0 +1,252 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b of GPLv3 applies to this file: Requiring preservation of specified
+*   reasonable legal notices or author attributions in that material or in the Appropriate Legal
+*   Notices displayed by works containing it.
+*/
+
+/*
+*   Pattern scanner and patch tables, shared by the ARM9 and 3ds_injector builds.
+*   The injector compiles this file through injector/source/patchengine.c
+*/
+
+#include "patchengine.h"
+
+static inline const searchPattern *getScannerPattern(const patternScanner *scanner, u32 index)
+{
+    return (const searchPattern *)(scanner->entries + index * scanner->stride);
+}
+
+static bool matchesPattern(const searchPattern *pattern, const u8 *pos)
+{
+    const u8 *patternc = (const u8 *)pattern->pattern;
+
+    if(pattern->mask == NULL) return memcmp(patternc, pos, pattern->size) == 0;
+
+    for(u32 i = 0; i < pattern->size; i++)
+        if((patternc[i] ^ pos[i]) & pattern->mask[i]) return false;
+
+    return true;
+}
+
+/* Build a Horspool shift table which is the union of the per-pattern ones over a common window size,
+   and the list of patterns each last byte of the window can complete.
+   Each pattern is scanned for by its longest run of exact bytes, so masked parts don't shorten the
+   shifts, and the window is the shortest of those runs.
+   Each table entry has to start with a searchPattern, stride is the size of an entry */
+void compileScanner(patternScanner *scanner, const void *entries, u32 stride, u32 patternCount)
+{
+    u32 runEnds[32];
+
+    scanner->entries = (const u8 *)entries;
+    scanner->stride = stride;
+    scanner->patternCount = patternCount > 32 ? 32 : patternCount;
+    scanner->windowSize = 0xFF;
+
+    for(u32 i = 0; i < scanner->patternCount; ++i)
+    {
+        const searchPattern *pattern = getScannerPattern(scanner, i);
+        u32 run = 0,
+            longest = 0;
+
+        runEnds[i] = pattern->size;
+
+        for(u32 j = 0; j < pattern->size; ++j)
+        {
+            run = pattern->mask == NULL || pattern->mask[j] == 0xFF ? run + 1 : 0;
+
+            if(run && run >= longest)
+            {
+                longest = run;
+                runEnds[i] = j + 1;
+            }
+        }
+
+        //Without exact bytes, the last ones are compared through the mask
+        if(!longest) longest = pattern->size;
+
+        if(longest < scanner->windowSize) scanner->windowSize = longest;
+    }
+
+    if(!scanner->patternCount) scanner->windowSize = 0;
+
+    for(u32 c = 0; c < 256; ++c)
+    {
+        scanner->table[c] = (u8)scanner->windowSize;
+        scanner->candidates[c] = 0;
+    }
+
+    if(!scanner->windowSize) return;
+
+    for(u32 i = 0; i < scanner->patternCount; ++i)
+    {
+        const searchPattern *pattern = getScannerPattern(scanner, i);
+        const u8 *patternc = (const u8 *)pattern->pattern;
+
+        scanner->anchors[i] = runEnds[i] - scanner->windowSize;
+
+        //Masked bytes allow every value that agrees on the compared bits
+        for(u32 j = 0; j < scanner->windowSize; ++j)
+        {
+            u32 k = scanner->anchors[i] + j;
+            u8 mask = pattern->mask == NULL ? 0xFF : pattern->mask[k];
+
+            for(u32 c = 0; c < 256; ++c)
+            {
+                if((c ^ patternc[k]) & mask) continue;
+
+                if(j == scanner->windowSize - 1) scanner->candidates[c] |= 1u << i;
+                else if(scanner->windowSize - 1 - j < scanner->table[c]) scanner->table[c] = (u8)(scanner->windowSize - 1 - j);
+            }
+        }
+    }
+}
+
+//Matches of the same pattern don't overlap, searching resumes after the end of the previous one
+void runScanner(const patternScanner *scanner, u8 *startPos, u32 size, u32 wanted, matchHandler handler, void *data)
+{
+    u32 resumeAt[32] = {0};
+    const u32 windowSize = scanner->windowSize;
+
+    if(scanner->patternCount < 32) wanted &= (1u << scanner->patternCount) - 1;
+
+    if(!windowSize || windowSize > size) return;
+
+    for(u32 j = 0; j <= size - windowSize && wanted; j += scanner->table[startPos[j + windowSize - 1]])
+    {
+        u32 toCheck = scanner->candidates[startPos[j + windowSize - 1]] & wanted,
+            matched = 0;
+
+        //Find every pattern matching here before the handlers get to modify the data
+        for(u32 i = 0; i < 32 && (toCheck >> i); ++i)
+        {
+            const searchPattern *pattern = getScannerPattern(scanner, i);
+            u32 start = j - scanner->anchors[i];
+
+            if(((toCheck >> i) & 1) && j >= scanner->anchors[i] && start >= resumeAt[i] && pattern->size <= size - start &&
+               matchesPattern(pattern, startPos + start)) matched |= 1u << i;
+        }
+
+        for(u32 i = 0; i < 32 && (matched >> i); ++i)
+        {
+            if(!((matched >> i) & 1) || !((wanted >> i) & 1)) continue;
+
+            u32 start = j - scanner->anchors[i];
+
+            resumeAt[i] = start + getScannerPattern(scanner, i)->size;
+            wanted = handler(i, startPos + start, wanted, data);
+        }
+    }
+}
+
+static u32 storeFirstMatch(u32 index, u8 *match, u32 wanted, void *data)
+{
+    ((u8 **)data)[index] = match;
+
+    return wanted & ~(1u << index);
+}
+
+//Find the first match of each pattern, or NULL, returns how many were found
+u32 memsearchMulti(u8 *startPos, u32 size, const searchPattern *patterns, u8 **matches, u32 patternCount)
+{
+    patternScanner scanner;
+    u32 found = 0;
+
+    for(u32 i = 0; i < patternCount; i++)
+        matches[i] = NULL;
+
+    compileScanner(&scanner, patterns, sizeof(searchPattern), patternCount);
+    runScanner(&scanner, startPos, size, 0xFFFFFFFF, storeFirstMatch, matches);
+
+    for(u32 i = 0; i < patternCount; i++)
+        if(matches[i] != NULL) found++;
+
+    return found;
+}
+
+typedef struct patchState
+{
+    const patchDescriptor *patches;
+    const u32 *values;
+    u8 **matches;
+    u32 applied[32];
+} patchState;
+
+static u32 applyMatch(u32 index, u8 *match, u32 wanted, void *data)
+{
+    patchState *state = (patchState *)data;
+    const patchDescriptor *patch = &state->patches[index];
+    u8 *dest = match + patch->offset;
+
+    if(state->matches != NULL && !state->applied[index]) state->matches[index] = dest;
+
+    if(patch->replace != NULL)
+    {
+        const u8 *replacec = (const u8 *)patch->replace;
+
+        if(patch->replaceMask == NULL) memcpy(dest, replacec, patch->replaceSize);
+        else for(u32 i = 0; i < patch->replaceSize; i++)
+            dest[i] = (dest[i] & ~patch->replaceMask[i]) | (replacec[i] & patch->replaceMask[i]);
+    }
+
+    if(patch->relocation != RELOC_NONE)
+    {
+        u8 *pos = dest + patch->replaceSize;
+        u32 value = state->values[index];
+
+        if(patch->relocation == RELOC_ADDRESS32) value += (u32)pos;
+
+        memcpy(pos, &value, 4);
+    }
+
+    if(++state->applied[index] == patch->count) wanted &= ~(1u << index);
+
+    return wanted;
+}
+
+/* Apply the enabled entries of a patch table in a single pass. values holds what the relocating entries
+   store, by entry. If matches isn't NULL, it receives where the first match of each entry was patched
+   (its start plus the entry's offset). Returns a mask of the entries found less often than expected */
+u32 applyPatches(u8 *pos, u32 size, patchTable *table, u32 enabled, const u32 *values, u8 **matches)
+{
+    patchState state;
+    u32 missing = 0;
+
+    if(!table->compiled)
+    {
+        compileScanner(&table->scanner, table->patches, sizeof(patchDescriptor), table->patchCount);
+        table->compiled = true;
+    }
+
+    state.patches = table->patches;
+    state.values = values;
+    state.matches = matches;
+
+    for(u32 i = 0; i < 32; i++)
+    {
+        state.applied[i] = 0;
+        if(matches != NULL && i < table->patchCount) matches[i] = NULL;
+    }
+
+    runScanner(&table->scanner, pos, size, enabled, applyMatch, &state);
+
+    for(u32 i = 0; i < table->patchCount && i < 32; i++)
+        if(((enabled >> i) & 1) && state.applied[i] < table->patches[i].count) missing |= 1u << i;
+
+    return missing;
+}
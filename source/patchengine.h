@@ -0,0 +1,89 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b of GPLv3 applies to this file: Requiring preservation of specified
+*   reasonable legal notices or author attributions in that material or in the Appropriate Legal
+*   Notices displayed by works containing it.
+*/
+
+/*
+*   Pattern scanner and patch tables, shared by the ARM9 and 3ds_injector builds
+*/
+
+#pragma once
+
+#ifdef ARM11
+#include "../injector/source/memory.h"
+#else
+#include "memory.h"
+#endif
+
+typedef struct searchPattern
+{
+    const void *pattern;
+    const u8 *mask; //NULL for an exact match, else only the bits set in each mask byte are compared
+    u32 size;
+} searchPattern;
+
+//Up to 32 patterns, resolved together in a single pass
+typedef struct patternScanner
+{
+    const u8 *entries;
+    u32 stride,
+        patternCount,
+        windowSize;
+    u32 anchors[32]; //Where in each pattern the scanned window is
+    u8 table[256];
+    u32 candidates[256];
+} patternScanner;
+
+//Called on each match of a wanted pattern, returns the patterns still wanted
+typedef u32 (*matchHandler)(u32 index, u8 *match, u32 wanted, void *data);
+
+typedef enum patchRelocation
+{
+    RELOC_NONE = 0,
+    RELOC_ABS32,    //The entry's value
+    RELOC_ADDRESS32 //The address the value is stored at, plus the entry's value
+} patchRelocation;
+
+typedef struct patchDescriptor
+{
+    searchPattern search;
+    s32 offset;                 //Relative to the start of each match
+    const void *replace;        //NULL to only locate the pattern
+    u32 replaceSize;
+    u32 count;                  //Expected matches, further ones are left alone
+    const u8 *replaceMask;      //NULL to write the whole replacement, else only the bits set in each mask byte
+    patchRelocation relocation; //Stores the entry's value right after the replacement
+} patchDescriptor;
+
+//A patch table, its scanner is compiled the first time it's applied
+typedef struct patchTable
+{
+    const patchDescriptor *patches;
+    u32 patchCount;
+    bool compiled;
+    patternScanner scanner;
+} patchTable;
+
+#define PATCH_TABLE(patches) {(patches), sizeof(patches) / sizeof((patches)[0]), false, {0}}
+
+void compileScanner(patternScanner *scanner, const void *entries, u32 stride, u32 patternCount);
+void runScanner(const patternScanner *scanner, u8 *startPos, u32 size, u32 wanted, matchHandler handler, void *data);
+u32 memsearchMulti(u8 *startPos, u32 size, const searchPattern *patterns, u8 **matches, u32 patternCount);
+u32 applyPatches(u8 *pos, u32 size, patchTable *table, u32 enabled, const u32 *values, u8 **matches);
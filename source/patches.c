@@ -31,6 +31,65 @@ static u32 *arm11SvcTable = NULL;
 
 static u8 *freeK11Space = NULL;
 
+//Process9 patches, indexed by Process9Patch
+static const u8 sigCheckPattern[] = {0xC0, 0x1C, 0x76, 0xE7},
+                sigCheckPattern2[] = {0xB5, 0x22, 0x4D, 0x0C},
+                titleInstallPattern[] = {0x0A, 0x81, 0x42, 0x02},
+                sdmmcPattern[] = {0x21, 0x20, 0x18, 0x20},
+                titleInstallPatch[] = {0xE0};
+static const u16 sigPatch[2] = {0x2000, 0x4770};
+
+const u8 nandRWPattern[4] = {0x1E, 0x00, 0xC8, 0x05};
+
+//The firmlaunch code starts with a backwards BLX to its fOpen function
+static const u8 firmlaunchPattern[0x17] = {0x00, 0x00, 0x80, 0xFA, [0x13] = 0xE2, 0x20, 0x20, 0x90},
+                firmlaunchMask[0x17] = {0x00, 0x00, 0x80, 0xFE, [0x13] = 0xFF, 0xFF, 0xFF, 0xFF};
+
+static const patchDescriptor process9Patches[PROCESS9_PATCHES] = {
+    //Signature checks
+    {{sigCheckPattern, NULL, 4}, 0, sigPatch, 2, 1, NULL, RELOC_NONE},
+    {{sigCheckPattern2, NULL, 4}, -2, sigPatch, 4, 1, NULL, RELOC_NONE},
+
+    //Firmlaunch code, FIRM writing code
+    {{firmlaunchPattern, firmlaunchMask, sizeof(firmlaunchPattern)}, 0, NULL, 0, 1, NULL, RELOC_NONE},
+    {{"exe:", NULL, 4}, 0, NULL, 0, 1, NULL, RELOC_NONE},
+
+    //Anti-anti-DG
+    {{titleInstallPattern, NULL, 4}, 4, titleInstallPatch, 1, 1, NULL, RELOC_NONE},
+
+    //SDMMC struct, NAND read/write code for emuNAND
+    {{sdmmcPattern, NULL, 4}, 0, NULL, 0, 1, NULL, RELOC_NONE},
+    {{nandRWPattern, NULL, 4}, -6, NULL, 0, 1, NULL, RELOC_NONE}
+};
+
+static patchTable process9Table = PATCH_TABLE(process9Patches);
+
+static u8 *process9Matches[PROCESS9_PATCHES];
+static u8 *patchedProcess9 = NULL;
+static u32 patchedProcess9Size = 0;
+
+//Apply the enabled Process9 table patches, and locate what the other Process9 patches need
+void patchProcess9(u8 *pos, u32 size, u32 enabled)
+{
+    for(u32 i = 0; i < PROCESS9_PATCHES; i++)
+        if(process9Patches[i].replace == NULL) enabled |= 1u << i;
+
+    applyPatches(pos, size, &process9Table, enabled, NULL, process9Matches);
+
+    patchedProcess9 = pos;
+    patchedProcess9Size = size;
+}
+
+//Return where patchProcess9 located a pattern if it covered this area, else search it
+u8 *findProcess9Pattern(Process9Patch id, u8 *pos, u32 size)
+{
+    if(pos == patchedProcess9 && size == patchedProcess9Size) return process9Matches[id];
+
+    u8 *match;
+
+    return memsearchMulti(pos, size, &process9Patches[id].search, &match, 1) ? match + process9Patches[id].offset : NULL;
+}
+
 static void findArm11SvcTable(u8 *pos, u32 size)
 {    
     if(arm11SvcTable == NULL)
@@ -65,28 +124,16 @@ u8 *getProcess9(u8 *pos, u32 size, u32 *process9Size, u32 *process9MemAddr)
     return off - 0x204 + (*(u32 *)(off - 0x64) * 0x200) + 0x200;
 }
 
-void patchSignatureChecks(u8 *pos, u32 size)
-{
-    const u16 sigPatch[2] = {0x2000, 0x4770};
-
-    //Look for signature checks
-    const u8 pattern[] = {0xC0, 0x1C, 0x76, 0xE7},
-             pattern2[] = {0xB5, 0x22, 0x4D, 0x0C};
-
-    u16 *off = (u16 *)memsearch(pos, pattern, size, 4),
-        *off2 = (u16 *)(memsearch(pos, pattern2, size, 4) - 1);
-
-    *off = sigPatch[0];
-    off2[0] = sigPatch[0];
-    off2[1] = sigPatch[1];
-}
-
 void patchFirmlaunches(u8 *pos, u32 size, u32 process9MemAddr)
 {
-    //Look for firmlaunch code
-    const u8 pattern[] = {0xE2, 0x20, 0x20, 0x90};
+    //Where the reboot payload gets the fOpen offset
+    static const patchDescriptor rebootPatches[] = {
+        {{"OPEN", NULL, 4}, 0, NULL, 0, 1, NULL, RELOC_ABS32}
+    };
+    static patchTable rebootTable = PATCH_TABLE(rebootPatches);
 
-    u8 *off = memsearch(pos, pattern, size, 4) - 0x13;
+    //Look for firmlaunch code
+    u8 *off = findProcess9Pattern(PATTERN_FIRMLAUNCH, pos, size);
 
     //Firmlaunch function offset - offset in BLX opcode (A4-16 - ARM DDI 0100E) + 1
     u32 fOpenOffset = (u32)(off + 9 - (-((*(u32 *)off & 0x00FFFFFF) << 2) & (0xFFFFFF << 2)) - pos + process9MemAddr);
@@ -95,35 +142,38 @@ void patchFirmlaunches(u8 *pos, u32 size, u32 process9MemAddr)
     memcpy(off, reboot, reboot_size);
 
     //Put the fOpen offset in the right location
-    u32 *pos_fopen = (u32 *)memsearch(off, "OPEN", reboot_size, 4);
-    *pos_fopen = fOpenOffset;
+    applyPatches(off, reboot_size, &rebootTable, 1, &fOpenOffset, NULL);
 }
 
 void patchFirmWrites(u8 *pos, u32 size)
 {
-    const u16 writeBlock[2] = {0x2000, 0x46C0};
+    static const u16 writeBlock[2] = {0x2000, 0x46C0};
+    static const u8 pattern[] = {0x00, 0x28, 0x01, 0xDA};
 
-    //Look for FIRM writing code
-    u8 *const off1 = memsearch(pos, "exe:", size, 4);
-    const u8 pattern[] = {0x00, 0x28, 0x01, 0xDA};
+    //It's in the 0x100 bytes before the FIRM writing code
+    static const patchDescriptor patches[] = {
+        {{pattern, NULL, 4}, 0, writeBlock, 4, 1, NULL, RELOC_NONE}
+    };
+    static patchTable table = PATCH_TABLE(patches);
 
-    u16 *off2 = (u16 *)memsearch(off1 - 0x100, pattern, 0x100, 4);
+    //Look for FIRM writing code
+    u8 *const off1 = findProcess9Pattern(PATTERN_FIRM_WRITES, pos, size);
 
-    off2[0] = writeBlock[0];
-    off2[1] = writeBlock[1];
+    applyPatches(off1 - 0x100, 0x100, &table, 1, NULL, NULL);
 }
 
 void patchOldFirmWrites(u8 *pos, u32 size)
 {
-    const u16 writeBlockOld[2] = {0x2400, 0xE01D};
+    static const u16 writeBlockOld[2] = {0x2400, 0xE01D};
+    static const u8 pattern[] = {0x04, 0x1E, 0x1D, 0xDB};
 
     //Look for FIRM writing code
-    const u8 pattern[] = {0x04, 0x1E, 0x1D, 0xDB};
-
-    u16 *off = (u16 *)memsearch(pos, pattern, size, 4);
+    static const patchDescriptor patches[] = {
+        {{pattern, NULL, 4}, 0, writeBlockOld, 4, 1, NULL, RELOC_NONE}
+    };
+    static patchTable table = PATCH_TABLE(patches);
 
-    off[0] = writeBlockOld[0];
-    off[1] = writeBlockOld[1];
+    applyPatches(pos, size, &table, 1, NULL, NULL);
 }
 
 void reimplementSvcBackdoor(u8 *pos, u32 size)
@@ -183,15 +233,6 @@ void implementSvcGetCFWInfo(u8 *pos, u32 size)
     freeK11Space += svcGetCFWInfo_size;
 }
 
-void patchTitleInstallMinVersionCheck(u8 *pos, u32 size)
-{
-    const u8 pattern[] = {0x0A, 0x81, 0x42, 0x02};
-    
-    u8 *off = memsearch(pos, pattern, size, 4);
-    
-    if(off != NULL) off[4] = 0xE0;
-}
-
 void applyLegacyFirmPatches(u8 *pos, FirmwareType firmType)
 {
     const patchData twlPatches[] = {
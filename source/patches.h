@@ -23,6 +23,7 @@
 #pragma once
 
 #include "types.h"
+#include "patchengine.h"
 
 typedef struct patchData {
     u32 offset[2];
@@ -47,11 +48,26 @@ typedef struct __attribute__((packed))
     u32 config;
 } CFWInfo;
 
+typedef enum Process9Patch
+{
+    PATTERN_SIG_CHECK = 0,
+    PATTERN_SIG_CHECK2,
+    PATTERN_FIRMLAUNCH,
+    PATTERN_FIRM_WRITES,
+    PATTERN_TITLE_INSTALL,
+    PATTERN_SDMMC,
+    PATTERN_NAND_RW,
+    PROCESS9_PATCHES
+} Process9Patch;
+
 extern bool isN3DS;
 
+//In Process9's NAND read and write code, the emuNAND hooks go 3 instructions before it
+extern const u8 nandRWPattern[4];
+
+void patchProcess9(u8 *pos, u32 size, u32 enabled);
+u8 *findProcess9Pattern(Process9Patch id, u8 *pos, u32 size);
 u8 *getProcess9(u8 *pos, u32 size, u32 *process9Size, u32 *process9MemAddr);
-void patchSignatureChecks(u8 *pos, u32 size);
-void patchTitleInstallMinVersionCheck(u8 *pos, u32 size);
 void patchFirmlaunches(u8 *pos, u32 size, u32 process9MemAddr);
 void patchFirmWrites(u8 *pos, u32 size);
 void patchOldFirmWrites(u8 *pos, u32 size);
@@ -26,6 +26,7 @@
 */
 
 #include "draw.h"
+#include "ui.h"
 #include "screen.h"
 #include "utils.h"
 #include "memory.h"
@@ -46,17 +47,18 @@ static char pinKeyToLetter(u32 pressed)
 
 void newPin(bool allowSkipping)
 {
-    clearScreens();
+    //Replaces the menu's rows, only erasing what the new ones don't cover
+    uiClear();
 
     char *title = allowSkipping ? "Press START to skip or enter a new PIN" : "Enter a new PIN to proceed";
-    drawString(title, 10, 10, COLOR_TITLE);
-    drawString("PIN: ", 10, 10 + 2 * SPACING_Y, COLOR_WHITE);
+    uiAddRow(10, 10, title, COLOR_TITLE);
+    u32 pinRow = uiAddRow(10, 10 + 2 * SPACING_Y, "PIN: ", COLOR_WHITE);
+    uiFlush();
 
     //Pad to AES block length with zeroes
     u8 __attribute__((aligned(4))) enteredPassword[16 * ((PIN_LENGTH + 15) / 16)] = {0};
 
     u32 cnt = 0;
-    int charDrawPos = 5 * SPACING_X;
 
     while(cnt < PIN_LENGTH)
     {
@@ -77,8 +79,8 @@ void newPin(bool allowSkipping)
         enteredPassword[cnt++] = (u8)key; //Add character to password
 
         //Visualize character on screen
-        drawCharacter(key, 10 + charDrawPos, 10 + 2 * SPACING_Y, COLOR_WHITE);
-        charDrawPos += 2 * SPACING_X;
+        uiSetCharacter(pinRow, 5 + 2 * (cnt - 1), key);
+        uiFlush();
     }
 
     PINData pin;
@@ -105,11 +107,11 @@ void newPin(bool allowSkipping)
 
 bool verifyPin(void)
 {
-    initScreens();
+    uiInit();
 
     PINData pin;
 
-    if(fileRead(&pin, "/luma/pin.bin") != sizeof(PINData) ||
+    if(fileRead(&pin, "/luma/pin.bin", sizeof(PINData)) != sizeof(PINData) ||
        memcmp(pin.magic, "PINF", 4) != 0 ||
        pin.formatVersionMajor != PIN_VERSIONMAJOR ||
        pin.formatVersionMinor != PIN_VERSIONMINOR)
@@ -128,13 +130,14 @@ bool verifyPin(void)
 
     u32 cnt = 0;
     bool unlock = false;
-    int charDrawPos = 5 * SPACING_X;
+
+    uiAddRow(10, 10, "Press START to shutdown or enter PIN to proceed", COLOR_TITLE);
+    u32 pinRow = uiAddRow(10, 10 + 2 * SPACING_Y, "PIN: ", COLOR_WHITE),
+        messageRow = uiAddRow(10, 10 + 4 * SPACING_Y, "", COLOR_RED);
+    uiFlush();
 
     while(!unlock)
     {
-        drawString("Press START to shutdown or enter PIN to proceed", 10, 10, COLOR_TITLE);
-        drawString("PIN: ", 10, 10 + 2 * SPACING_Y, COLOR_WHITE);
-
         u32 pressed;
         do
         {
@@ -152,8 +155,7 @@ bool verifyPin(void)
         enteredPassword[cnt++] = (u8)key; //Add character to password
 
         //Visualize character on screen
-        drawCharacter(key, 10 + charDrawPos, 10 + 2 * SPACING_Y, COLOR_WHITE);
-        charDrawPos += 2 * SPACING_X;
+        uiSetCharacter(pinRow, 5 + 2 * (cnt - 1), key);
 
         if(cnt >= PIN_LENGTH)
         {
@@ -162,14 +164,14 @@ bool verifyPin(void)
 
             if(!unlock)
             {
-                charDrawPos = 5 * SPACING_X;
                 cnt = 0;
 
-                clearScreens();
-
-                drawString("Wrong PIN, try again", 10, 10 + 4 * SPACING_Y, COLOR_RED); 
+                uiSetText(pinRow, "PIN: ");
+                uiSetText(messageRow, "Wrong PIN, try again");
             }
         }
+
+        uiFlush();
     }
 
     return true;
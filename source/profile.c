@@ -0,0 +1,67 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b of GPLv3 applies to this file: Requiring preservation of specified
+*   reasonable legal notices or author attributions in that material or in the Appropriate Legal
+*   Notices displayed by works containing it.
+*/
+
+#include "profile.h"
+#include "utils.h"
+#include "fs.h"
+#include "memory.h"
+
+#ifdef BOOT_PROFILE
+
+static bootProfileEntry entries[PROFILE_ENTRIES];
+static u32 stageCount = 0;
+
+void profileStage(BootStage stage)
+{
+    //Keep the most recent stages if more than PROFILE_ENTRIES are recorded
+    bootProfileEntry *entry = &entries[stageCount++ % PROFILE_ENTRIES];
+
+    entry->ticks = chronoTicks();
+    entry->stage = (u32)stage;
+    entry->reserved = 0;
+}
+
+void profileSave(u32 firmType, u32 flags)
+{
+    static struct
+    {
+        bootProfileHeader header;
+        bootProfileEntry entries[PROFILE_ENTRIES];
+    } record;
+
+    bootProfileHeader *header = &record.header;
+    u32 count = stageCount < PROFILE_ENTRIES ? stageCount : PROFILE_ENTRIES;
+
+    memcpy(header->magic, PROFILE_MAGIC, 4);
+    header->version = PROFILE_VERSION;
+    header->entryCount = (u8)count;
+    header->firmType = (u8)firmType;
+    header->flags = (u8)flags;
+
+    //Unwrap the ring buffer, oldest entry first
+    for(u32 i = 0; i < count; i++)
+        record.entries[i] = entries[(stageCount - count + i) % PROFILE_ENTRIES];
+
+    fileAppend(&record, "/luma/bootprof.bin", sizeof(bootProfileHeader) + count * sizeof(bootProfileEntry));
+}
+
+#endif
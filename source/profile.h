@@ -0,0 +1,68 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b of GPLv3 applies to this file: Requiring preservation of specified
+*   reasonable legal notices or author attributions in that material or in the Appropriate Legal
+*   Notices displayed by works containing it.
+*/
+
+#pragma once
+
+#include "types.h"
+
+#define PROFILE_MAGIC   "BPRF"
+#define PROFILE_VERSION 1
+#define PROFILE_ENTRIES 16
+
+//Each stage is timestamped when it ends. Keep in sync with bootprof/bootprof.c
+typedef enum BootStage
+{
+    STAGE_MOUNT_FS = 0,
+    STAGE_READ_CONFIG,
+    STAGE_BOOT_OPTIONS,
+    STAGE_LOCATE_EMUNAND,
+    STAGE_WRITE_CONFIG,
+    STAGE_FIRM_READ,
+    STAGE_FIRM_DECRYPT,
+    STAGE_FIRM_PATCH
+} BootStage;
+
+/* Appended to /luma/bootprof.bin once per boot, followed by entryCount entries.
+   Flags: bit 0 N3DS, bit 1 A9LH, bit 2 firmlaunch, bits 3-4 nandType, bit 5 firmSource */
+typedef struct bootProfileHeader
+{
+    char magic[4];
+    u8 version;
+    u8 entryCount;
+    u8 firmType;
+    u8 flags;
+} bootProfileHeader;
+
+typedef struct bootProfileEntry
+{
+    u64 ticks; //Since the chrono was started, at 67MHz
+    u32 stage;
+    u32 reserved;
+} bootProfileEntry;
+
+#ifdef BOOT_PROFILE
+void profileStage(BootStage stage);
+void profileSave(u32 firmType, u32 flags);
+#else
+static inline void profileStage(__attribute__((unused)) BootStage stage) {}
+static inline void profileSave(__attribute__((unused)) u32 firmType, __attribute__((unused)) u32 flags) {}
+#endif
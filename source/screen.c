@@ -33,81 +33,118 @@
 #include "i2c.h"
 
 vu32 *const arm11Entry = (vu32 *)0x1FFFFFF8;
+static arm11Queue *const queue = (arm11Queue *)ARM11_QUEUE_ADDRESS;
 static const u32 brightness[4] = {0x5F, 0x4C, 0x39, 0x26};
 
-void  __attribute__((naked)) arm11Stub(void)
+static bool workerStarted = false,
+            backlightPending = false;
+
+static void __attribute__((noreturn)) arm11WorkerLoop(void)
 {
-    //Disable interrupts
-    __asm(".word 0xF10C01C0");
+    //Tell the ARM9 the entrypoint is free again
+    *arm11Entry = 0;
 
-    //Wait for the entry to be set
-    while(*arm11Entry == ARM11_STUB_ADDRESS);
+    while(true)
+    {
+        //Read the entry first, so that jobs submitted before it was set are seen and run before jumping to it
+        u32 entry = *arm11Entry,
+            tail = queue->tail;
 
-    //Jump to it
-    ((void (*)())*arm11Entry)();
+        if(tail != queue->head)
+        {
+            volatile arm11Job *job = &queue->jobs[tail % ARM11_QUEUE_SIZE];
+            job->func(job->arg);
+            queue->tail = tail + 1;
+        }
+        else if(entry) ((void (*)())entry)();
+    }
 }
 
-static void invokeArm11Function(void (*func)())
+static void __attribute__((naked)) arm11Worker(void)
 {
-    static bool hasCopiedStub = false;
-    if(!hasCopiedStub)
+    //Disable interrupts and move the stack below the queue
+    __asm(".word 0xF10C01C0\n\t"
+          "mov sp, #0x20000000\n\t"
+          "sub sp, sp, #0x200");
+
+    arm11WorkerLoop();
+}
+
+u32 arm11Submit(void (*func)(u32 arg), u32 arg)
+{
+    if(!workerStarted)
     {
-        memcpy((void *)ARM11_STUB_ADDRESS, arm11Stub, 0x30);
-        flushDCacheRange((void *)ARM11_STUB_ADDRESS, 0x30);
-        hasCopiedStub = true;
+        queue->head = 0;
+        queue->tail = 0;
+
+        *arm11Entry = (u32)arm11Worker;
+        while(*arm11Entry);
+
+        workerStarted = true;
     }
 
-    *arm11Entry = (u32)func;
-    while(*arm11Entry);
-    *arm11Entry = ARM11_STUB_ADDRESS;
+    u32 head = queue->head;
+
+    //Wait for a free slot
+    while(head - queue->tail >= ARM11_QUEUE_SIZE);
+
+    queue->jobs[head % ARM11_QUEUE_SIZE].func = func;
+    queue->jobs[head % ARM11_QUEUE_SIZE].arg = arg;
+    queue->head = head + 1;
+
+    //The job is done once the tail reaches this
+    return head + 1;
 }
 
-void deinitScreens(void)
+void arm11Wait(u32 fence)
 {
-    void __attribute__((naked)) ARM11(void)
+    if(workerStarted) while((s32)(queue->tail - fence) < 0);
+}
+
+void waitScreens(void)
+{
+    if(workerStarted) arm11Wait(queue->head);
+
+    //Only turn on the backlight once the screens have been initialized and cleared
+    if(backlightPending)
     {
-        //Disable interrupts
-        __asm(".word 0xF10C01C0");
+        i2cWriteRegister(I2C_DEV_MCU, 0x22, 0x2A);
+        backlightPending = false;
+    }
+}
 
+void deinitScreens(void)
+{
+    void ARM11(__attribute__((unused)) u32 arg)
+    {
         //Shutdown LCDs
         *(vu32 *)0x10202A44 = 0;
         *(vu32 *)0x10202244 = 0;
         *(vu32 *)0x10202014 = 0;
-
-        WAIT_FOR_ARM9();
     }
 
-    if(PDN_GPU_CNT != 1) invokeArm11Function(ARM11);
+    //Pending jobs may power the GPU on
+    waitScreens();
+
+    if(PDN_GPU_CNT != 1) arm11Wait(arm11Submit(ARM11, 0));
 }
 
 void updateBrightness(u32 brightnessIndex)
 {
-    static u32 brightnessLevel;
-    brightnessLevel = brightness[brightnessIndex];
-
-    void __attribute__((naked)) ARM11(void)
+    void ARM11(u32 brightnessLevel)
     {
-        //Disable interrupts
-        __asm(".word 0xF10C01C0");
-
         //Change brightness
         *(vu32 *)0x10202240 = brightnessLevel;
         *(vu32 *)0x10202A40 = brightnessLevel;
-
-        WAIT_FOR_ARM9();
     }
 
-    flushDCacheRange(&brightnessLevel, 4);
-    invokeArm11Function(ARM11);
+    arm11Submit(ARM11, brightness[brightnessIndex]);
 }
 
 void clearScreens(void)
 {   
-    void __attribute__((naked)) ARM11(void)
+    void ARM11(__attribute__((unused)) u32 arg)
     {
-        //Disable interrupts
-        __asm(".word 0xF10C01C0");
-
         //Setting up two simultaneous memory fills using the GPU
         vu32 *REGs_PSC0 = (vu32 *)0x10400010;
         REGs_PSC0[0] = (u32)fb->top_left >> 3; //Start address
@@ -132,21 +169,16 @@ void clearScreens(void)
 
             while(!(REGs_PSC0[3] & 2));
         }
-
-        WAIT_FOR_ARM9();
     }
 
     flushDCacheRange((void *)fb, sizeof(struct fb));
-    invokeArm11Function(ARM11);
+    arm11Submit(ARM11, 0);
 }
 
 void initScreens(void)
 {
-    void __attribute__((naked)) ARM11(void)
+    void ARM11(__attribute__((unused)) u32 arg)
     {
-        //Disable interrupts
-        __asm(".word 0xF10C01C0");
-
         u32 brightnessLevel = brightness[MULTICONFIG(0)];
         
         *(vu32 *)0x10141200 = 0x1007F;
@@ -236,24 +268,70 @@ void initScreens(void)
         fb->top_left = (u8 *)0x18300000;
         fb->top_right = (u8 *)0x18300000;
         fb->bottom = (u8 *)0x18346500;
-
-        WAIT_FOR_ARM9();
     }
 
-    if(PDN_GPU_CNT == 1)
+    //The GPU is only powered on once the queued init job has run
+    if(PDN_GPU_CNT == 1 && !backlightPending)
     {
         flushDCacheRange(&configData, sizeof(cfgData));
         flushDCacheRange((void *)fb, sizeof(struct fb));
-        invokeArm11Function(ARM11);
+        arm11Submit(ARM11, 0);
 
         clearScreens();
 
-        //Turn on backlight
-        i2cWriteRegister(I2C_DEV_MCU, 0x22, 0x2A);
+        //The backlight is turned on by waitScreens
+        backlightPending = true;
     }
     else
     {
         clearScreens();
         updateBrightness(MULTICONFIG(0));
     }
-}
\ No newline at end of file
+}
+
+u8 *initDoubleBuffering(void)
+{
+    void ARM11(u32 backBuffer)
+    {
+        //Framebuffer A is always TOP_FRAMEBUFFER_0 and B TOP_FRAMEBUFFER_1, 0x10400478 picks one
+        *(vu32 *)0x10400468 = (u32)TOP_FRAMEBUFFER_0;
+        *(vu32 *)0x1040046c = (u32)TOP_FRAMEBUFFER_1;
+        *(vu32 *)0x10400494 = (u32)TOP_FRAMEBUFFER_0;
+        *(vu32 *)0x10400498 = (u32)TOP_FRAMEBUFFER_1;
+
+        //Clear the hidden one, the shown one was cleared by initScreens
+        vu32 *REGs_PSC0 = (vu32 *)0x10400010;
+        REGs_PSC0[0] = backBuffer >> 3; //Start address
+        REGs_PSC0[1] = (backBuffer + 0x46500) >> 3; //End address
+        REGs_PSC0[2] = 0; //Fill value
+        REGs_PSC0[3] = (2 << 8) | 1; //32-bit pattern; start
+
+        while(!(REGs_PSC0[3] & 2));
+    }
+
+    waitScreens();
+
+    u8 *backBuffer = fb->top_left == TOP_FRAMEBUFFER_0 ? TOP_FRAMEBUFFER_1 : TOP_FRAMEBUFFER_0;
+
+    arm11Wait(arm11Submit(ARM11, (u32)backBuffer));
+
+    return backBuffer;
+}
+
+u8 *swapFramebuffers(void)
+{
+    void ARM11(u32 index)
+    {
+        *(vu32 *)0x10400478 = (*(vu32 *)0x10400478 & ~1) | index;
+    }
+
+    u32 newFront = fb->top_left == TOP_FRAMEBUFFER_0 ? 1 : 0;
+
+    //The old front buffer can't be drawn to before it's hidden
+    arm11Wait(arm11Submit(ARM11, newFront));
+
+    fb->top_left = fb->top_right = newFront ? TOP_FRAMEBUFFER_1 : TOP_FRAMEBUFFER_0;
+    flushDCacheRange((void *)fb, sizeof(struct fb));
+
+    return newFront ? TOP_FRAMEBUFFER_0 : TOP_FRAMEBUFFER_1;
+}
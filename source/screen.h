@@ -31,8 +31,25 @@
 
 #define PDN_GPU_CNT    (*(vu8  *)0x10141200)
 
-#define ARM11_STUB_ADDRESS  (0x25000000 - 0x30) //It's currently only 0x28 bytes large. We're putting 0x30 just to be sure here
-#define WAIT_FOR_ARM9()     *arm11Entry = 0; while(!*arm11Entry); ((void (*)())*arm11Entry)();
+//The ARM11 job queue lives in AXI WRAM, which the ARM9 doesn't cache, and the ARM11 stack grows down from it
+#define ARM11_QUEUE_ADDRESS 0x1FFFFE00
+#define ARM11_QUEUE_SIZE    8
+
+typedef struct arm11Job {
+    void (*func)(u32 arg);
+    u32 arg;
+} arm11Job;
+
+//Single producer (ARM9), single consumer (ARM11). The counters only ever increase
+typedef struct arm11Queue {
+    vu32 head; //Jobs submitted, only written by the ARM9
+    vu32 tail; //Jobs completed, only written by the ARM11
+    volatile arm11Job jobs[ARM11_QUEUE_SIZE];
+} arm11Queue;
+
+//The top screen framebuffers selected by the PDC, the second one is only used by the double buffered menus
+#define TOP_FRAMEBUFFER_0 ((u8 *)0x18300000)
+#define TOP_FRAMEBUFFER_1 ((u8 *)0x18400000)
 
 static volatile struct fb {
      u8 *top_left;
@@ -40,7 +57,12 @@ static volatile struct fb {
      u8 *bottom;
 } *const fb = (volatile struct fb *)0x23FFFE00;
 
+u32 arm11Submit(void (*func)(u32 arg), u32 arg);
+void arm11Wait(u32 fence);
+void waitScreens(void);
 void deinitScreens(void);
 void updateBrightness(u32 brightnessIndex);
 void clearScreens(void);
-void initScreens(void);
\ No newline at end of file
+void initScreens(void);
+u8 *initDoubleBuffering(void);
+u8 *swapFramebuffers(void);
\ No newline at end of file
@@ -0,0 +1,414 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b of GPLv3 applies to this file: Requiring preservation of specified
+*   reasonable legal notices or author attributions in that material or in the Appropriate Legal
+*   Notices displayed by works containing it.
+*/
+
+/*
+*   Table-driven AES-128 (FIPS-197) and SHA-256 (FIPS 180-4)
+*/
+
+#ifdef CRYPTO_SOFTWARE
+
+#include "swcrypto.h"
+#include "crypto.h"
+#include "memory.h"
+
+#define ROR32(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static u8 sbox[0x100],
+          invSbox[0x100];
+static u32 encTable[0x100],
+           decTable[0x100];
+static bool tablesReady = false;
+
+static struct
+{
+    u8 keyX[AES_BLOCK_SIZE];
+    u8 keyY[AES_BLOCK_SIZE];
+    u8 normalKey[AES_BLOCK_SIZE];
+} keyslots[0x40];
+
+static u8 currentKeyslot;
+
+static inline u8 xtime(u8 x)
+{
+    return (u8)((x << 1) ^ ((x & 0x80) ? 0x1B : 0));
+}
+
+static u8 gmul(u8 a, u8 b)
+{
+    u8 res = 0;
+
+    for(; b; b >>= 1, a = xtime(a))
+        if(b & 1) res ^= a;
+
+    return res;
+}
+
+static inline u8 rol8(u8 x, u32 n)
+{
+    return (u8)((x << n) | (x >> (8 - n)));
+}
+
+//Build the S-boxes and the combined SubBytes/MixColumns round tables
+static void initTables(void)
+{
+    u8 p = 1,
+       q = 1;
+
+    //p walks the multiplicative group with generator 3, q tracks its inverse
+    do
+    {
+        p ^= xtime(p);
+
+        q ^= q << 1;
+        q ^= q << 2;
+        q ^= q << 4;
+        if(q & 0x80) q ^= 0x09;
+
+        sbox[p] = q ^ rol8(q, 1) ^ rol8(q, 2) ^ rol8(q, 3) ^ rol8(q, 4) ^ 0x63;
+    }
+    while(p != 1);
+
+    sbox[0] = 0x63;
+
+    for(u32 i = 0; i < 0x100; i++)
+        invSbox[sbox[i]] = (u8)i;
+
+    for(u32 i = 0; i < 0x100; i++)
+    {
+        u8 s = sbox[i],
+           v = invSbox[i];
+
+        encTable[i] = ((u32)xtime(s) << 24) | ((u32)s << 16) | ((u32)s << 8) | (u32)(xtime(s) ^ s);
+        decTable[i] = ((u32)gmul(v, 14) << 24) | ((u32)gmul(v, 9) << 16) | ((u32)gmul(v, 13) << 8) | (u32)gmul(v, 11);
+    }
+
+    tablesReady = true;
+}
+
+static inline u32 loadBE(const u8 *in)
+{
+    return ((u32)in[0] << 24) | ((u32)in[1] << 16) | ((u32)in[2] << 8) | (u32)in[3];
+}
+
+static inline void storeBE(u8 *out, u32 val)
+{
+    out[0] = (u8)(val >> 24);
+    out[1] = (u8)(val >> 16);
+    out[2] = (u8)(val >> 8);
+    out[3] = (u8)val;
+}
+
+static inline u32 subWord(u32 w)
+{
+    return ((u32)sbox[w >> 24] << 24) | ((u32)sbox[(w >> 16) & 0xFF] << 16) |
+           ((u32)sbox[(w >> 8) & 0xFF] << 8) | (u32)sbox[w & 0xFF];
+}
+
+static void expandKey(u32 *encKeys, u32 *decKeys, const u8 *key)
+{
+    u8 rcon = 1;
+
+    for(u32 i = 0; i < 4; i++)
+        encKeys[i] = loadBE(key + 4 * i);
+
+    for(u32 i = 4; i < 44; i++)
+    {
+        u32 temp = encKeys[i - 1];
+
+        if(i % 4 == 0)
+        {
+            temp = subWord((temp << 8) | (temp >> 24)) ^ ((u32)rcon << 24);
+            rcon = xtime(rcon);
+        }
+
+        encKeys[i] = encKeys[i - 4] ^ temp;
+    }
+
+    //Equivalent inverse cipher: reversed round keys, InvMixColumns applied to the inner ones
+    for(u32 round = 0; round <= 10; round++)
+        for(u32 i = 0; i < 4; i++)
+        {
+            u32 w = encKeys[(10 - round) * 4 + i];
+
+            if(round != 0 && round != 10)
+                w = decTable[sbox[w >> 24]] ^ ROR32(decTable[sbox[(w >> 16) & 0xFF]], 8) ^
+                    ROR32(decTable[sbox[(w >> 8) & 0xFF]], 16) ^ ROR32(decTable[sbox[w & 0xFF]], 24);
+
+            decKeys[round * 4 + i] = w;
+        }
+}
+
+static void encryptBlock(const u32 *rk, u8 *out, const u8 *in)
+{
+    u32 s0 = loadBE(in) ^ rk[0],
+        s1 = loadBE(in + 4) ^ rk[1],
+        s2 = loadBE(in + 8) ^ rk[2],
+        s3 = loadBE(in + 12) ^ rk[3];
+
+    for(u32 round = 1; round < 10; round++)
+    {
+        rk += 4;
+
+        u32 t0 = encTable[s0 >> 24] ^ ROR32(encTable[(s1 >> 16) & 0xFF], 8) ^ ROR32(encTable[(s2 >> 8) & 0xFF], 16) ^ ROR32(encTable[s3 & 0xFF], 24) ^ rk[0],
+            t1 = encTable[s1 >> 24] ^ ROR32(encTable[(s2 >> 16) & 0xFF], 8) ^ ROR32(encTable[(s3 >> 8) & 0xFF], 16) ^ ROR32(encTable[s0 & 0xFF], 24) ^ rk[1],
+            t2 = encTable[s2 >> 24] ^ ROR32(encTable[(s3 >> 16) & 0xFF], 8) ^ ROR32(encTable[(s0 >> 8) & 0xFF], 16) ^ ROR32(encTable[s1 & 0xFF], 24) ^ rk[2],
+            t3 = encTable[s3 >> 24] ^ ROR32(encTable[(s0 >> 16) & 0xFF], 8) ^ ROR32(encTable[(s1 >> 8) & 0xFF], 16) ^ ROR32(encTable[s2 & 0xFF], 24) ^ rk[3];
+
+        s0 = t0;
+        s1 = t1;
+        s2 = t2;
+        s3 = t3;
+    }
+
+    rk += 4;
+
+    storeBE(out, (((u32)sbox[s0 >> 24] << 24) | ((u32)sbox[(s1 >> 16) & 0xFF] << 16) | ((u32)sbox[(s2 >> 8) & 0xFF] << 8) | sbox[s3 & 0xFF]) ^ rk[0]);
+    storeBE(out + 4, (((u32)sbox[s1 >> 24] << 24) | ((u32)sbox[(s2 >> 16) & 0xFF] << 16) | ((u32)sbox[(s3 >> 8) & 0xFF] << 8) | sbox[s0 & 0xFF]) ^ rk[1]);
+    storeBE(out + 8, (((u32)sbox[s2 >> 24] << 24) | ((u32)sbox[(s3 >> 16) & 0xFF] << 16) | ((u32)sbox[(s0 >> 8) & 0xFF] << 8) | sbox[s1 & 0xFF]) ^ rk[2]);
+    storeBE(out + 12, (((u32)sbox[s3 >> 24] << 24) | ((u32)sbox[(s0 >> 16) & 0xFF] << 16) | ((u32)sbox[(s1 >> 8) & 0xFF] << 8) | sbox[s2 & 0xFF]) ^ rk[3]);
+}
+
+static void decryptBlock(const u32 *rk, u8 *out, const u8 *in)
+{
+    u32 s0 = loadBE(in) ^ rk[0],
+        s1 = loadBE(in + 4) ^ rk[1],
+        s2 = loadBE(in + 8) ^ rk[2],
+        s3 = loadBE(in + 12) ^ rk[3];
+
+    for(u32 round = 1; round < 10; round++)
+    {
+        rk += 4;
+
+        u32 t0 = decTable[s0 >> 24] ^ ROR32(decTable[(s3 >> 16) & 0xFF], 8) ^ ROR32(decTable[(s2 >> 8) & 0xFF], 16) ^ ROR32(decTable[s1 & 0xFF], 24) ^ rk[0],
+            t1 = decTable[s1 >> 24] ^ ROR32(decTable[(s0 >> 16) & 0xFF], 8) ^ ROR32(decTable[(s3 >> 8) & 0xFF], 16) ^ ROR32(decTable[s2 & 0xFF], 24) ^ rk[1],
+            t2 = decTable[s2 >> 24] ^ ROR32(decTable[(s1 >> 16) & 0xFF], 8) ^ ROR32(decTable[(s0 >> 8) & 0xFF], 16) ^ ROR32(decTable[s3 & 0xFF], 24) ^ rk[2],
+            t3 = decTable[s3 >> 24] ^ ROR32(decTable[(s2 >> 16) & 0xFF], 8) ^ ROR32(decTable[(s1 >> 8) & 0xFF], 16) ^ ROR32(decTable[s0 & 0xFF], 24) ^ rk[3];
+
+        s0 = t0;
+        s1 = t1;
+        s2 = t2;
+        s3 = t3;
+    }
+
+    rk += 4;
+
+    storeBE(out, (((u32)invSbox[s0 >> 24] << 24) | ((u32)invSbox[(s3 >> 16) & 0xFF] << 16) | ((u32)invSbox[(s2 >> 8) & 0xFF] << 8) | invSbox[s1 & 0xFF]) ^ rk[0]);
+    storeBE(out + 4, (((u32)invSbox[s1 >> 24] << 24) | ((u32)invSbox[(s0 >> 16) & 0xFF] << 16) | ((u32)invSbox[(s3 >> 8) & 0xFF] << 8) | invSbox[s2 & 0xFF]) ^ rk[1]);
+    storeBE(out + 8, (((u32)invSbox[s2 >> 24] << 24) | ((u32)invSbox[(s1 >> 16) & 0xFF] << 16) | ((u32)invSbox[(s0 >> 8) & 0xFF] << 8) | invSbox[s3 & 0xFF]) ^ rk[2]);
+    storeBE(out + 12, (((u32)invSbox[s3 >> 24] << 24) | ((u32)invSbox[(s2 >> 16) & 0xFF] << 16) | ((u32)invSbox[(s1 >> 8) & 0xFF] << 8) | invSbox[s0 & 0xFF]) ^ rk[3]);
+}
+
+//Rotate a big endian 128-bit value left by the given amount of bits
+static void rol128(u8 *out, const u8 *in, u32 bits)
+{
+    u32 bytes = bits / 8;
+    bits %= 8;
+
+    for(u32 i = 0; i < AES_BLOCK_SIZE; i++)
+    {
+        u8 hi = in[(i + bytes) % AES_BLOCK_SIZE],
+           lo = in[(i + bytes + 1) % AES_BLOCK_SIZE];
+
+        out[i] = bits ? (u8)((hi << bits) | (lo >> (8 - bits))) : hi;
+    }
+}
+
+//NormalKey = (((KeyX <<< 2) ^ KeyY) + C) <<< 87
+static void scrambleKey(u8 *normalKey, const u8 *keyX, const u8 *keyY)
+{
+    static const u8 constant[AES_BLOCK_SIZE] = {0x1F, 0xF9, 0xE9, 0xAA, 0xC5, 0xFE, 0x04, 0x08, 0x02, 0x45, 0x91, 0xDC, 0x5D, 0x52, 0x76, 0x8A};
+    u8 tmp[AES_BLOCK_SIZE];
+    u32 carry = 0;
+
+    rol128(tmp, keyX, 2);
+
+    for(int i = AES_BLOCK_SIZE - 1; i >= 0; i--)
+    {
+        carry += (tmp[i] ^ keyY[i]) + constant[i];
+        tmp[i] = (u8)carry;
+        carry >>= 8;
+    }
+
+    rol128(normalKey, tmp, 87);
+}
+
+static void incrementCtr(u8 *ctr)
+{
+    for(int i = AES_BLOCK_SIZE - 1; i >= 0 && ++ctr[i] == 0; i--);
+}
+
+void swAesSetKey(u8 keyslot, const void *key, u32 keyType)
+{
+    switch(keyType)
+    {
+        case AES_KEYX:
+            memcpy(keyslots[keyslot].keyX, key, AES_BLOCK_SIZE);
+            break;
+        //Like on hardware, writing keyY is what generates the normal key
+        case AES_KEYY:
+            memcpy(keyslots[keyslot].keyY, key, AES_BLOCK_SIZE);
+            scrambleKey(keyslots[keyslot].normalKey, keyslots[keyslot].keyX, keyslots[keyslot].keyY);
+            break;
+        default:
+            memcpy(keyslots[keyslot].normalKey, key, AES_BLOCK_SIZE);
+            break;
+    }
+}
+
+void swAesUseKeyslot(u8 keyslot)
+{
+    currentKeyslot = keyslot;
+}
+
+/* Counters and IVs are big endian byte strings, as passed with AES_INPUT_BE | AES_INPUT_NORMAL.
+   The IV is updated the same way the hardware path does for chained calls */
+void swAes(void *dst, const void *src, u32 blockCount, void *iv, u32 mode)
+{
+    u32 encKeys[44],
+        decKeys[44];
+    u8 block[AES_BLOCK_SIZE],
+       tmp[AES_BLOCK_SIZE];
+    u8 *dst8 = (u8 *)dst;
+    const u8 *src8 = (const u8 *)src;
+    u8 *iv8 = (u8 *)iv;
+
+    if(!tablesReady) initTables();
+    expandKey(encKeys, decKeys, keyslots[currentKeyslot].normalKey);
+
+    for(u32 i = 0; i < blockCount; i++, src8 += AES_BLOCK_SIZE, dst8 += AES_BLOCK_SIZE)
+    {
+        memcpy(block, src8, AES_BLOCK_SIZE);
+
+        switch(mode)
+        {
+            case AES_CTR_MODE:
+                encryptBlock(encKeys, tmp, iv8);
+                incrementCtr(iv8);
+                for(u32 j = 0; j < AES_BLOCK_SIZE; j++) dst8[j] = block[j] ^ tmp[j];
+                break;
+            case AES_CBC_ENCRYPT_MODE:
+                for(u32 j = 0; j < AES_BLOCK_SIZE; j++) block[j] ^= iv8[j];
+                encryptBlock(encKeys, dst8, block);
+                memcpy(iv8, dst8, AES_BLOCK_SIZE);
+                break;
+            case AES_CBC_DECRYPT_MODE:
+                decryptBlock(decKeys, tmp, block);
+                for(u32 j = 0; j < AES_BLOCK_SIZE; j++) dst8[j] = tmp[j] ^ iv8[j];
+                memcpy(iv8, block, AES_BLOCK_SIZE);
+                break;
+            case AES_ECB_ENCRYPT_MODE:
+                encryptBlock(encKeys, dst8, block);
+                break;
+            case AES_ECB_DECRYPT_MODE:
+                decryptBlock(decKeys, dst8, block);
+                break;
+            //CCM isn't used anywhere
+            default:
+                return;
+        }
+    }
+}
+
+static const u32 shaK[64] = {
+    0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5, 0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+    0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3, 0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174,
+    0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC, 0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+    0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7, 0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967,
+    0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13, 0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+    0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3, 0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+    0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5, 0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+    0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208, 0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2
+};
+
+static void sha256Block(u32 *state, const u8 *data)
+{
+    u32 w[64];
+
+    for(u32 i = 0; i < 16; i++)
+        w[i] = loadBE(data + 4 * i);
+
+    for(u32 i = 16; i < 64; i++)
+    {
+        u32 s0 = ROR32(w[i - 15], 7) ^ ROR32(w[i - 15], 18) ^ (w[i - 15] >> 3),
+            s1 = ROR32(w[i - 2], 17) ^ ROR32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    u32 a = state[0], b = state[1], c = state[2], d = state[3],
+        e = state[4], f = state[5], g = state[6], h = state[7];
+
+    for(u32 i = 0; i < 64; i++)
+    {
+        u32 t1 = h + (ROR32(e, 6) ^ ROR32(e, 11) ^ ROR32(e, 25)) + ((e & f) ^ (~e & g)) + shaK[i] + w[i],
+            t2 = (ROR32(a, 2) ^ ROR32(a, 13) ^ ROR32(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
+}
+
+void swSha256(void *res, const void *src, u32 size)
+{
+    u32 state[8] = {0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A, 0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19};
+    u8 __attribute__((aligned(4))) block[0x40];
+    const u8 *src8 = (const u8 *)src;
+    u32 remaining = size;
+
+    for(; remaining >= 0x40; remaining -= 0x40, src8 += 0x40)
+        sha256Block(state, src8);
+
+    //Pad with 0x80, zeroes and the bit length
+    memset32(block, 0, 0x40);
+    memcpy(block, src8, remaining);
+    block[remaining] = 0x80;
+
+    if(remaining >= 0x38)
+    {
+        sha256Block(state, block);
+        memset32(block, 0, 0x40);
+    }
+
+    storeBE(block + 0x38, size >> 29);
+    storeBE(block + 0x3C, size << 3);
+    sha256Block(state, block);
+
+    for(u32 i = 0; i < 8; i++)
+        storeBE((u8 *)res + 4 * i, state[i]);
+}
+
+#endif
@@ -0,0 +1,36 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b of GPLv3 applies to this file: Requiring preservation of specified
+*   reasonable legal notices or author attributions in that material or in the Appropriate Legal
+*   Notices displayed by works containing it.
+*/
+
+/*
+*   Software AES-128 and SHA-256, used by crypto.c instead of the AES/SHA engines
+*   when building with crypto_backend=software. Keyslots are emulated, including the keyX/keyY
+*   scrambler, but keys provisioned by the bootROM are unknown to it
+*/
+
+#pragma once
+
+#include "types.h"
+
+void swAesSetKey(u8 keyslot, const void *key, u32 keyType);
+void swAesUseKeyslot(u8 keyslot);
+void swAes(void *dst, const void *src, u32 blockCount, void *iv, u32 mode);
+void swSha256(void *res, const void *src, u32 size);
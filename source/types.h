@@ -31,6 +31,7 @@ typedef uint8_t u8;
 typedef uint16_t u16;
 typedef uint32_t u32;
 typedef uint64_t u64;
+typedef int32_t s32;
 typedef volatile u8 vu8;
 typedef volatile u16 vu16;
 typedef volatile u32 vu32;
@@ -41,7 +42,8 @@ typedef enum FirmwareSource
 {
     FIRMWARE_SYSNAND = 0,
     FIRMWARE_EMUNAND = 1,
-    FIRMWARE_EMUNAND2 = 2
+    FIRMWARE_EMUNAND2 = 2,
+    FIRMWARE_EMUNAND3 = 3
 } FirmwareSource;
 
 typedef enum FirmwareType
@@ -51,4 +53,22 @@ typedef enum FirmwareType
     AGB_FIRM = 2,
     SAFE_FIRM = 3,
     NATIVE_FIRM2X = 4
-} FirmwareType;
\ No newline at end of file
+} FirmwareType;
+
+//FIRM Header layout
+typedef struct firmSectionHeader {
+    u32 offset;
+    u8 *address;
+    u32 size;
+    u32 procType;
+    u8 hash[0x20];
+} firmSectionHeader;
+
+typedef struct firmHeader {
+    u32 magic;
+    u32 reserved1;
+    u8 *arm11Entry;
+    u8 *arm9Entry;
+    u8 reserved2[0x30];
+    firmSectionHeader section[4];
+} firmHeader;
\ No newline at end of file
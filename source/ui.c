@@ -0,0 +1,134 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b of GPLv3 applies to this file: Requiring preservation of specified
+*   reasonable legal notices or author attributions in that material or in the Appropriate Legal
+*   Notices displayed by works containing it.
+*/
+
+/*
+*   Retained text for the menus: rows only get their changed glyph cells redrawn,
+*   in the hidden framebuffer, which is then shown
+*/
+
+#include "ui.h"
+#include "draw.h"
+#include "screen.h"
+#include "utils.h"
+
+static uiRow rows[UI_MAX_ROWS],
+             drawnRows[2][UI_MAX_ROWS]; //What each framebuffer shows, the first set being the hidden one's
+static u32 rowCount,
+           drawnRowCounts[2],
+           hidden;
+static u8 *backBuffer;
+
+static u32 rowLength(const uiRow *row)
+{
+    u32 length = (SCREEN_TOP_WIDTH - row->posX) / SPACING_X;
+
+    return length < UI_ROW_LENGTH ? length : UI_ROW_LENGTH;
+}
+
+static void blankRow(uiRow *row)
+{
+    for(u32 i = 0; i < UI_ROW_LENGTH; i++) row->text[i] = ' ';
+}
+
+void uiInit(void)
+{
+    initScreens();
+    backBuffer = initDoubleBuffering();
+
+    //Both framebuffers are now blank
+    rowCount = drawnRowCounts[0] = drawnRowCounts[1] = 0;
+}
+
+void uiClear(void)
+{
+    rowCount = 0;
+}
+
+u32 uiAddRow(int posX, int posY, const char *text, u32 color)
+{
+    if(rowCount == UI_MAX_ROWS) error("Too many menu rows");
+
+    rows[rowCount].posX = posX;
+    rows[rowCount].posY = posY;
+    rows[rowCount].color = color;
+    uiSetText(rowCount, text);
+
+    return rowCount++;
+}
+
+void uiSetText(u32 row, const char *text)
+{
+    uiRow *const dest = &rows[row];
+    u32 length = rowLength(dest),
+        i;
+
+    for(i = 0; i < length && text[i]; i++) dest->text[i] = text[i];
+    for(; i < UI_ROW_LENGTH; i++) dest->text[i] = ' ';
+}
+
+void uiSetCharacter(u32 row, u32 pos, char character)
+{
+    if(pos < rowLength(&rows[row])) rows[row].text[pos] = character;
+}
+
+void uiSetColor(u32 row, u32 color)
+{
+    rows[row].color = color;
+}
+
+void uiFlush(void)
+{
+    uiRow *const drawn = drawnRows[hidden];
+    u32 drawnCount = drawnRowCounts[hidden];
+
+    waitScreens();
+
+    //Erase the rows that moved or went away first, as others may take their place
+    for(u32 i = 0; i < drawnCount; i++)
+        if(i >= rowCount || drawn[i].posX != rows[i].posX || drawn[i].posY != rows[i].posY)
+        {
+            for(u32 j = 0; j < UI_ROW_LENGTH; j++)
+                if(drawn[i].text[j] != ' ') drawCell(backBuffer, ' ', drawn[i].posX + j * SPACING_X, drawn[i].posY, COLOR_BLACK);
+
+            blankRow(&drawn[i]);
+        }
+
+    for(u32 i = drawnCount; i < rowCount; i++) blankRow(&drawn[i]);
+
+    //Only redraw the cells whose character or color changed
+    for(u32 i = 0; i < rowCount; i++)
+    {
+        const uiRow *row = &rows[i];
+        bool recolor = row->color != drawn[i].color;
+
+        for(u32 j = 0; j < UI_ROW_LENGTH; j++)
+            if(row->text[j] != drawn[i].text[j] || (recolor && row->text[j] != ' '))
+                drawCell(backBuffer, row->text[j], row->posX + j * SPACING_X, row->posY, row->color);
+
+        drawn[i] = *row;
+    }
+
+    drawnRowCounts[hidden] = rowCount;
+
+    backBuffer = swapFramebuffers();
+    hidden ^= 1;
+}
@@ -0,0 +1,45 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b of GPLv3 applies to this file: Requiring preservation of specified
+*   reasonable legal notices or author attributions in that material or in the Appropriate Legal
+*   Notices displayed by works containing it.
+*/
+
+#pragma once
+
+#include "types.h"
+
+#define UI_MAX_ROWS   16
+#define UI_ROW_LENGTH 50 //SCREEN_TOP_WIDTH / SPACING_X
+
+//A single line of text on the top screen, never wrapped
+typedef struct uiRow
+{
+    int posX,
+        posY;
+    u32 color;
+    char text[UI_ROW_LENGTH];
+} uiRow;
+
+void uiInit(void);
+void uiClear(void);
+u32 uiAddRow(int posX, int posY, const char *text, u32 color);
+void uiSetText(u32 row, const char *text);
+void uiSetCharacter(u32 row, u32 pos, char character);
+void uiSetColor(u32 row, u32 color);
+void uiFlush(void);
@@ -58,6 +58,8 @@ void mcuReboot(void)
 {
     if(!isFirmlaunch && PDN_GPU_CNT != 1) clearScreens();
 
+    waitScreens();
+
     flushEntireDCache(); //Ensure that all memory transfers have completed and that the data cache has been flushed
 
     i2cWriteRegister(I2C_DEV_MCU, 0x20, 1 << 2);
@@ -68,6 +70,8 @@ void mcuPowerOff(void)
 {
     if(!isFirmlaunch && PDN_GPU_CNT != 1) clearScreens();
 
+    waitScreens();
+
     flushEntireDCache(); //Ensure that all memory transfers have completed and that the data cache has been flushed
     
     i2cWriteRegister(I2C_DEV_MCU, 0x20, 1 << 0);
@@ -75,7 +79,7 @@ void mcuPowerOff(void)
 }
 
 //TODO: add support for TIMER IRQ
-static inline void startChrono(u64 initialTicks)
+void startChrono(u64 initialTicks)
 {
     //Based on a NATIVE_FIRM disassembly
 
@@ -88,27 +92,42 @@ static inline void startChrono(u64 initialTicks)
     for(u32 i = 1; i < 4; i++) REG_TIMER_CNT(i) = 0x84; //Count-up; enabled
 }
 
-static inline void stopChrono(void)
+void stopChrono(void)
 {
     for(u32 i = 0; i < 4; i++) REG_TIMER_CNT(i) &= ~0x80;
 }
 
-void chrono(u32 seconds)
+//Timers 1-3, which only change when timer 0 overflows
+static inline u64 readChronoHigh(void)
 {
-    startChrono(0);
+    u64 res = 0;
+    for(u32 i = 1; i < 4; i++) res |= (u64)REG_TIMER_VAL(i) << (16 * i);
 
-    u64 startingTicks = 0;
-    for(u32 i = 0; i < 4; i++) startingTicks |= REG_TIMER_VAL(i) << (16 * i);
+    return res;
+}
+
+u64 chronoTicks(void)
+{
+    u64 high;
+    u16 low;
 
-    u64 res;
+    //Timer 0 is read between two reads of the others, retry if it overflowed in between
     do
     {
-        res = 0;
-        for(u32 i = 0; i < 4; i++) res |= REG_TIMER_VAL(i) << (16 * i);
+        high = readChronoHigh();
+        low = REG_TIMER_VAL(0);
     }
-    while(res - startingTicks < seconds * TICKS_PER_SEC);
+    while(high != readChronoHigh());
+
+    return high | low;
+}
+
+void chrono(u32 seconds)
+{
+    //The chrono is started at boot and left running
+    u64 startingTicks = chronoTicks();
 
-    stopChrono();
+    while(chronoTicks() - startingTicks < seconds * TICKS_PER_SEC);
 }
 
 void error(const char *message)
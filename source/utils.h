@@ -33,5 +33,8 @@ extern bool isFirmlaunch;
 u32 waitInput(void);
 void mcuReboot(void);
 void mcuPowerOff(void);
+void startChrono(u64 initialTicks);
+void stopChrono(void);
+u64 chronoTicks(void);
 void chrono(u32 seconds);
 void error(const char *message);
\ No newline at end of file
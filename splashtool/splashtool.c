@@ -0,0 +1,271 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef uint8_t u8;
+typedef uint32_t u32;
+
+//The decoder the firmware uses
+#include "../source/lz4.h"
+
+//Keep in sync with source/draw.h
+#define SPLASH_MAGIC         "SPLZ"
+#define SPLASH_HEADER_SIZE   8
+#define SCREEN_TOP_FBSIZE    (400 * 240 * 3)
+#define SCREEN_BOTTOM_FBSIZE (320 * 240 * 3)
+
+#define HASH_BITS       16
+#define MIN_MATCH       4
+#define MAX_OFFSET      0xFFFF
+#define LAST_LITERALS   5  //The LZ4 format wants the last bytes to be literals
+#define MATCH_LIMIT     12 //and no match to start this close to the end
+#define BENCHMARK_ROUNDS 200
+
+static void usage(const char *name)
+{
+    printf("Usage: %s <framebuffer.bin> <splash.bin>   compress a raw splash\n"
+           "       %s -d <splash.bin> <framebuffer.bin> decompress a splash\n"
+           "       %s -b <splash.bin>                   benchmark the decoder\n", name, name, name);
+    exit(0);
+}
+
+static u8 *readFile(const char *path, u32 *size)
+{
+    FILE *fp = fopen(path, "rb");
+    if(fp == NULL)
+    {
+        printf("Couldn't open %s\n", path);
+        exit(1);
+    }
+
+    fseek(fp, 0, SEEK_END);
+    *size = ftell(fp);
+    rewind(fp);
+
+    u8 *buf = malloc(*size ? *size : 1);
+    if(buf == NULL || fread(buf, 1, *size, fp) != *size)
+    {
+        printf("Couldn't read %s\n", path);
+        exit(1);
+    }
+
+    fclose(fp);
+
+    return buf;
+}
+
+static void writeFile(const char *path, const u8 *buf, u32 size)
+{
+    FILE *fp = fopen(path, "wb");
+    if(fp == NULL || fwrite(buf, 1, size, fp) != size)
+    {
+        printf("Couldn't write %s\n", path);
+        exit(1);
+    }
+
+    fclose(fp);
+}
+
+static u32 read32(const u8 *buf)
+{
+    return buf[0] | (buf[1] << 8) | (buf[2] << 16) | ((u32)buf[3] << 24);
+}
+
+static void write32(u8 *buf, u32 value)
+{
+    buf[0] = value;
+    buf[1] = value >> 8;
+    buf[2] = value >> 16;
+    buf[3] = value >> 24;
+}
+
+static u32 hash(const u8 *pos)
+{
+    return (read32(pos) * 2654435761U) >> (32 - HASH_BITS);
+}
+
+static u8 *writeLength(u8 *out, u32 length)
+{
+    for(; length >= 255; length -= 255) *out++ = 255;
+    *out++ = length;
+
+    return out;
+}
+
+static u8 *writeSequence(u8 *out, const u8 *literals, u32 literalCount, u32 offset, u32 matchLength)
+{
+    u8 *token = out++;
+
+    *token = (literalCount >= 15 ? 15 : literalCount) << 4;
+    if(literalCount >= 15) out = writeLength(out, literalCount - 15);
+
+    memcpy(out, literals, literalCount);
+    out += literalCount;
+
+    //Sequence with literals only
+    if(!matchLength) return out;
+
+    *out++ = offset;
+    *out++ = offset >> 8;
+
+    matchLength -= MIN_MATCH;
+    *token |= matchLength >= 15 ? 15 : matchLength;
+    if(matchLength >= 15) out = writeLength(out, matchLength - 15);
+
+    return out;
+}
+
+//Greedy LZ4 block compressor, out must hold size + size / 255 + 16 bytes
+static u32 compressLZ4(u8 *out, const u8 *in, u32 size)
+{
+    static u32 table[1 << HASH_BITS];
+    u8 *outStart = out;
+    u32 anchor = 0,
+        pos = 0;
+
+    memset(table, 0xFF, sizeof(table));
+
+    while(size > MATCH_LIMIT && pos < size - MATCH_LIMIT)
+    {
+        u32 h = hash(in + pos),
+            candidate = table[h];
+
+        table[h] = pos;
+
+        if(candidate == 0xFFFFFFFF || pos - candidate > MAX_OFFSET || read32(in + candidate) != read32(in + pos))
+        {
+            pos++;
+            continue;
+        }
+
+        u32 length = MIN_MATCH;
+        while(pos + length < size - LAST_LITERALS && in[candidate + length] == in[pos + length]) length++;
+
+        out = writeSequence(out, in + anchor, pos - anchor, pos - candidate, length);
+        pos += length;
+        anchor = pos;
+    }
+
+    out = writeSequence(out, in + anchor, size - anchor, 0, 0);
+
+    return out - outStart;
+}
+
+static u8 *decompressSplash(const u8 *splash, u32 size, u32 *decompressedSize)
+{
+    if(size <= SPLASH_HEADER_SIZE || memcmp(splash, SPLASH_MAGIC, 4) != 0)
+    {
+        printf("Not a compressed splash\n");
+        exit(1);
+    }
+
+    *decompressedSize = read32(splash + 4);
+
+    u8 *out = malloc(*decompressedSize ? *decompressedSize : 1);
+    if(out == NULL)
+    {
+        printf("Out of memory\n");
+        exit(1);
+    }
+
+    if(decompressLZ4(out, *decompressedSize, splash + SPLASH_HEADER_SIZE, size - SPLASH_HEADER_SIZE) != *decompressedSize)
+    {
+        printf("Corrupted splash\n");
+        exit(1);
+    }
+
+    return out;
+}
+
+static void compress(const char *inPath, const char *outPath)
+{
+    u32 size;
+    u8 *in = readFile(inPath, &size);
+
+    if(size != SCREEN_TOP_FBSIZE && size != SCREEN_BOTTOM_FBSIZE)
+        printf("Warning: %u bytes, neither a top (%u) nor a bottom (%u) screen framebuffer\n", size, SCREEN_TOP_FBSIZE, SCREEN_BOTTOM_FBSIZE);
+
+    u8 *out = malloc(SPLASH_HEADER_SIZE + size + size / 255 + 16);
+    if(out == NULL)
+    {
+        printf("Out of memory\n");
+        exit(1);
+    }
+
+    memcpy(out, SPLASH_MAGIC, 4);
+    write32(out + 4, size);
+
+    u32 outSize = SPLASH_HEADER_SIZE + compressLZ4(out + SPLASH_HEADER_SIZE, in, size);
+
+    //Luma3DS reads both splashes into a framebuffer-sized slot each, so never store a bigger file
+    if(outSize >= size)
+    {
+        printf("%s doesn't compress, writing it raw\n", inPath);
+        writeFile(outPath, in, size);
+    }
+    else
+    {
+        u32 checkSize;
+        u8 *check = decompressSplash(out, outSize, &checkSize);
+
+        if(checkSize != size || memcmp(check, in, size) != 0)
+        {
+            printf("Round trip check failed\n");
+            exit(1);
+        }
+
+        free(check);
+        writeFile(outPath, out, outSize);
+        printf("%u -> %u bytes (%.1fx)\n", size, outSize, (double)size / outSize);
+    }
+
+    free(in);
+    free(out);
+}
+
+static void decompress(const char *inPath, const char *outPath)
+{
+    u32 size,
+        decompressedSize;
+    u8 *in = readFile(inPath, &size),
+       *out = decompressSplash(in, size, &decompressedSize);
+
+    writeFile(outPath, out, decompressedSize);
+
+    free(in);
+    free(out);
+}
+
+static void benchmark(const char *path)
+{
+    u32 size,
+        decompressedSize;
+    u8 *in = readFile(path, &size),
+       *out = decompressSplash(in, size, &decompressedSize);
+
+    clock_t start = clock();
+
+    for(u32 i = 0; i < BENCHMARK_ROUNDS; i++)
+        decompressLZ4(out, decompressedSize, in + SPLASH_HEADER_SIZE, size - SPLASH_HEADER_SIZE);
+
+    double seconds = (double)(clock() - start) / CLOCKS_PER_SEC,
+           perRound = seconds * 1000 / BENCHMARK_ROUNDS;
+
+    printf("%u -> %u bytes (%.1fx), %.3f ms per decode, %.1f MB/s\n", size, decompressedSize,
+           (double)decompressedSize / size, perRound, seconds > 0 ? decompressedSize * (double)BENCHMARK_ROUNDS / seconds / 1048576 : 0);
+
+    free(in);
+    free(out);
+}
+
+int main(int argc, char **argv)
+{
+    if(argc == 3 && strcmp(argv[1], "-b") == 0) benchmark(argv[2]);
+    else if(argc == 4 && strcmp(argv[1], "-d") == 0) decompress(argv[2], argv[3]);
+    else if(argc == 3 && argv[1][0] != '-') compress(argv[1], argv[2]);
+    else usage(argv[0]);
+
+    return 0;
+}
@@ -0,0 +1,214 @@
+/*
+*   Two-thread host model of the ARM9 -> ARM11 job queue of source/screen.c.
+*   screen.c is included as is, with the ARM11 worker's assembly prologue left out. A second
+*   thread plays the ARM11: like its bootrom, it waits for an entrypoint and jumps to it.
+*   The ARM9 side starts the worker with arm11Submit and streams jobs through the ring, waiting
+*   on some of their fences, while the jobs now and then stall so that the ring fills up.
+*   The jobs have to run once each and in order, never more than ARM11_QUEUE_SIZE may be
+*   outstanding, and arm11Wait must not return before its job ran. Then a FIRM launch is
+*   modeled: the entrypoint is set behind queued jobs, which all have to run before the jump,
+*   and the worker is restarted with the counters about to wrap around, and it all runs again.
+*   A last restart checks that a fence past the wrap around isn't taken as already reached.
+*   Both sides spin, so a timer makes the running thread yield, for single core hosts
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/time.h>
+#include "hostdisk.h"
+
+#define naked noinline
+#define __asm(...)
+#include "../source/screen.c"
+#undef __asm
+#undef naked
+
+#define JOBS            20000
+#define WAIT_EVERY      37
+#define STALL_EVERY     16
+#define WRAP_START      0xFFFFFF00
+
+//Shared by the two threads
+static volatile u32 jobsRun,
+                    stallLength,
+                    orderErrors,
+                    boundErrors;
+
+static volatile bool launched,
+                     resume;
+static u32 launchPending;
+
+//What screen.c calls besides the queue, the jobs here don't touch the hardware
+void flushDCacheRange(__attribute__((unused)) void *startAddress, __attribute__((unused)) u32 size) {}
+u32 i2cWriteRegister(__attribute__((unused)) u8 dev_id, __attribute__((unused)) u8 reg, __attribute__((unused)) u8 data) { return 1; }
+cfgData configData;
+
+static void yieldCore(__attribute__((unused)) int signal)
+{
+    sched_yield();
+}
+
+//The ARM11 bootrom's wait for an entrypoint
+static void *arm11Core(__attribute__((unused)) void *arg)
+{
+    u32 entry;
+
+    while(!(entry = *arm11Entry));
+    ((void (*)(void))(uintptr_t)entry)();
+
+    return NULL;
+}
+
+static bool ringOverrun(u32 index)
+{
+    u32 pending = queue->head - queue->tail;
+
+    return pending == 0 || pending > ARM11_QUEUE_SIZE || queue->jobs[index % ARM11_QUEUE_SIZE].arg != index;
+}
+
+//The running job's slot must stay as it is until it's done
+static void recordJob(u32 index)
+{
+    if(index != jobsRun) orderErrors++;
+    if(ringOverrun(index)) boundErrors++;
+
+    //Keep the ARM9 ahead now and then
+    if(index % STALL_EVERY == 0) for(volatile u32 i = 0; i < stallLength; i++);
+
+    if(ringOverrun(index)) boundErrors++;
+
+    jobsRun = index + 1;
+}
+
+//A job the ARM9 has to wait for
+static void slowJob(u32 index)
+{
+    double end = now() + 0.002;
+
+    while(now() < end);
+
+    jobsRun = index + 1;
+}
+
+//Where the worker jumps once the entrypoint is set, the next FIRM
+static void launchedFirm(void)
+{
+    launchPending = queue->head - queue->tail;
+    launched = true;
+
+    while(!resume);
+
+    arm11WorkerLoop();
+}
+
+//Jobs queued before the entrypoint is set run before the jump, then the next FIRM restarts the worker
+static int relaunch(u32 counters)
+{
+    int failed = 0;
+
+    jobsRun = 0;
+    for(u32 i = 0; i < 5; i++) arm11Submit(recordJob, i);
+    *arm11Entry = (u32)(uintptr_t)launchedFirm;
+
+    while(!launched);
+
+    if(launchPending != 0 || jobsRun != 5)
+    {
+        printf("The worker jumped to the entrypoint with %u jobs pending\n", launchPending);
+        failed = 1;
+    }
+
+    queue->head = queue->tail = counters;
+    launched = false;
+    resume = true;
+    while(*arm11Entry);
+    resume = false;
+
+    return failed;
+}
+
+//A fence past the wrap around while the jobs before it are still running
+static int waitAcrossWrap(void)
+{
+    u32 fence = 0;
+
+    jobsRun = 0;
+    for(u32 i = 0; i < 6; i++) fence = arm11Submit(slowJob, i);
+
+    arm11Wait(fence);
+
+    if(jobsRun != 6)
+    {
+        printf("arm11Wait(0x%08X) returned after %u of the 6 jobs before it\n", fence, jobsRun);
+        return 1;
+    }
+
+    printf("Wrap around: arm11Wait(0x%08X) returned once the jobs from 0x%08X had run\n", fence, fence - 6);
+
+    return 0;
+}
+
+static int streamJobs(const char *name)
+{
+    u32 waitErrors = 0,
+        fullRing = 0,
+        start = queue->head;
+
+    jobsRun = 0;
+    orderErrors = 0;
+    boundErrors = 0;
+
+    for(u32 i = 0; i < JOBS; i++)
+    {
+        if(workerStarted && queue->head - queue->tail == ARM11_QUEUE_SIZE) fullRing++;
+
+        stallLength = (i * 2654435761U) >> 16;
+        u32 fence = arm11Submit(recordJob, i);
+
+        if(fence - start != i + 1) waitErrors++;
+
+        if(i % WAIT_EVERY == 0)
+        {
+            arm11Wait(fence);
+            if(jobsRun < i + 1) waitErrors++;
+        }
+    }
+
+    waitScreens();
+
+    int failed = jobsRun != JOBS || queue->tail != queue->head || orderErrors || boundErrors || waitErrors || !fullRing;
+
+    printf("%s: %u jobs from 0x%08X to 0x%08X, ring full %u times%s\n", name, JOBS, start, queue->head,
+           fullRing, failed ? "" : ", all in order");
+
+    if(failed)
+        printf("%s: %u jobs run, %u out of order, %u ring overruns, %u early or wrong fences\n", name, jobsRun, orderErrors, boundErrors, waitErrors);
+
+    return failed;
+}
+
+int main(void)
+{
+    pthread_t arm11;
+    struct itimerval interval = {{0, 20}, {0, 20}};
+    int failed = 0;
+
+    signal(SIGALRM, yieldCore);
+    setitimer(ITIMER_REAL, &interval, NULL);
+
+    //The entrypoint and the queue are in the last page of AXI WRAM
+    mapFixed(ARM11_QUEUE_ADDRESS & ~0xFFF, 0x1000);
+
+    pthread_create(&arm11, NULL, arm11Core, NULL);
+
+    failed |= streamJobs("First boot");
+    failed |= relaunch(WRAP_START);
+    failed |= streamJobs("Restarted");
+    failed |= relaunch(0xFFFFFFFC);
+    failed |= waitAcrossWrap();
+
+    return failed;
+}
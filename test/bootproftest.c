@@ -0,0 +1,101 @@
+/*
+*   Host test of the boot profile source/profile.c appends to /luma/bootprof.bin, built with
+*   BOOT_PROFILE. One boot records more stages than the ring buffer holds, the record is written
+*   to the file given on the command line and checked to hold the most recent entries, oldest
+*   first. The Makefile then decodes that file with bootprof/bootprof.c
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "../source/profile.h"
+
+#define STAGES      20
+#define STAGE_TICKS 670280 //About 10ms
+
+static const char *outPath;
+static u64 currentTicks;
+
+u64 chronoTicks(void)
+{
+    return currentTicks;
+}
+
+bool fileAppend(const void *buffer, const char *path, u32 size)
+{
+    if(strcmp(path, "/luma/bootprof.bin") != 0)
+    {
+        printf("The profile is appended to %s\n", path);
+        return false;
+    }
+
+    FILE *fp = fopen(outPath, "ab");
+    bool written = fp != NULL && fwrite(buffer, 1, size, fp) == size;
+
+    if(fp != NULL) fclose(fp);
+
+    return written;
+}
+
+int main(int argc, char **argv)
+{
+    if(argc != 2)
+    {
+        printf("Usage: %s <bootprof.bin>\n", argv[0]);
+        return 1;
+    }
+
+    outPath = argv[1];
+    remove(outPath);
+
+    for(u32 i = 0; i < STAGES; i++)
+    {
+        currentTicks += STAGE_TICKS * (i % 8 + 1);
+        profileStage((BootStage)(i % 8));
+    }
+
+    profileSave(2, 0x21);
+
+    FILE *fp = fopen(outPath, "rb");
+    struct
+    {
+        bootProfileHeader header;
+        bootProfileEntry entries[PROFILE_ENTRIES];
+    } record;
+    u32 size = fp != NULL ? fread(&record, 1, sizeof(record), fp) : 0;
+
+    //Nothing past the record either
+    if(fp != NULL)
+    {
+        if(fgetc(fp) != EOF) size++;
+        fclose(fp);
+    }
+
+    if(size != sizeof(record) || memcmp(record.header.magic, PROFILE_MAGIC, 4) != 0 || record.header.version != PROFILE_VERSION ||
+       record.header.entryCount != PROFILE_ENTRIES || record.header.firmType != 2 || record.header.flags != 0x21)
+    {
+        printf("The profile header isn't the one recorded\n");
+        return 1;
+    }
+
+    //The first STAGES - PROFILE_ENTRIES stages are dropped
+    u64 ticks = 0;
+
+    for(u32 i = 0; i < STAGES; i++)
+    {
+        ticks += STAGE_TICKS * (i % 8 + 1);
+        if(i < STAGES - PROFILE_ENTRIES) continue;
+
+        const bootProfileEntry *entry = &record.entries[i - (STAGES - PROFILE_ENTRIES)];
+
+        if(entry->ticks != ticks || entry->stage != i % 8)
+        {
+            printf("Entry %u is stage %u at %llu ticks instead of stage %u at %llu\n", i - (STAGES - PROFILE_ENTRIES),
+                   entry->stage, (unsigned long long)entry->ticks, i % 8, (unsigned long long)ticks);
+            return 1;
+        }
+    }
+
+    printf("%u of %u stages recorded, oldest first\n", PROFILE_ENTRIES, STAGES);
+
+    return 0;
+}
@@ -0,0 +1,246 @@
+/*
+*   Host test of the injector's code cache keys and eviction, see injector/source/codecacheindex.c.
+*   codecacheindex.c is linked as is, with the settings and files patcher.c would look up played
+*   by variables here. Titles are launched like load_code does, with the cache files modeled by
+*   a table, and changing every setting a title's patches depend on has to make it miss, while
+*   the cache never goes over its size or entry limits and drops the least recently launched title
+*/
+
+#include <stdio.h>
+#include "../injector/source/codecacheindex.h"
+
+//What patcher.c gets from the SD and svcGetCFWInfo
+static CFWInfo info;
+
+static bool secureInfoPresent,
+            codeSectionPresent;
+static u8 localeRegion = 0xFF,
+          localeLanguage = 0xFF;
+
+static codeCacheIndex cacheIndex;
+
+const CFWInfo *getCFWInfo(void)
+{
+    return &info;
+}
+
+bool secureInfoExists(void)
+{
+    return secureInfoPresent;
+}
+
+bool titleHasCodeSection(__attribute__((unused)) u64 progId)
+{
+    return codeSectionPresent;
+}
+
+int loadTitleLocaleConfig(__attribute__((unused)) u64 progId, u8 *regionId, u8 *languageId)
+{
+    *regionId = localeRegion;
+    *languageId = localeLanguage;
+
+    return 0;
+}
+
+//The SD side of codecache.c: the stored keys, by title
+#define MAX_FILES 256
+
+static struct
+{
+    u64 progId;
+    codeCacheKey key;
+    bool present;
+} files[MAX_FILES];
+
+static int failures;
+
+static void expect(bool condition, const char *what)
+{
+    if(!condition)
+    {
+        printf("FAILED: %s\n", what);
+        failures++;
+    }
+}
+
+static int findFile(u64 progId)
+{
+    for(int i = 0; i < MAX_FILES; i++)
+        if(files[i].present && files[i].progId == progId) return i;
+
+    return -1;
+}
+
+static void deleteFile(u64 progId)
+{
+    int i = findFile(progId);
+    if(i >= 0) files[i].present = false;
+}
+
+static bool load(const codeCacheKey *key)
+{
+    int file = findFile(key->progId);
+    bool hit = file >= 0 && memcmp(&files[file].key, key, sizeof(codeCacheKey)) == 0;
+
+    if(hit)
+    {
+        int i = findCodeCacheEntry(&cacheIndex, key->progId);
+        if(i >= 0) cacheIndex.entries[i].lastUse = ++cacheIndex.useCounter;
+    }
+
+    return hit;
+}
+
+static void save(const codeCacheKey *key, u32 fileSize)
+{
+    if(fileSize > CODE_CACHE_MAX_SIZE) return;
+
+    int i = findCodeCacheEntry(&cacheIndex, key->progId);
+    if(i >= 0) removeCodeCacheEntry(&cacheIndex, i);
+    deleteFile(key->progId);
+
+    u64 evicted;
+    while(evictCodeCacheEntry(&cacheIndex, fileSize, &evicted)) deleteFile(evicted);
+
+    for(int file = 0; file < MAX_FILES; file++)
+        if(!files[file].present)
+        {
+            files[file].present = true;
+            files[file].progId = key->progId;
+            files[file].key = *key;
+            break;
+        }
+
+    codeCacheEntry *entry = &cacheIndex.entries[cacheIndex.count++];
+    entry->progId = key->progId;
+    entry->fileSize = fileSize;
+    entry->lastUse = ++cacheIndex.useCounter;
+}
+
+//Launches a title like load_code: returns whether the cache was hit
+static bool launch(u64 progId, const u8 *exheader, u32 codeFileSize, u32 imageSize)
+{
+    codeCacheKey key;
+
+    if(!makeCodeCacheKey(&key, progId, exheader, 0x400, codeFileSize)) return false;
+    if(load(&key)) return true;
+
+    save(&key, imageSize);
+    return false;
+}
+
+static u32 cacheSize(void)
+{
+    u32 total = 0;
+    for(u32 i = 0; i < cacheIndex.count; i++) total += cacheIndex.entries[i].fileSize;
+
+    return total;
+}
+
+static void checkKeys(void)
+{
+    static u8 exheader[0x400];
+    const u64 game = 0x0004000000055D00LL,
+              mset = 0x0004001000022000LL,
+              nim = 0x0004013000002C02LL,
+              ns = 0x0004013000008002LL;
+
+    info.commitHash = 0x1234567;
+    info.config = 0;
+
+    expect(!launch(game, exheader, 0x300000, 0x600000), "first launch is a miss");
+    expect(launch(game, exheader, 0x300000, 0x600000), "second launch is a hit");
+
+    //Title update: new exheader and code
+    exheader[0x0E] = 1;
+    expect(!launch(game, exheader, 0x300000, 0x600000), "a changed exheader misses");
+    expect(launch(game, exheader, 0x300000, 0x600000), "the updated title hits again");
+    expect(!launch(game, exheader, 0x300004, 0x600000), "a changed .code size misses");
+
+    //Language emulation only matters with the option on
+    localeRegion = 2;
+    localeLanguage = 4;
+    expect(launch(game, exheader, 0x300004, 0x600000), "locales are ignored with the option off");
+    info.config |= 1 << (3 + 16);
+    expect(!launch(game, exheader, 0x300004, 0x600000), "enabling the option misses");
+    expect(launch(game, exheader, 0x300004, 0x600000), "and hits after that");
+    localeLanguage = 1;
+    expect(!launch(game, exheader, 0x300004, 0x600000), "a changed locale misses");
+
+    //Replacement code sections are read every time
+    codeSectionPresent = true;
+    expect(!launch(game, exheader, 0x300004, 0x600000) && !launch(game, exheader, 0x300004, 0x600000), "titles with a code section are never cached");
+    codeSectionPresent = false;
+
+    //MSET depends on the NAND shown only with its option on
+    expect(!launch(mset, exheader, 0x100000, 0x200000), "MSET first launch misses");
+    info.config |= 1;
+    expect(launch(mset, exheader, 0x100000, 0x200000), "MSET ignores the NAND with the option off");
+    info.config |= 1 << (4 + 16);
+    expect(!launch(mset, exheader, 0x100000, 0x200000), "MSET misses with the option on");
+    info.config = (info.config & ~3u) | 2;
+    expect(!launch(mset, exheader, 0x100000, 0x200000), "MSET misses on another NAND");
+
+    //NIM and NS only depend on their own settings
+    expect(!launch(nim, exheader, 0x80000, 0x100000) && launch(nim, exheader, 0x80000, 0x100000), "NIM is cached");
+    info.config |= 1 << 8 | 1 << 9;
+    expect(launch(nim, exheader, 0x80000, 0x100000), "NIM ignores the N3DS CPU setting");
+    expect(!launch(ns, exheader, 0x80000, 0x100000) && launch(ns, exheader, 0x80000, 0x100000), "NS is cached");
+    info.config &= ~(1u << 8);
+    expect(!launch(ns, exheader, 0x80000, 0x100000), "NS misses with another N3DS CPU setting");
+
+    //A new Luma3DS build invalidates everything
+    info.commitHash++;
+    expect(!launch(nim, exheader, 0x80000, 0x100000), "a new build misses");
+}
+
+static void checkEviction(void)
+{
+    static u8 exheader[0x400];
+    const u32 imageSize = 6 << 20;
+
+    for(int i = 0; i < MAX_FILES; i++) files[i].present = false;
+    cacheIndex.count = 0;
+    cacheIndex.useCounter = 0;
+    info.config = 0;
+
+    //Eight 6MB titles fit in 48MB, a ninth drops the least recently launched one
+    for(u64 i = 0; i < 8; i++) launch(0x0004000000010000LL + (i << 8), exheader, 0x300000, imageSize - 0x100);
+
+    expect(cacheIndex.count == 8, "eight titles fit");
+    expect(launch(0x0004000000010000LL, exheader, 0x300000, imageSize - 0x100), "the first title is still there");
+
+    launch(0x0004000000020000LL, exheader, 0x300000, imageSize - 0x100);
+    expect(cacheIndex.count == 8 && cacheSize() <= CODE_CACHE_MAX_SIZE, "the cache stays within its size");
+    expect(findFile(0x0004000000010100LL) < 0 && findCodeCacheEntry(&cacheIndex, 0x0004000000010100LL) < 0, "the least recently launched title went");
+    expect(launch(0x0004000000010000LL, exheader, 0x300000, imageSize - 0x100), "the recently launched one stayed");
+
+    //Images bigger than the whole cache are never stored
+    expect(!launch(0x0004000000030000LL, exheader, 0x300000, CODE_CACHE_MAX_SIZE + 1) &&
+           findFile(0x0004000000030000LL) < 0, "huge images aren't cached");
+
+    //Many small titles run into the entry limit instead
+    for(u64 i = 0; i < 100; i++) launch(0x0004000000040000LL + (i << 8), exheader, 0x1000, 0x2000);
+
+    expect(cacheIndex.count == CODE_CACHE_MAX_ENTRIES, "the entry limit holds");
+
+    u32 stored = 0;
+    for(int i = 0; i < MAX_FILES; i++) stored += files[i].present;
+    expect(stored == cacheIndex.count, "every file is in the index");
+
+    char path[CODE_CACHE_PATH_SIZE];
+    getCodeCachePath(path, 0x0004000000055D00LL);
+    expect(memcmp(path, "/luma/cache/code/0004000000055D00.bin", sizeof(path)) == 0, "entry paths");
+}
+
+int main(void)
+{
+    checkKeys();
+    checkEviction();
+
+    if(failures) return 1;
+
+    printf("All code cache checks passed\n");
+
+    return 0;
+}
@@ -0,0 +1,213 @@
+/*
+*   Host test of the software crypto backend (source/swcrypto.c), with crypto.c built
+*   for crypto_backend=software.
+*   The AES-128 ECB/CBC/CTR known answers are the FIPS-197 and SP 800-38A ones, the SHA-256
+*   ones are from FIPS 180-2 and go through crypto.c's sha256(). The throughput runs use the
+*   call sites the boot path does: decryptExeFsRange for CTR, sha256() for the hashes and
+*   the functions aes() forwards ECB and CBC to
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "hostdisk.h"
+#include "../source/crypto.h"
+#include "../source/swcrypto.h"
+
+#define BENCH_SIZE  0x400000
+#define BENCH_TIME  0.2
+
+bool isN3DS,
+     isDevUnit;
+FirmwareSource firmSource;
+
+u32 emuNandSector(u32 sector)
+{
+    return sector;
+}
+
+static const u8 fipsKey[0x10] = {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F},
+                fipsPlain[0x10] = {0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF},
+                fipsCipher[0x10] = {0x69, 0xC4, 0xE0, 0xD8, 0x6A, 0x7B, 0x04, 0x30, 0xD8, 0xCD, 0xB7, 0x80, 0x70, 0xB4, 0xC5, 0x5A};
+
+//SP 800-38A F.1.1, F.2.1 and F.5.1
+static const u8 spKey[0x10] = {0x2B, 0x7E, 0x15, 0x16, 0x28, 0xAE, 0xD2, 0xA6, 0xAB, 0xF7, 0x15, 0x88, 0x09, 0xCF, 0x4F, 0x3C},
+                spCbcIv[0x10] = {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F},
+                spCtr[0x10] = {0xF0, 0xF1, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8, 0xF9, 0xFA, 0xFB, 0xFC, 0xFD, 0xFE, 0xFF},
+                spPlain[0x40] = {
+    0x6B, 0xC1, 0xBE, 0xE2, 0x2E, 0x40, 0x9F, 0x96, 0xE9, 0x3D, 0x7E, 0x11, 0x73, 0x93, 0x17, 0x2A,
+    0xAE, 0x2D, 0x8A, 0x57, 0x1E, 0x03, 0xAC, 0x9C, 0x9E, 0xB7, 0x6F, 0xAC, 0x45, 0xAF, 0x8E, 0x51,
+    0x30, 0xC8, 0x1C, 0x46, 0xA3, 0x5C, 0xE4, 0x11, 0xE5, 0xFB, 0xC1, 0x19, 0x1A, 0x0A, 0x52, 0xEF,
+    0xF6, 0x9F, 0x24, 0x45, 0xDF, 0x4F, 0x9B, 0x17, 0xAD, 0x2B, 0x41, 0x7B, 0xE6, 0x6C, 0x37, 0x10
+},
+                spEcb[0x40] = {
+    0x3A, 0xD7, 0x7B, 0xB4, 0x0D, 0x7A, 0x36, 0x60, 0xA8, 0x9E, 0xCA, 0xF3, 0x24, 0x66, 0xEF, 0x97,
+    0xF5, 0xD3, 0xD5, 0x85, 0x03, 0xB9, 0x69, 0x9D, 0xE7, 0x85, 0x89, 0x5A, 0x96, 0xFD, 0xBA, 0xAF,
+    0x43, 0xB1, 0xCD, 0x7F, 0x59, 0x8E, 0xCE, 0x23, 0x88, 0x1B, 0x00, 0xE3, 0xED, 0x03, 0x06, 0x88,
+    0x7B, 0x0C, 0x78, 0x5E, 0x27, 0xE8, 0xAD, 0x3F, 0x82, 0x23, 0x20, 0x71, 0x04, 0x72, 0x5D, 0xD4
+},
+                spCbc[0x40] = {
+    0x76, 0x49, 0xAB, 0xAC, 0x81, 0x19, 0xB2, 0x46, 0xCE, 0xE9, 0x8E, 0x9B, 0x12, 0xE9, 0x19, 0x7D,
+    0x50, 0x86, 0xCB, 0x9B, 0x50, 0x72, 0x19, 0xEE, 0x95, 0xDB, 0x11, 0x3A, 0x91, 0x76, 0x78, 0xB2,
+    0x73, 0xBE, 0xD6, 0xB8, 0xE3, 0xC1, 0x74, 0x3B, 0x71, 0x16, 0xE6, 0x9E, 0x22, 0x22, 0x95, 0x16,
+    0x3F, 0xF1, 0xCA, 0xA1, 0x68, 0x1F, 0xAC, 0x09, 0x12, 0x0E, 0xCA, 0x30, 0x75, 0x86, 0xE1, 0xA7
+},
+                spCtrCipher[0x40] = {
+    0x87, 0x4D, 0x61, 0x91, 0xB6, 0x20, 0xE3, 0x26, 0x1B, 0xEF, 0x68, 0x64, 0x99, 0x0D, 0xB6, 0xCE,
+    0x98, 0x06, 0xF6, 0x6B, 0x79, 0x70, 0xFD, 0xFF, 0x86, 0x17, 0x18, 0x7B, 0xB9, 0xFF, 0xFD, 0xFF,
+    0x5A, 0xE4, 0xDF, 0x3E, 0xDB, 0xD5, 0xD3, 0x5E, 0x5B, 0x4F, 0x09, 0x02, 0x0D, 0xB0, 0x3E, 0xAB,
+    0x1E, 0x03, 0x1D, 0xDA, 0x2F, 0xBE, 0x03, 0xD1, 0x79, 0x21, 0x70, 0xA0, 0xF3, 0x00, 0x9C, 0xEE
+};
+
+static const struct
+{
+    const char *name;
+    const char *message;
+    u32 repeat;
+    u8 digest[0x20];
+} shaVectors[] = {
+    {"empty", "", 1, {0xE3, 0xB0, 0xC4, 0x42, 0x98, 0xFC, 0x1C, 0x14, 0x9A, 0xFB, 0xF4, 0xC8, 0x99, 0x6F, 0xB9, 0x24,
+                      0x27, 0xAE, 0x41, 0xE4, 0x64, 0x9B, 0x93, 0x4C, 0xA4, 0x95, 0x99, 0x1B, 0x78, 0x52, 0xB8, 0x55}},
+    {"abc", "abc", 1, {0xBA, 0x78, 0x16, 0xBF, 0x8F, 0x01, 0xCF, 0xEA, 0x41, 0x41, 0x40, 0xDE, 0x5D, 0xAE, 0x22, 0x23,
+                       0xB0, 0x03, 0x61, 0xA3, 0x96, 0x17, 0x7A, 0x9C, 0xB4, 0x10, 0xFF, 0x61, 0xF2, 0x00, 0x15, 0xAD}},
+    {"448 bits", "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", 1,
+                     {0x24, 0x8D, 0x6A, 0x61, 0xD2, 0x06, 0x38, 0xB8, 0xE5, 0xC0, 0x26, 0x93, 0x0C, 0x3E, 0x60, 0x39,
+                      0xA3, 0x3C, 0xE4, 0x59, 0x64, 0xFF, 0x21, 0x67, 0xF6, 0xEC, 0xED, 0xD4, 0x19, 0xDB, 0x06, 0xC1}},
+    {"million a", "a", 1000000,
+                     {0xCD, 0xC7, 0x6E, 0x5C, 0x99, 0x14, 0xFB, 0x92, 0x81, 0xA1, 0xC7, 0xE2, 0x84, 0xD7, 0x3E, 0x67,
+                      0xF1, 0x80, 0x9A, 0x48, 0xA4, 0x97, 0x20, 0x0E, 0x04, 0x6D, 0x39, 0xCC, 0xC7, 0x11, 0x2C, 0xD0}}
+};
+
+static int failures;
+
+static void check(const char *name, const void *result, const void *expected, u32 size)
+{
+    bool passed = memcmp(result, expected, size) == 0;
+
+    printf("%-28s %s\n", name, passed ? "ok" : "FAILED");
+    if(!passed) failures++;
+}
+
+static void testAes(void)
+{
+    u8 out[0x40],
+       iv[0x10];
+
+    swAesSetKey(0x30, fipsKey, AES_KEYNORMAL);
+    swAesUseKeyslot(0x30);
+    swAes(out, fipsPlain, 1, NULL, AES_ECB_ENCRYPT_MODE);
+    check("FIPS-197 encrypt", out, fipsCipher, 0x10);
+    swAes(out, fipsCipher, 1, NULL, AES_ECB_DECRYPT_MODE);
+    check("FIPS-197 decrypt", out, fipsPlain, 0x10);
+
+    swAesSetKey(0x31, spKey, AES_KEYNORMAL);
+    swAesUseKeyslot(0x31);
+    swAes(out, spPlain, 4, NULL, AES_ECB_ENCRYPT_MODE);
+    check("ECB encrypt", out, spEcb, 0x40);
+    swAes(out, spEcb, 4, NULL, AES_ECB_DECRYPT_MODE);
+    check("ECB decrypt", out, spPlain, 0x40);
+
+    //Chained calls have to pick up where the last one left the IV, like on the AES engine
+    memcpy(iv, spCbcIv, 0x10);
+    swAes(out, spPlain, 1, iv, AES_CBC_ENCRYPT_MODE);
+    swAes(out + 0x10, spPlain + 0x10, 3, iv, AES_CBC_ENCRYPT_MODE);
+    check("CBC encrypt", out, spCbc, 0x40);
+    memcpy(iv, spCbcIv, 0x10);
+    swAes(out, spCbc, 3, iv, AES_CBC_DECRYPT_MODE);
+    swAes(out + 0x30, spCbc + 0x30, 1, iv, AES_CBC_DECRYPT_MODE);
+    check("CBC decrypt", out, spPlain, 0x40);
+
+    //The counter's low bytes are all 0xFF, so every increment carries
+    memcpy(iv, spCtr, 0x10);
+    swAes(out, spPlain, 2, iv, AES_CTR_MODE);
+    swAes(out + 0x20, spPlain + 0x20, 2, iv, AES_CTR_MODE);
+    check("CTR", out, spCtrCipher, 0x40);
+
+    //Keyslots are independent
+    swAesUseKeyslot(0x30);
+    swAes(out, fipsPlain, 1, NULL, AES_ECB_ENCRYPT_MODE);
+    check("keyslot switch", out, fipsCipher, 0x10);
+}
+
+static void testSha(void)
+{
+    for(u32 i = 0; i < sizeof(shaVectors) / sizeof(shaVectors[0]); i++)
+    {
+        u32 length = strlen(shaVectors[i].message),
+            size = length * shaVectors[i].repeat;
+        u8 *message = malloc(size + 1),
+           digest[0x20];
+
+        for(u32 j = 0; j < shaVectors[i].repeat; j++)
+            memcpy(message + j * length, shaVectors[i].message, length);
+
+        sha256(digest, message, size);
+
+        char name[32];
+        snprintf(name, sizeof(name), "SHA-256 %s", shaVectors[i].name);
+        check(name, digest, shaVectors[i].digest, 0x20);
+        free(message);
+    }
+}
+
+static double rate(double bytes, double seconds)
+{
+    return bytes / seconds / (1024 * 1024);
+}
+
+static void benchmark(void)
+{
+    //An NCCH header, then the ExeFS header and the "FIRM" decryptExeFsRange runs through
+    u8 *ncch = calloc(0x400 + BENCH_SIZE, 1),
+       *buffer = malloc(BENCH_SIZE),
+       digest[0x20],
+       iv[0x10] = {0};
+    double start, elapsed;
+    u32 runs;
+
+    *(u32 *)(ncch + 0x1A0) = 1;
+    initExeFsDecryption(ncch);
+
+    for(start = now(), runs = 0; (elapsed = now() - start) < BENCH_TIME || runs == 0; runs++)
+        decryptExeFsRange(buffer, 0, BENCH_SIZE);
+    printf("AES-CTR decryptExeFsRange   %7.1f MB/s\n", rate((double)BENCH_SIZE * runs, elapsed));
+
+    swAesUseKeyslot(0x31);
+    for(start = now(), runs = 0; (elapsed = now() - start) < BENCH_TIME || runs == 0; runs++)
+        swAes(buffer, buffer, BENCH_SIZE / AES_BLOCK_SIZE, NULL, AES_ECB_ENCRYPT_MODE);
+    printf("AES-ECB encrypt             %7.1f MB/s\n", rate((double)BENCH_SIZE * runs, elapsed));
+
+    for(start = now(), runs = 0; (elapsed = now() - start) < BENCH_TIME || runs == 0; runs++)
+        swAes(buffer, buffer, BENCH_SIZE / AES_BLOCK_SIZE, NULL, AES_ECB_DECRYPT_MODE);
+    printf("AES-ECB decrypt             %7.1f MB/s\n", rate((double)BENCH_SIZE * runs, elapsed));
+
+    for(start = now(), runs = 0; (elapsed = now() - start) < BENCH_TIME || runs == 0; runs++)
+        swAes(buffer, buffer, BENCH_SIZE / AES_BLOCK_SIZE, iv, AES_CBC_ENCRYPT_MODE);
+    printf("AES-CBC encrypt             %7.1f MB/s\n", rate((double)BENCH_SIZE * runs, elapsed));
+
+    for(start = now(), runs = 0; (elapsed = now() - start) < BENCH_TIME || runs == 0; runs++)
+        swAes(buffer, buffer, BENCH_SIZE / AES_BLOCK_SIZE, iv, AES_CBC_DECRYPT_MODE);
+    printf("AES-CBC decrypt             %7.1f MB/s\n", rate((double)BENCH_SIZE * runs, elapsed));
+
+    for(start = now(), runs = 0; (elapsed = now() - start) < BENCH_TIME || runs == 0; runs++)
+        sha256(digest, buffer, BENCH_SIZE);
+    printf("SHA-256 sha256              %7.1f MB/s\n", rate((double)BENCH_SIZE * runs, elapsed));
+
+    free(ncch);
+    free(buffer);
+}
+
+int main(void)
+{
+    testAes();
+    testSha();
+
+    if(failures)
+    {
+        printf("%d known answer tests failed\n", failures);
+        return 1;
+    }
+
+    benchmark();
+
+    return 0;
+}
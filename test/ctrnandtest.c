@@ -0,0 +1,211 @@
+/*
+*   Host test of the CTRNAND read pipeline, ctrNandRead in source/crypto.c, with the
+*   software AES (swcrypto.c) standing in for the AES engine.
+*   A synthetic NAND image is encrypted with AES-CTR the way the console's is, with the
+*   counter derived from the CID and the keyslot ctrNandInit picks, then read back through
+*   ctrNandRead at sizes around the pipeline's chunks, on SysNAND and on an emuNAND in the SD.
+*   The CID is picked so that the counter's low word wraps inside the image, which checks
+*   the counter advance between chunks carries
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "hostdisk.h"
+#include "../source/crypto.h"
+#include "../source/swcrypto.h"
+
+//Where the CTRNAND FAT partition starts, as in ctrNandInit
+#define O3DS_FAT_START  0x5CAE5
+#define N3DS_FAT_START  0x5CAD7
+
+//Sectors of the partition that get encrypted and read back
+#define TEST_SECTORS    0x1000
+#define GUARD_SECTORS   2
+
+//Where the emuNAND is in the SD
+#define EMUNAND_OFFSET  0x100
+
+//The keyslot the expected ciphertext is made with, loaded with the same keys
+#define REFERENCE_SLOT  0x3E
+
+bool isN3DS,
+     isDevUnit;
+FirmwareSource firmSource;
+
+u32 emuNandSector(u32 sector)
+{
+    return sector + EMUNAND_OFFSET;
+}
+
+static const u8 keyX0x5[0x10] = {0x13, 0x57, 0x9B, 0xDF, 0x02, 0x46, 0x8A, 0xCE, 0xF1, 0xE2, 0xD3, 0xC4, 0xB5, 0xA6, 0x97, 0x88},
+                keyY0x5[0x10] = {0x4D, 0x80, 0x4F, 0x4E, 0x99, 0x90, 0x19, 0x46, 0x13, 0xA2, 0x04, 0xAC, 0x58, 0x44, 0x60, 0xBE},
+                normalKey0x4[0x10] = {0xA0, 0xB1, 0xC2, 0xD3, 0xE4, 0xF5, 0x06, 0x17, 0x28, 0x39, 0x4A, 0x5B, 0x6C, 0x7D, 0x8E, 0x9F};
+
+static u32 seed = 1;
+
+static u32 nextRandom(void)
+{
+    seed = seed * 1103515245 + 12345;
+    return seed >> 8;
+}
+
+//Adds to a big endian 128-bit counter, byte by byte
+static void addCounter(u8 *ctr, u32 value)
+{
+    u32 carry = value;
+
+    for(int i = 0xF; i >= 0 && carry; i--)
+    {
+        carry += ctr[i];
+        ctr[i] = (u8)carry;
+        carry >>= 8;
+    }
+}
+
+static u32 lowWord(const u8 *ctr)
+{
+    return ((u32)ctr[0xC] << 24) | ((u32)ctr[0xD] << 16) | ((u32)ctr[0xE] << 8) | ctr[0xF];
+}
+
+/* Picks a CID whose counter's low word wraps in the middle of the test sectors,
+   and returns the first test sector past the wrap */
+static u32 pickCid(u32 fatStart)
+{
+    u8 shaSum[0x20];
+
+    for(;;)
+    {
+        for(u32 i = 0; i < 0x10; i += 4)
+        {
+            u32 r = nextRandom();
+            memcpy(nandCid + i, &r, 4);
+        }
+
+        swSha256(shaSum, nandCid, 0x10);
+
+        //AES blocks from the first test sector to the wrap
+        u32 toWrap = -(lowWord(shaSum) + fatStart * 0x20);
+
+        if(toWrap >= 0x80 * 0x20 && toWrap < (TEST_SECTORS - 0x80) * 0x20) return toWrap / 0x20;
+    }
+}
+
+//Fills the test sectors with random data and puts their encrypted version in the image
+static void buildImage(u8 *plain, u32 fatStart)
+{
+    u8 ctr[0x20];
+
+    createDisk(&nandDisk, fatStart + TEST_SECTORS);
+    for(u32 i = 0; i < TEST_SECTORS * 0x200; i++) plain[i] = (u8)nextRandom();
+
+    swSha256(ctr, nandCid, 0x10);
+    addCounter(ctr, fatStart * 0x20);
+    swAesUseKeyslot(REFERENCE_SLOT);
+    swAes(nandDisk.image + fatStart * 0x200, plain, TEST_SECTORS * 0x20, ctr, AES_CTR_MODE);
+
+    //The same NAND as an emuNAND
+    createDisk(&sdDisk, EMUNAND_OFFSET + fatStart + TEST_SECTORS);
+    memcpy(sdDisk.image + (EMUNAND_OFFSET + fatStart) * 0x200, nandDisk.image + fatStart * 0x200, TEST_SECTORS * 0x200);
+}
+
+static int readTest(const u8 *plain, u32 sector, u32 count)
+{
+    static u8 buffer[(TEST_SECTORS + 2 * GUARD_SECTORS) * 0x200];
+    hostDisk *disk = firmSource == FIRMWARE_SYSNAND ? &nandDisk : &sdDisk;
+    u8 *out = buffer + GUARD_SECTORS * 0x200;
+
+    memset(buffer, 0xA5, sizeof(buffer));
+    resetDiskCounters(disk);
+
+    u32 result = ctrNandRead(sector, count, out);
+
+    //One command per chunk of 0x40 sectors
+    u32 expectedCommands = (count + 0x3F) / 0x40;
+    bool guardsIntact = true;
+
+    for(u32 i = 0; i < GUARD_SECTORS * 0x200; i++)
+        if(buffer[i] != 0xA5 || out[count * 0x200 + i] != 0xA5) guardsIntact = false;
+
+    if(result != 0 || memcmp(out, plain + sector * 0x200, count * 0x200) != 0 || !guardsIntact ||
+       disk->commands != expectedCommands || disk->sectorsRead != count)
+    {
+        printf("%s %s: reading %u sectors at 0x%X failed (result %u, %u commands, %u sectors read%s)\n", isN3DS ? "N3DS" : "O3DS",
+               firmSource == FIRMWARE_SYSNAND ? "SysNAND" : "emuNAND", count, sector, result, disk->commands, disk->sectorsRead,
+               guardsIntact ? "" : ", guard bytes overwritten");
+        return 1;
+    }
+
+    return 0;
+}
+
+static int testConsole(bool n3ds, u8 *plain)
+{
+    u32 fatStart = n3ds ? N3DS_FAT_START : O3DS_FAT_START;
+
+    //The keys the bootROM would have set
+    isN3DS = n3ds;
+    if(n3ds)
+    {
+        swAesSetKey(0x05, keyX0x5, AES_KEYX);
+        swAesSetKey(REFERENCE_SLOT, keyX0x5, AES_KEYX);
+        swAesSetKey(REFERENCE_SLOT, keyY0x5, AES_KEYY);
+    }
+    else
+    {
+        swAesSetKey(0x04, normalKey0x4, AES_KEYNORMAL);
+        swAesSetKey(REFERENCE_SLOT, normalKey0x4, AES_KEYNORMAL);
+    }
+
+    u32 wrap = pickCid(fatStart);
+    buildImage(plain, fatStart);
+    ctrNandInit();
+
+    const u32 reads[][2] = {
+        {0, 1}, {0, 0x3F}, {0, 0x40}, {0, 0x41}, {0x123, 0x107},
+        {wrap - 1, 2}, {wrap - 0x20, 0x40}, {wrap - 0x41, 0x83}, {wrap, 1},
+        {TEST_SECTORS - 0x81, 0x81}, {0, TEST_SECTORS}
+    };
+    int failed = 0;
+
+    for(firmSource = FIRMWARE_SYSNAND; firmSource <= FIRMWARE_EMUNAND; firmSource++)
+        for(u32 i = 0; i < sizeof(reads) / sizeof(reads[0]); i++)
+            failed |= readTest(plain, reads[i][0], reads[i][1]);
+
+    //Errors from the driver get through
+    firmSource = FIRMWARE_SYSNAND;
+    static u8 overrun[0x80 * 0x200];
+    if(ctrNandRead(TEST_SECTORS - 0x40, 0x80, overrun) == 0)
+    {
+        printf("%s: reading past the end of the NAND didn't fail\n", n3ds ? "N3DS" : "O3DS");
+        failed = 1;
+    }
+
+    return failed;
+}
+
+static void benchmark(const u8 *plain)
+{
+    static u8 buffer[TEST_SECTORS * 0x200];
+    double start = now(),
+           elapsed;
+    u32 runs;
+
+    for(runs = 0; (elapsed = now() - start) < 0.2 || runs == 0; runs++)
+        ctrNandRead(0, TEST_SECTORS, buffer);
+
+    printf("ctrNandRead: %.1f MB/s with the software AES%s\n", (double)TEST_SECTORS * 0x200 * runs / elapsed / (1024 * 1024),
+           memcmp(buffer, plain, sizeof(buffer)) == 0 ? "" : " (wrong data)");
+}
+
+int main(void)
+{
+    static u8 plain[TEST_SECTORS * 0x200];
+    int failed = testConsole(false, plain) | testConsole(true, plain);
+
+    if(failed) return 1;
+
+    printf("ctrNandRead: O3DS and N3DS CTRNAND reads decrypt correctly on SysNAND and emuNAND, across counter carries\n");
+    benchmark(plain);
+
+    return 0;
+}
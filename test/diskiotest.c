@@ -0,0 +1,305 @@
+/*
+*   Host test of the sector cache in source/fatfs/diskio.c.
+*   FatFs and diskio.c are built as is, on top of image-backed drivers (hostdisk.c).
+*   A boot-like sequence of FatFs calls is run on generated SD and CTRNAND images and the
+*   sector reads FatFs makes are recorded, then the trace is replayed against disk_read
+*   and the device commands it takes are compared to one per request, which is what
+*   disk_read cost before the cache.
+*   diskiotest <SD image> <CTRNAND image> <trace> replays a trace on existing images instead
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "hostdisk.h"
+#include "../source/crypto.h"
+#include "../source/fs.h"
+#include "../source/fatfs/ff.h"
+#include "../source/fatfs/diskio.h"
+#include "../source/fatfs/sdmmc/sdmmc.h"
+
+#define SD_SECTORS   80000
+#define NAND_SECTORS 72000
+
+//diskio.c keeps the cache data in FCRAM
+#define CACHE_AREA   0x27E00000
+
+//Plain reads, the decryption is tested by ctrnandtest
+u32 ctrNandRead(u32 sector, u32 sectorCount, u8 *outbuf)
+{
+    return sdmmc_nand_readsectors(sector, sectorCount, outbuf);
+}
+
+void ctrNandInit(void)
+{
+}
+
+static void writeFile(const char *path, u32 size, u32 seed)
+{
+    static u8 buffer[0x10000];
+    FIL file;
+    UINT written;
+
+    if(f_open(&file, path, FA_WRITE | FA_CREATE_ALWAYS) != FR_OK)
+    {
+        printf("Can't create %s\n", path);
+        exit(1);
+    }
+
+    while(size)
+    {
+        u32 chunk = size < sizeof(buffer) ? size : sizeof(buffer);
+
+        for(u32 i = 0; i < chunk; i++)
+        {
+            seed = seed * 1103515245 + 12345;
+            buffer[i] = (u8)(seed >> 16);
+        }
+        f_write(&file, buffer, chunk, &written);
+        size -= chunk;
+    }
+
+    f_close(&file);
+}
+
+static void makeDirectories(const char *parent, const char *format, u32 count)
+{
+    char path[128];
+
+    for(u32 i = 0; i < count; i++)
+    {
+        int length = snprintf(path, sizeof(path), "%s/", parent);
+        snprintf(path + length, sizeof(path) - length, format, i);
+        f_mkdir(path);
+    }
+}
+
+//Builds the images through FatFs itself, as drive 0
+static void buildImages(void)
+{
+    FATFS fs;
+    char path[128];
+    hostDisk sd;
+
+    createDisk(&nandDisk, NAND_SECTORS);
+    formatFat32(&nandDisk, 1);
+    createDisk(&sdDisk, SD_SECTORS);
+    formatFat32(&sdDisk, 1);
+
+    //The CTRNAND first, FatFs only writes to the SD
+    sd = sdDisk;
+    sdDisk = nandDisk;
+
+    f_mount(&fs, "0:", 1);
+    f_mkdir("/title");
+    f_mkdir("/title/00040130");
+    makeDirectories("/title/00040130", "000%05X", 48);
+    f_mkdir("/title/00040138");
+    makeDirectories("/title/00040138", "%08X", 4);
+    f_mkdir("/title/00040138/00000002/content");
+    for(u32 i = 0; i < 4; i++)
+    {
+        snprintf(path, sizeof(path), "/title/00040138/0000000%u/content", i);
+        f_mkdir(path);
+        snprintf(path, sizeof(path), "/title/00040138/0000000%u/content/00000000.tmd", i);
+        writeFile(path, 0xB34, i);
+    }
+    writeFile("/title/00040138/00000002/content/00000049.app", 0xF0000, 2);
+    f_mkdir("/data");
+    f_mkdir("/dbs");
+    writeFile("/dbs/title.db", 0x31E400, 3);
+    f_mount(NULL, "0:", 1);
+
+    nandDisk = sdDisk;
+    sdDisk = sd;
+    disk_initialize(0);
+
+    f_mount(&fs, "0:", 1);
+    f_mkdir("/Nintendo 3DS");
+    makeDirectories("/Nintendo 3DS", "%032X", 2);
+    f_mkdir("/3ds");
+    for(u32 i = 0; i < 40; i++)
+    {
+        snprintf(path, sizeof(path), "/3ds/Some homebrew application number %u.3dsx", i);
+        writeFile(path, 0x8000 + i * 0x100, i);
+    }
+    f_mkdir("/luma");
+    writeFile("/luma/config.bin", 0x10, 4);
+    writeFile("/luma/splash.bin", 0x46500, 5);
+    writeFile("/luma/splashbottom.bin", 0x38400, 6);
+    f_mkdir("/luma/payloads");
+    makeDirectories("/luma/payloads", "unused%u", 3);
+    for(u32 i = 0; i < 12; i++)
+    {
+        static const char *buttons[] = {"a", "b", "x", "y", "up", "down", "left", "right", "start", "select", "r", "l"};
+        snprintf(path, sizeof(path), "/luma/payloads/%s_payload%u.bin", buttons[i], i);
+        writeFile(path, 0x20000, 7 + i);
+    }
+    f_mount(NULL, "0:", 1);
+}
+
+//Like fileRead, reads file data a whole fragment at a time
+static void readWholeFile(const char *path)
+{
+    static u8 buffer[0x400000];
+    FIL file;
+    UINT read;
+
+    if(f_open(&file, path, FA_READ) == FR_OK)
+    {
+        DWORD clmt[CLMT_SIZE];
+        clmt[0] = CLMT_SIZE;
+        file.cltbl = clmt;
+
+        if(f_lseek(&file, CREATE_LINKMAP) != FR_OK) file.cltbl = NULL;
+
+        f_read(&file, buffer, sizeof(buffer), &read);
+        f_close(&file);
+    }
+}
+
+//What a boot goes through, see source/fs.c and source/config.c
+static void bootSequence(void)
+{
+    FATFS sdFs,
+          nandFs;
+    DIR dir;
+    FILINFO info;
+
+    //mountFs
+    f_mount(&sdFs, "0:", 1);
+    f_mount(&nandFs, "1:", 0);
+
+    //readConfig, then the splash
+    readWholeFile("/luma/config.bin");
+    readWholeFile("/luma/splash.bin");
+    readWholeFile("/luma/splashbottom.bin");
+
+    //loadPayload
+    if(f_findfirst(&dir, &info, "/luma/payloads", "up_*.bin") == FR_OK) f_closedir(&dir);
+
+    //firmRead, looking for the lowest content then reading it
+    if(f_opendir(&dir, "1:/title/00040138/00000002/content") == FR_OK)
+    {
+        while(f_readdir(&dir, &info) == FR_OK && info.fname[0]);
+        f_closedir(&dir);
+    }
+    readWholeFile("1:/title/00040138/00000002/content/00000049.app");
+
+    f_mount(NULL, "0:", 1);
+    f_mount(NULL, "1:", 1);
+}
+
+static int replay(void)
+{
+    static u8 buffer[0x8000 * 0x200];
+    u32 requests[2] = {0},
+        sectors[2] = {0};
+    DWORD hits,
+          misses,
+          previousHits,
+          previousMisses;
+    int failed = 0;
+
+    disk_initialize(0);
+    disk_initialize(1);
+    disk_getCacheStats(&previousHits, &previousMisses);
+    resetDiskCounters(&sdDisk);
+    resetDiskCounters(&nandDisk);
+
+    for(u32 i = 0; i < traceLength; i++)
+    {
+        const traceEntry *entry = &trace[i];
+        hostDisk *disk = entry->pdrv ? &nandDisk : &sdDisk;
+
+        if(entry->count > sizeof(buffer) / 0x200 || entry->sector + entry->count > disk->sectorCount) continue;
+
+        requests[entry->pdrv]++;
+        sectors[entry->pdrv] += entry->count;
+
+        if(disk_read(entry->pdrv, buffer, entry->sector, entry->count) != RES_OK ||
+           memcmp(buffer, disk->image + entry->sector * 0x200, entry->count * 0x200) != 0)
+        {
+            if(!failed) printf("Request %u (drive %u, %u sectors at %u) doesn't return the image's data\n",
+                               i, entry->pdrv, entry->count, entry->sector);
+            failed = 1;
+        }
+    }
+
+    disk_getCacheStats(&hits, &misses);
+
+    for(u32 i = 0; i < 2; i++)
+    {
+        const hostDisk *disk = i ? &nandDisk : &sdDisk;
+
+        printf("%s: %u FatFs reads of %u sectors, %u device commands for %u sectors (%.0f%% fewer commands)\n",
+               i ? "CTRNAND" : "SD", requests[i], sectors[i], disk->commands, disk->sectorsRead,
+               requests[i] ? 100.0 - 100.0 * disk->commands / requests[i] : 0);
+    }
+
+    printf("Cache: %lu hits, %lu misses\n", (unsigned long)(hits - previousHits), (unsigned long)(misses - previousMisses));
+
+    return failed;
+}
+
+//A write has to drop what the cache holds for its drive
+static int checkInvalidation(void)
+{
+    u8 sector[0x200],
+       data[0x200];
+
+    disk_read(0, sector, 100, 1);
+    for(u32 i = 0; i < 0x200; i++) data[i] = (u8)~sector[i];
+
+    disk_write(0, data, 100, 1);
+    disk_read(0, sector, 100, 1);
+
+    if(memcmp(sector, data, 0x200) != 0)
+    {
+        printf("disk_write didn't invalidate the cached sector\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    mapFixed(CACHE_AREA, 0x100000);
+
+    if(argc == 4)
+    {
+        loadDisk(&sdDisk, argv[1]);
+        loadDisk(&nandDisk, argv[2]);
+        loadTrace(argv[3]);
+
+        return replay();
+    }
+
+    //The images and the trace go through files like recorded ones would, next to the executable
+    char sdPath[256],
+         nandPath[256],
+         tracePath[256];
+    const char *slash = strrchr(argv[0], '/');
+    int dirLength = slash == NULL ? 0 : (int)(slash - argv[0] + 1);
+
+    snprintf(sdPath, sizeof(sdPath), "%.*ssd.img", dirLength, argv[0]);
+    snprintf(nandPath, sizeof(nandPath), "%.*sctrnand.img", dirLength, argv[0]);
+    snprintf(tracePath, sizeof(tracePath), "%.*sboot.trace", dirLength, argv[0]);
+
+    buildImages();
+    saveDisk(&sdDisk, sdPath);
+    saveDisk(&nandDisk, nandPath);
+
+    loadDisk(&sdDisk, sdPath);
+    loadDisk(&nandDisk, nandPath);
+    disk_initialize(0);
+
+    tracing = 1;
+    bootSequence();
+    tracing = 0;
+    saveTrace(tracePath);
+
+    loadTrace(tracePath);
+
+    return replay() | checkInvalidation();
+}
@@ -0,0 +1,242 @@
+/*
+*   Host test of source/firmcache.c, which is included to reach its header layout.
+*   A NATIVE_FIRM is saved to a FAT32 SD image and loaded back to the section load addresses,
+*   then cache files with a wrong key, a corrupt section, a tampered header and sections
+*   pointing outside section memory (with a matching header hash) are loaded. Those have to be
+*   rejected, and the tampered or out of range ones before anything is read to memory
+*/
+
+#include "../source/firmcache.c"
+
+#include <stdio.h>
+#include "hostdisk.h"
+#include "../source/fatfs/diskio.h"
+
+//diskio.c keeps the cache data in FCRAM
+#define CACHE_AREA      0x27E00000
+
+#define ARM9_MEM        0x08000000
+#define AXI_WRAM        0x1FF00000
+
+//Load addresses and sizes close to a N3DS NATIVE_FIRM's
+#define SECTION0_ADDR   0x1FF00000
+#define SECTION1_ADDR   0x1FF80000
+#define SECTION2_ADDR   0x08006800
+#define SECTION0_SIZE   0x30000
+#define SECTION1_SIZE   0x32000
+#define SECTION2_SIZE   0xC8000
+
+bool isN3DS = true,
+     isDevUnit;
+FirmwareSource firmSource;
+
+u32 emuNandSector(u32 sector)
+{
+    return sector;
+}
+
+void fileDelete(const char *path)
+{
+    f_unlink(path);
+}
+
+void createDirectory(const char *path)
+{
+    f_mkdir(path);
+}
+
+static const firmCacheKey testKey = {.commitHash = 0x12345678, .firmType = 0, .firmVersion = 0x52, .console = 1};
+
+static firmHeader testFirm;
+static u32 testSizes[4] = {SECTION0_SIZE, SECTION1_SIZE, SECTION2_SIZE, 0};
+static u8 sections[3][SECTION2_SIZE];
+
+static void fillSections(void)
+{
+    u32 seed = 1;
+
+    testFirm.magic = 0x4D524946;
+    testFirm.arm11Entry = (u8 *)(SECTION1_ADDR + 0x100);
+    testFirm.arm9Entry = (u8 *)(SECTION2_ADDR + 0x100);
+    testFirm.section[0].address = (u8 *)SECTION0_ADDR;
+    testFirm.section[1].address = (u8 *)SECTION1_ADDR;
+    testFirm.section[2].address = (u8 *)SECTION2_ADDR;
+
+    for(u32 i = 0; i < 3; i++)
+    {
+        for(u32 j = 0; j < testSizes[i]; j++)
+        {
+            seed = seed * 1103515245 + 12345;
+            sections[i][j] = (u8)(seed >> 16);
+        }
+
+        testFirm.section[i].size = testSizes[i];
+        memcpy(testFirm.section[i].address, sections[i], testSizes[i]);
+    }
+}
+
+//Section memory as it is before the FIRM is loaded
+static void clearMemory(void)
+{
+    memset32((void *)ARM9_MEM, 0xEEEEEEEE, 0x180000);
+    memset32((void *)AXI_WRAM, 0xEEEEEEEE, 0x100000);
+}
+
+static bool memoryUntouched(void)
+{
+    const u8 *arm9 = (const u8 *)ARM9_MEM,
+             *axi = (const u8 *)AXI_WRAM;
+
+    for(u32 i = 0; i < 0x180000; i++)
+        if(arm9[i] != 0xEE) return false;
+    for(u32 i = 0; i < 0x100000; i++)
+        if(axi[i] != 0xEE) return false;
+
+    return true;
+}
+
+static void readHeader(firmCacheHeader *header)
+{
+    FIL file;
+    unsigned int read;
+
+    f_open(&file, CACHE_PATH, FA_READ);
+    f_read(&file, header, sizeof(*header), &read);
+    f_close(&file);
+}
+
+static void writeHeader(const firmCacheHeader *header)
+{
+    FIL file;
+    unsigned int written;
+
+    f_open(&file, CACHE_PATH, FA_WRITE | FA_OPEN_EXISTING);
+    f_write(&file, header, sizeof(*header), &written);
+    f_close(&file);
+}
+
+static int expectRejected(const char *name, bool untouched)
+{
+    firmHeader firm;
+    u32 sizes[4];
+
+    clearMemory();
+
+    if(loadCachedFirm(&firm, &testKey, sizes))
+    {
+        printf("%s: the cache is loaded\n", name);
+        return 1;
+    }
+
+    if(untouched && !memoryUntouched())
+    {
+        printf("%s: section memory is written before the cache is rejected\n", name);
+        return 1;
+    }
+
+    printf("%-28s rejected\n", name);
+    return 0;
+}
+
+int main(void)
+{
+    FATFS fs;
+    firmHeader firm;
+    firmCacheHeader header,
+                    saved;
+    u32 sizes[4];
+    int failed = 0;
+
+    mapFixed(CACHE_AREA, 0x100000);
+    mapFixed(ARM9_MEM, 0x180000);
+    mapFixed(AXI_WRAM, 0x100000);
+
+    createDisk(&sdDisk, 80000);
+    formatFat32(&sdDisk, 1);
+    f_mount(&fs, "0:", 1);
+    f_mkdir("luma");
+
+    clearMemory();
+    fillSections();
+    saveCachedFirm(&testFirm, &testKey, testSizes);
+
+    clearMemory();
+    if(!loadCachedFirm(&firm, &testKey, sizes) || memcmp(&firm, &testFirm, sizeof(firm)) != 0 ||
+       memcmp(sizes, testSizes, sizeof(sizes)) != 0)
+    {
+        printf("The saved cache isn't loaded back\n");
+        failed = 1;
+    }
+    else
+    {
+        for(u32 i = 0; i < 3; i++)
+            if(memcmp(testFirm.section[i].address, sections[i], testSizes[i]) != 0)
+            {
+                printf("Section %u isn't loaded back\n", i);
+                failed = 1;
+            }
+
+        if(!failed) printf("%-28s loaded\n", "saved cache");
+    }
+
+    firmCacheKey otherKey = testKey;
+    otherKey.config ^= 1;
+    clearMemory();
+    if(loadCachedFirm(&firm, &otherKey, sizes))
+    {
+        printf("The cache is loaded with another key\n");
+        failed = 1;
+    }
+    else printf("%-28s rejected\n", "other key");
+
+    readHeader(&saved);
+
+    //A section which doesn't match its hash
+    header = saved;
+    header.sectionHashes[1][0] ^= 1;
+    hashCacheHeader(header.headerHash, &header);
+    writeHeader(&header);
+    failed |= expectRejected("corrupt section", false);
+
+    //A header changed without its hash
+    header = saved;
+    header.firm.section[2].address += 0x100;
+    writeHeader(&header);
+    failed |= expectRejected("tampered header", true);
+
+    //Sections pointing outside section memory, with the header hash matching
+    static const struct
+    {
+        const char *name;
+        u32 address,
+            size;
+    } outOfRange[] = {
+        {"below ARM9 section memory", ARM9_MEM, SECTION2_SIZE},
+        {"past N3DS ARM9 memory", 0x08180000 - 0x1000, SECTION2_SIZE},
+        {"over the ARM11 queue", 0x1FFFFE00 - 0x1000, 0x2000},
+        {"wrapping around", 0x1FF80000, 0xFFFFFFFF - 0x1FF80000 + 0x1001},
+        {"outside section memory", CACHE_AREA, 0x1000}
+    };
+
+    for(u32 i = 0; i < sizeof(outOfRange) / sizeof(outOfRange[0]); i++)
+    {
+        header = saved;
+        header.firm.section[2].address = (u8 *)(uintptr_t)outOfRange[i].address;
+        header.sectionSizes[2] = outOfRange[i].size;
+        hashCacheHeader(header.headerHash, &header);
+        writeHeader(&header);
+        failed |= expectRejected(outOfRange[i].name, true);
+    }
+
+    //O3DS ARM9 memory ends 0x80000 bytes earlier
+    isN3DS = false;
+    header = saved;
+    header.firm.section[2].address = (u8 *)0x08100000 - 0x1000;
+    hashCacheHeader(header.headerHash, &header);
+    writeHeader(&header);
+    failed |= expectRejected("past O3DS ARM9 memory", true);
+
+    f_mount(NULL, "0:", 1);
+
+    return failed;
+}
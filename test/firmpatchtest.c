@@ -0,0 +1,555 @@
+/*
+*   Host test bench of the FIRM patch engine. firm.c and patches.c are included to reach their
+*   static functions and state, emunand.c is linked as is.
+*   A fake FIRM header points at synthetic ARM9 and ARM11 sections at their load addresses:
+*   the ARM9 one holds a Process9 NCCH with every pattern the Process9 patches look for, the MPU
+*   settings and the marker before the emuNAND code space, the ARM11 one an exceptions page, an
+*   SVC table and free space. Every patch path is run on them, on O3DS and N3DS, SysNAND and
+*   emuNAND (raw and file-backed), with and without A9LH, on FIRMs from before and after 11.0,
+*   and the result is compared with images the expected patches are applied to independently,
+*   so that anything else being written shows up too. The legacy FIRM patches are checked the
+*   same way, and a rescan of the emuNAND slots must keep the NAND image's. Each stage is then timed
+*/
+
+#define main firmMain
+#include "../source/firm.c"
+#undef main
+#include "../source/patches.c"
+
+#include <stdio.h>
+#include <stddef.h>
+#include "hostdisk.h"
+#include "../source/fatfs/sdmmc/sdmmc.h"
+
+//The emuNAND code emunand.o copies
+extern const unsigned char emunand[];
+extern const int emunand_size;
+
+//Load addresses and sizes close to a NATIVE_FIRM's
+#define SECTION1_ADDR   0x1FF80000
+#define SECTION2_ADDR   0x08006800
+#define SECTION1_SIZE   0x32000
+#define SECTION2_SIZE   0xC8000
+
+//The ARM9 section layout
+#define MPU_OFFSET          0x1000
+#define OLD_WRITES_OFFSET   0x2000
+#define MARKER_OFFSET       0x13FAB
+#define EMU_CODE_OFFSET     (MARKER_OFFSET + 0x455)
+#define NCCH_OFFSET         0x16000
+#define PROCESS9_OFFSET     (NCCH_OFFSET + 0x800)
+#define PROCESS9_SIZE       0x80000
+#define PROCESS9_ADDR       0x08028000
+
+//Pattern locations, relative to the Process9 code
+#define SIG_CHECK_OFFSET        0x1000
+#define SIG_CHECK2_OFFSET       0x2002
+#define FIRMLAUNCH_OFFSET       0x10000
+#define FOPEN_OFFSET            0x8000
+#define FIRM_WRITES_OFFSET      0x20000
+#define WRITE_CHECK_OFFSET      0x1FF40
+#define TITLE_INSTALL_OFFSET    0x30000
+#define SDMMC_OFFSET            0x40000
+#define NAND_READ_OFFSET        0x50000
+#define NAND_WRITE_OFFSET       0x50080
+
+//The ARM11 section layout
+#define SVC_HANDLER_OFFSET  0x800
+#define EXCEPTIONS_OFFSET   0x1000
+#define SVC_TABLE_OFFSET    0x2010
+#define FREE_K11_OFFSET     0x3000
+
+//The legacy FIRMs are patched in the FIRM buffer, TWL_FIRM's ARM11 section is where twlBg is
+#define LEGACY_FIRM_SIZE    0x200000
+#define TWL_SECTION1_OFFSET 0x100000
+
+#define NAND_SECTORS    0x1000
+#define BENCH_RUNS      50
+
+//What the emuNANDs are in the SD
+static const u32 redNandExtents[2] = {0, 1},
+                 fileExtentTable[4] = {0, 0x3000, 0x200, 0x5000};
+
+static u8 arm9Section[SECTION2_SIZE],
+          arm11Section[SECTION1_SIZE],
+          expectedArm9[SECTION2_SIZE],
+          expectedArm11[SECTION1_SIZE],
+          legacyFirm[LEGACY_FIRM_SIZE],
+          expectedLegacy[LEGACY_FIRM_SIZE];
+
+static u32 arm9LoaderCalls,
+           rsaKeyCalls;
+
+static u32 seed = 1;
+
+static u8 nextRandom(void)
+{
+    seed = seed * 1103515245 + 12345;
+    return (u8)(seed >> 16);
+}
+
+//What the bootROM and the ARM9 binary decryption would do, only counted
+void arm9Loader(__attribute__((unused)) u8 *arm9Section, __attribute__((unused)) bool decryptArm9Bin)
+{
+    arm9LoaderCalls++;
+}
+
+void setRSAMod0DerivedKeys(void)
+{
+    rsaKeyCalls++;
+}
+
+//Only the FIRM loading code, which isn't run here, decrypts
+void decryptExeFs(__attribute__((unused)) u8 *inbuf) {}
+void initExeFsDecryption(__attribute__((unused)) u8 *inbuf) {}
+void decryptExeFsRange(__attribute__((unused)) void *dest, __attribute__((unused)) u32 offset, __attribute__((unused)) u32 size) {}
+
+mmcdevice *getMMCDevice(__attribute__((unused)) int drive)
+{
+    static mmcdevice nand = {.total_size = NAND_SECTORS};
+
+    return &nand;
+}
+
+//The file-backed emuNAND is in two fragments
+u32 fileExtents(__attribute__((unused)) const char *path, u32 *extents, u32 *sectorCount)
+{
+    memcpy(extents, fileExtentTable, sizeof(fileExtentTable));
+    *sectorCount = NAND_SECTORS;
+
+    return 2;
+}
+
+static void write32(u8 *pos, u32 value)
+{
+    memcpy(pos, &value, 4);
+}
+
+static void buildArm9Section(void)
+{
+    static const u8 sigCheck[] = {0xC0, 0x1C, 0x76, 0xE7},
+                    sigCheck2[] = {0xB5, 0x22, 0x4D, 0x0C},
+                    firmlaunch[] = {0xE2, 0x20, 0x20, 0x90},
+                    writeCheck[] = {0x00, 0x28, 0x01, 0xDA},
+                    titleInstall[] = {0x0A, 0x81, 0x42, 0x02},
+                    sdmmc[] = {0x21, 0x20, 0x18, 0x20},
+                    nandRW[] = {0x1E, 0x00, 0xC8, 0x05},
+                    oldWrites[] = {0x04, 0x1E, 0x1D, 0xDB},
+                    marker[] = {0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0x00};
+
+    for(u32 i = 0; i < SECTION2_SIZE; i++) arm9Section[i] = nextRandom();
+
+    //Nothing to find between where the searches for the emuNAND code space and Process9 start
+    memset32(arm9Section + 0x13500, 0, PROCESS9_OFFSET - 0x13500);
+    memcpy(arm9Section + MARKER_OFFSET, marker, sizeof(marker));
+
+    write32(arm9Section + MPU_OFFSET, 0x00240003);
+    memcpy(arm9Section + OLD_WRITES_OFFSET, oldWrites, 4);
+
+    //Process9's NCCH: the ExeFS and its size, then the exheader with the name and load address
+    u8 *ncch = arm9Section + NCCH_OFFSET;
+    write32(ncch + 0x1A0, 3);
+    write32(ncch + 0x1A4, PROCESS9_SIZE / 0x200);
+    memcpy(ncch + 0x200, "Process9", 8);
+    write32(ncch + 0x210, PROCESS9_ADDR);
+
+    u8 *process9 = arm9Section + PROCESS9_OFFSET;
+    memcpy(process9 + SIG_CHECK_OFFSET, sigCheck, 4);
+    memcpy(process9 + SIG_CHECK2_OFFSET, sigCheck2, 4);
+
+    //The firmlaunch code starts with a BLX back to fOpen
+    write32(process9 + FIRMLAUNCH_OFFSET, 0xFA000000 | (((FOPEN_OFFSET - FIRMLAUNCH_OFFSET - 8) >> 2) & 0xFFFFFF));
+    memcpy(process9 + FIRMLAUNCH_OFFSET + 0x13, firmlaunch, 4);
+
+    memcpy(process9 + FIRM_WRITES_OFFSET, "exe:", 4);
+    memcpy(process9 + WRITE_CHECK_OFFSET, writeCheck, 4);
+    memcpy(process9 + TITLE_INSTALL_OFFSET, titleInstall, 4);
+
+    memcpy(process9 + SDMMC_OFFSET, sdmmc, 4);
+    write32(process9 + SDMMC_OFFSET + 9, 0x0801A000);
+    write32(process9 + SDMMC_OFFSET + 0xD, 0x1234);
+
+    memcpy(process9 + NAND_READ_OFFSET + 6, nandRW, 4);
+    memcpy(process9 + NAND_WRITE_OFFSET + 6, nandRW, 4);
+}
+
+static void buildArm11Section(void)
+{
+    for(u32 i = 0; i < SECTION1_SIZE; i++) arm11Section[i] = nextRandom();
+
+    //The SVC vector branches back to a handler, which jumps to the address 8 bytes in
+    u32 handler = 0xFFF00000 + SVC_HANDLER_OFFSET;
+    write32(arm11Section + EXCEPTIONS_OFFSET + 8, 0xEA000000 | (((handler - 0xFFFF0010) >> 2) & 0xFFFFFF));
+    write32(arm11Section + EXCEPTIONS_OFFSET + 0xB * 4, 0xE59CB000);
+    write32(arm11Section + SVC_HANDLER_OFFSET + 8, 0xFFF00000 + SVC_TABLE_OFFSET - 0x10);
+
+    //The handler's code, then the table, whose SVC 0 is NULL. 11.0 removed svcBackdoor
+    for(u32 i = 0; i < 4; i++) write32(arm11Section + SVC_TABLE_OFFSET - 0x10 + i * 4, 0xE1A00000);
+    for(u32 i = 0; i < 0x80; i++) write32(arm11Section + SVC_TABLE_OFFSET + i * 4, i == 0 || i == 0x7B ? 0 : 0xFFF10000 + i * 0x10);
+
+    arm11Section[FREE_K11_OFFSET - 2] = 0;
+    for(u32 i = FREE_K11_OFFSET - 1; i < FREE_K11_OFFSET + 0x400; i++) arm11Section[i] = 0xFF;
+}
+
+static void buildSd(void)
+{
+    createDisk(&sdDisk, 0x5000 + NAND_SECTORS);
+
+    //The RedNAND's header, and the NAND image's, whose partitions are each in one fragment
+    write32(sdDisk.image + 0x200 + 0x100, NCSD_MAGIC);
+
+    u8 *header = sdDisk.image + fileExtentTable[1] * 0x200;
+    write32(header + 0x100, NCSD_MAGIC);
+    write32(header + 0x120, 0);
+    write32(header + 0x124, 0x100);
+    write32(header + 0x128, 0x200);
+    write32(header + 0x12C, 0x100);
+}
+
+//Puts the pristine sections at their load addresses and resets what the patches remember
+static void loadSections(void)
+{
+    memcpy((void *)SECTION2_ADDR, arm9Section, SECTION2_SIZE);
+    memcpy((void *)SECTION1_ADDR, arm11Section, SECTION1_SIZE);
+
+    memset32(firm, 0, sizeof(firmHeader));
+    firm->section[1] = (firmSectionHeader){0x200, (u8 *)SECTION1_ADDR, SECTION1_SIZE, 1, {0}};
+    firm->section[2] = (firmSectionHeader){0x200 + SECTION1_SIZE, (u8 *)SECTION2_ADDR, SECTION2_SIZE, 0, {0}};
+    section = firm->section;
+    sectionsInPlace = true;
+
+    arm11SvcTable = NULL;
+    freeK11Space = NULL;
+    arm9LoaderCalls = 0;
+    rsaKeyCalls = 0;
+}
+
+static void expectWrite(u8 *image, u32 offset, const void *data, u32 size)
+{
+    memcpy(image + offset, data, size);
+}
+
+static void expectNativeFirm(bool is11, FirmwareSource nandType, bool isA9lh, u32 emuHeader, const u32 *extents, u32 extentCount)
+{
+    u8 *process9 = expectedArm9 + PROCESS9_OFFSET;
+
+    memcpy(expectedArm9, arm9Section, SECTION2_SIZE);
+    memcpy(expectedArm11, arm11Section, SECTION1_SIZE);
+
+    //Signature checks, and anti-anti-DG on 11.0
+    write32(process9 + SIG_CHECK_OFFSET, 0xE7762000);
+    write32(process9 + SIG_CHECK2_OFFSET - 2, 0x47702000);
+    if(is11) process9[TITLE_INSTALL_OFFSET + 4] = 0xE0;
+
+    if(nandType != FIRMWARE_SYSNAND)
+    {
+        u8 *emuCode = expectedArm9 + EMU_CODE_OFFSET;
+        u32 emuCodeAddr = SECTION2_ADDR + EMU_CODE_OFFSET;
+
+        expectWrite(emuCode, 0, emunand, emunand_size);
+        write32(emuCode, 0x0801A000 + 0x1234);
+        write32(emuCode + 4, emuHeader);
+        write32(emuCode + 8, extentCount);
+        write32(emuCode + 0xC, emuCodeAddr + 0x10);
+        expectWrite(emuCode, 0x10, extents, extentCount * 8);
+
+        //ldr r4, [pc]; blx r4, then the address of the emuNAND code
+        write32(process9 + NAND_READ_OFFSET, 0x47A04C00);
+        write32(process9 + NAND_READ_OFFSET + 4, emuCodeAddr);
+        write32(process9 + NAND_WRITE_OFFSET, 0x47A04C00);
+        write32(process9 + NAND_WRITE_OFFSET + 4, emuCodeAddr);
+
+        write32(expectedArm9 + MPU_OFFSET, 0x00360003);
+        write32(expectedArm9 + MPU_OFFSET + 6 * 4, 0x00200603);
+        write32(expectedArm9 + MPU_OFFSET + 9 * 4, 0x001C0603);
+    }
+    else if(isA9lh) write32(process9 + WRITE_CHECK_OFFSET, 0x46C02000);
+
+    //The reboot code, with the Thumb address of fOpen
+    expectWrite(process9, FIRMLAUNCH_OFFSET, reboot, reboot_size);
+    write32(process9 + FIRMLAUNCH_OFFSET, PROCESS9_ADDR + FOPEN_OFFSET + 1);
+
+    u32 freeSpace = FREE_K11_OFFSET;
+
+    if(is11)
+    {
+        static const u32 svcBackdoor[10] = {0xE3CD10FF, 0xE3811C0F, 0xE2811028, 0xE5912000, 0xE9226000,
+                                            0xE1A0D002, 0xE12FFF30, 0xE8BD0003, 0xE1A0D000, 0xE12FFF11};
+
+        expectWrite(expectedArm11, freeSpace, svcBackdoor, sizeof(svcBackdoor));
+        write32(expectedArm11 + SVC_TABLE_OFFSET + 0x7B * 4, 0xFFF00000 + freeSpace);
+        freeSpace += sizeof(svcBackdoor);
+    }
+
+    CFWInfo info = {{'L', 'U', 'M', 'A'}, 1, 2, 3, 1 << 1, COMMIT_HASH, configData.config};
+
+    expectWrite(expectedArm11, freeSpace, svcGetCFWInfo, svcGetCFWInfo_size);
+    expectWrite(expectedArm11, freeSpace, &info, sizeof(info));
+    write32(expectedArm11 + SVC_TABLE_OFFSET + 0x2E * 4, 0xFFF00000 + freeSpace);
+}
+
+static int compareImage(const char *name, const char *what, const u8 *result, const u8 *expected, u32 size)
+{
+    for(u32 i = 0; i < size; i++)
+        if(result[i] != expected[i])
+        {
+            printf("%s: %s differs at 0x%X (0x%02X instead of 0x%02X)\n", name, what, i, result[i], expected[i]);
+            return 1;
+        }
+
+    return 0;
+}
+
+static int testNativeFirm(bool n3ds, bool is11, FirmwareSource nandType, bool isA9lh)
+{
+    static const char *nandNames[] = {"SysNAND", "RedNAND", "NAND image"};
+    char name[96];
+    u32 firmVersion = n3ds ? (is11 ? 0x21 : 0x1B) : (is11 ? 0x52 : 0x49),
+        emuOffset = 0,
+        emuHeader = 0;
+    FirmwareSource located = nandType;
+    int failed = 0;
+
+    snprintf(name, sizeof(name), "%s %s %s%s", n3ds ? "N3DS" : "O3DS", is11 ? "11.0" : "10.x", nandNames[nandType], isA9lh ? " A9LH" : "");
+
+    isN3DS = n3ds;
+    loadSections();
+
+    if(nandType != FIRMWARE_SYSNAND && (locateEmuNAND(&emuOffset, &emuHeader, &located) || located != nandType))
+    {
+        printf("%s: the emuNAND wasn't found where it was stored\n", name);
+        return 1;
+    }
+
+    patchNativeFirm(firmVersion, nandType, emuHeader, isA9lh);
+
+    if(nandType == FIRMWARE_EMUNAND) expectNativeFirm(is11, nandType, isA9lh, 1, redNandExtents, 1);
+    else expectNativeFirm(is11, nandType, isA9lh, 0, fileExtentTable, 2);
+
+    failed |= compareImage(name, "the ARM9 section", (u8 *)SECTION2_ADDR, expectedArm9, SECTION2_SIZE);
+    failed |= compareImage(name, "the ARM11 section", (u8 *)SECTION1_ADDR, expectedArm11, SECTION1_SIZE);
+
+    bool expectedRsaKeys = !n3ds && !isA9lh && firmVersion >= 0x29;
+
+    if(arm9LoaderCalls != (u32)n3ds || (n3ds && firm->arm9Entry != (u8 *)0x801B01C) || rsaKeyCalls != (u32)expectedRsaKeys)
+    {
+        printf("%s: arm9loader or the 7.x keys were handled wrong\n", name);
+        failed = 1;
+    }
+
+    return failed;
+}
+
+//SAFE_FIRM and 2.x NATIVE_FIRM with A9LH, FIRM writes are found without patchProcess9's matches
+static int testSafeFirm(bool n3ds)
+{
+    const char *name = n3ds ? "N3DS SAFE_FIRM" : "O3DS SAFE_FIRM";
+
+    isN3DS = n3ds;
+    loadSections();
+    patchProcess9(NULL, 0, 0);
+
+    patch2xNativeAndSafeFirm();
+
+    memcpy(expectedArm9, arm9Section, SECTION2_SIZE);
+    if(n3ds) write32(expectedArm9 + PROCESS9_OFFSET + WRITE_CHECK_OFFSET, 0x46C02000);
+    else write32(expectedArm9 + OLD_WRITES_OFFSET, 0xE01D2400);
+
+    return compareImage(name, "the ARM9 section", (u8 *)SECTION2_ADDR, expectedArm9, SECTION2_SIZE) |
+           compareImage(name, "the ARM11 section", (u8 *)SECTION1_ADDR, arm11Section, SECTION1_SIZE);
+}
+
+static void expectHalfword(u32 offset, u16 value)
+{
+    memcpy(expectedLegacy + offset, &value, 2);
+}
+
+static int testLegacyFirm(bool n3ds, FirmwareType firmType)
+{
+    //As applyLegacyFirmPatches has them, by console
+    static const u32 twlOffsets[][2] = {
+        {0x1650C0, 0x165D64}, {0x173A0E, 0x17474A}, {0x174802, 0x17553E}, {0x174964, 0x1756A0}, {0x174D52, 0x175A8E},
+        {0x174D5E, 0x175A9A}, {0x174D6A, 0x175AA6}, {0x174E56, 0x175B92}, {0x174E58, 0x175B94}
+    },
+                     agbOffsets[][2] = {{0x9D2A8, 0x9DF64}, {0xD7A12, 0xD8B8A}};
+    static const u16 twlValues[] = {0, 0x2001, 0x2000, 0x2000, 0x2001, 0x2001, 0x2001, 0x2001, 0x4770};
+    static const u8 bootScreenPatch[] = {0x00, 0x20, 0x4E, 0xB0, 0x70, 0xBD};
+    const char *name = firmType == TWL_FIRM ? (n3ds ? "N3DS TWL_FIRM" : "O3DS TWL_FIRM") : (n3ds ? "N3DS AGB_FIRM" : "O3DS AGB_FIRM");
+    u32 console = n3ds ? 1 : 0;
+
+    isN3DS = n3ds;
+    arm9LoaderCalls = 0;
+
+    memcpy(firm, legacyFirm, LEGACY_FIRM_SIZE);
+    firm->section[1].offset = TWL_SECTION1_OFFSET;
+    memcpy(expectedLegacy, firm, LEGACY_FIRM_SIZE);
+    section = firm->section;
+
+    patchLegacyFirm(firmType);
+
+    if(n3ds)
+    {
+        const u8 *arm9Entry = (const u8 *)0x801301C;
+        memcpy(expectedLegacy + offsetof(firmHeader, arm9Entry), &arm9Entry, sizeof(arm9Entry));
+    }
+
+    if(firmType == TWL_FIRM)
+    {
+        memcpy(expectedLegacy + twlOffsets[0][console], bootScreenPatch, sizeof(bootScreenPatch));
+
+        for(u32 i = 1; i < sizeof(twlValues) / sizeof(twlValues[0]); i++)
+        {
+            //The type 2 patches zero the instruction after
+            if(i >= 2 && i <= 6) expectHalfword(twlOffsets[i][console] + 2, 0);
+            expectHalfword(twlOffsets[i][console], twlValues[i]);
+        }
+
+        //twlBg's K11 hook, with the dev SRL launcher offset, and the two BLXs to it
+        u32 hook = TWL_SECTION1_OFFSET + (n3ds ? 0xFEA4 : 0xFCA0);
+        memcpy(expectedLegacy + hook, twl_k11modules, twl_k11modules_size);
+        write32(expectedLegacy + hook, n3ds ? 0xCDE88 : 0xCD5F8);
+
+        for(u32 i = 0; i < 2; i++)
+        {
+            u32 call = TWL_SECTION1_OFFSET + (n3ds ? 0xE38 : 0xE3C) + i * 0x1C,
+                distance = hook - call - 4;
+
+            expectHalfword(call, 0xF000 | (distance >> 12));
+            expectHalfword(call + 2, 0xE800 | ((distance & 0xFFF) >> 1));
+        }
+    }
+    else
+    {
+        //The boot screen patch is only applied when enabled
+        expectHalfword(agbOffsets[1][console], 0xEF26);
+        if(CONFIG(6)) memcpy(expectedLegacy + agbOffsets[0][console], bootScreenPatch, sizeof(bootScreenPatch));
+    }
+
+    int failed = compareImage(name, "the FIRM", (u8 *)firm, expectedLegacy, LEGACY_FIRM_SIZE);
+
+    if(arm9LoaderCalls != console)
+    {
+        printf("%s: arm9loader was handled wrong\n", name);
+        failed = 1;
+    }
+
+    return failed;
+}
+
+//A stale RedNAND location makes locateEmuNAND look at all the slots, the NAND image's has to stay
+static int testRescan(void)
+{
+    u32 emuOffset, emuHeader;
+    FirmwareSource nandType = FIRMWARE_EMUNAND;
+    const emuNandLocation fileLocation = configData.emuNands[1];
+
+    configData.emuNands[0].header = 0x4000;
+
+    if(!locateEmuNAND(&emuOffset, &emuHeader, &nandType) || nandType != FIRMWARE_EMUNAND || emuHeader != 1 ||
+       configData.emuNands[0].type != EMUNAND_REDNAND || memcmp(&configData.emuNands[1], &fileLocation, sizeof(fileLocation)) != 0)
+    {
+        printf("Rescan: the RedNAND wasn't found again, or the NAND image's slot was dropped\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+static void benchmark(void)
+{
+    static const char *stages[] = {"patchProcess9", "patchEmuNAND", "patchFirmlaunches", "reimplementSvcBackdoor",
+                                   "implementSvcGetCFWInfo", "patchLegacyFirm (TWL)", "patchLegacyFirm (AGB)"};
+    double times[sizeof(stages) / sizeof(stages[0])] = {0};
+    u8 *arm9 = (u8 *)SECTION2_ADDR,
+       *arm11 = (u8 *)SECTION1_ADDR,
+       *process9 = arm9 + PROCESS9_OFFSET;
+    u32 emuOffset, emuHeader;
+    FirmwareSource nandType = FIRMWARE_EMUNAND;
+
+    isN3DS = false;
+    locateEmuNAND(&emuOffset, &emuHeader, &nandType);
+
+    for(u32 run = 0; run < BENCH_RUNS; run++)
+    {
+        u32 stage = 0;
+        double start;
+
+        loadSections();
+
+        start = now();
+        patchProcess9(process9, PROCESS9_SIZE, 0x13);
+        times[stage++] += now() - start;
+
+        start = now();
+        patchEmuNAND(arm9, SECTION2_SIZE, process9, PROCESS9_SIZE, emuHeader, 0);
+        times[stage++] += now() - start;
+
+        start = now();
+        patchFirmlaunches(process9, PROCESS9_SIZE, PROCESS9_ADDR);
+        times[stage++] += now() - start;
+
+        start = now();
+        reimplementSvcBackdoor(arm11, SECTION1_SIZE);
+        times[stage++] += now() - start;
+
+        start = now();
+        implementSvcGetCFWInfo(arm11, SECTION1_SIZE);
+        times[stage++] += now() - start;
+
+        memcpy(firm, legacyFirm, LEGACY_FIRM_SIZE);
+        firm->section[1].offset = TWL_SECTION1_OFFSET;
+        section = firm->section;
+
+        start = now();
+        patchLegacyFirm(TWL_FIRM);
+        times[stage++] += now() - start;
+
+        start = now();
+        patchLegacyFirm(AGB_FIRM);
+        times[stage++] += now() - start;
+    }
+
+    printf("\nO3DS 11.0 emuNAND FIRM, us per stage over %u runs (the first one compiles the tables)\n", BENCH_RUNS);
+    for(u32 i = 0; i < sizeof(stages) / sizeof(stages[0]); i++)
+        printf("%-24s %8.1f\n", stages[i], times[i] * 1e6 / BENCH_RUNS);
+}
+
+int main(void)
+{
+    mapFixed((uintptr_t)firm, LEGACY_FIRM_SIZE);
+    mapFixed(SECTION1_ADDR & ~0xFFFFF, 0x100000);
+    mapFixed(SECTION2_ADDR & ~0xFFFFF, 0x100000);
+
+    buildArm9Section();
+    buildArm11Section();
+    buildSd();
+    for(u32 i = 0; i < LEGACY_FIRM_SIZE; i++) legacyFirm[i] = nextRandom();
+
+    //TWL_FIRM's twlBg patch and AGB_FIRM's boot screen, an emuNAND in each of the first two slots
+    configData.config = (1u << (5 + 16)) | (1u << (6 + 16));
+    configData.emuNands[0] = (emuNandLocation){1, 1, NAND_SECTORS, EMUNAND_REDNAND};
+    configData.emuNands[1] = (emuNandLocation){fileExtentTable[1], 0, NAND_SECTORS, EMUNAND_FILE};
+
+    int failed = 0;
+
+    for(u32 n3ds = 0; n3ds < 2; n3ds++)
+    {
+        for(u32 is11 = 0; is11 < 2; is11++)
+            for(FirmwareSource nandType = FIRMWARE_SYSNAND; nandType <= FIRMWARE_EMUNAND2; nandType++)
+                for(u32 isA9lh = 0; isA9lh < 2; isA9lh++)
+                    failed |= testNativeFirm(n3ds, is11, nandType, isA9lh);
+
+        failed |= testSafeFirm(n3ds);
+        failed |= testLegacyFirm(n3ds, TWL_FIRM);
+        failed |= testLegacyFirm(n3ds, AGB_FIRM);
+    }
+
+    failed |= testRescan();
+
+    if(failed) return 1;
+
+    printf("FIRM patches: every NATIVE_FIRM, SAFE_FIRM, TWL_FIRM and AGB_FIRM path patches exactly what it should\n");
+    benchmark();
+
+    return 0;
+}
@@ -0,0 +1,267 @@
+/*
+*   Host test of how source/firm.c routes the FIRM sections: decryptFirmSections decrypts each
+*   section with decryptExeFsRange straight to its load address, injecting 3ds_injector in place
+*   of loader in section0. firm.c is included to reach its static functions, with the software
+*   AES (swcrypto.c) standing in for the AES engine.
+*   A synthetic encrypted NATIVE_FIRM NCCH is routed that way, and the result is compared with
+*   the plain sections and with the whole-ExeFS path (decryptExeFs, then the copies launchFirm
+*   does when the sections aren't in place), which both paths are also timed on
+*/
+
+#define main firmMain
+#include "../source/firm.c"
+#undef main
+
+#include <stdio.h>
+#include "hostdisk.h"
+#include "../source/swcrypto.h"
+
+//Where the NCCH is read to, with room for decryptExeFs writing the ExeFS 0x200 bytes before it
+#define FIRM_AREA       0x23F00000
+#define FIRM_AREA_SIZE  0x300000
+
+//Load addresses and sizes close to a NATIVE_FIRM's
+#define SECTION0_ADDR   0x1FF00000
+#define SECTION1_ADDR   0x1FF80000
+#define SECTION2_ADDR   0x08006800
+#define SECTION1_SIZE   0x32000
+#define SECTION2_SIZE   0xC8000
+
+#define MODULE_COUNT    5
+#define GUARD           0x100
+#define REFERENCE_SLOT  0x3E
+
+static const u8 keyX0x2C[0x10] = {0xB9, 0x8E, 0x95, 0xCE, 0xCA, 0x3E, 0x4D, 0x17, 0x1F, 0x76, 0xA9, 0x4D, 0xE9, 0x34, 0xC0, 0x53};
+
+static const char moduleNames[MODULE_COUNT][8] = {"sm", "fs", "pm", "loader", "pxi"};
+
+//The plain FIRM, which starts with its header
+static u8 plainFirm[0x200 + 0x30000 + SECTION1_SIZE + SECTION2_SIZE];
+static u32 plainFirmSize;
+
+//The encrypted NCCH, copied to the FIRM buffer before each run
+static u8 ncch[0x400 + sizeof(plainFirm)];
+static u32 ncchSize;
+
+//What section0 should look like once loaded
+static u8 expectedSection0[0x30000 + 0x10000];
+static u32 expectedSection0Size;
+
+static u32 seed = 1;
+
+static u8 nextRandom(void)
+{
+    seed = seed * 1103515245 + 12345;
+    return (u8)(seed >> 16);
+}
+
+//A FIRM with the given module order in section0, and whether loader gets replaced
+static void buildFirm(u32 loaderPosition, bool injectModules)
+{
+    firmHeader *header = (firmHeader *)plainFirm;
+    u32 offset = 0x200;
+
+    memset32(plainFirm, 0, sizeof(plainFirm));
+    header->magic = 0x4D524946;
+
+    //section0 is the system modules' NCCHs back to back
+    u32 section0Start = offset;
+    expectedSection0Size = 0;
+
+    for(u32 i = 0; i < MODULE_COUNT; i++)
+    {
+        const char *name = moduleNames[(i + MODULE_COUNT - loaderPosition + 3) % MODULE_COUNT];
+        u32 size = 0x400 + (((u32)nextRandom() << 4) % 0x8000 & ~0x1FFu) + 0x200;
+        u8 *module = plainFirm + offset;
+
+        for(u32 j = 0; j < size; j++) module[j] = nextRandom();
+        *(u32 *)(module + 0x104) = size / 0x200;
+        memcpy(module + 0x200, name, 8);
+
+        if(injectModules && memcmp(name, "loader", 7) == 0)
+        {
+            memcpy(expectedSection0 + expectedSection0Size, injector, injector_size);
+            expectedSection0Size += injector_size;
+        }
+        else
+        {
+            memcpy(expectedSection0 + expectedSection0Size, module, size);
+            expectedSection0Size += size;
+        }
+
+        offset += size;
+    }
+
+    header->section[0] = (firmSectionHeader){section0Start, (u8 *)SECTION0_ADDR, offset - section0Start, 0, {0}};
+
+    header->section[1] = (firmSectionHeader){offset, (u8 *)SECTION1_ADDR, SECTION1_SIZE, 1, {0}};
+    for(u32 i = 0; i < SECTION1_SIZE; i++) plainFirm[offset + i] = nextRandom();
+    offset += SECTION1_SIZE;
+
+    header->section[2] = (firmSectionHeader){offset, (u8 *)SECTION2_ADDR, SECTION2_SIZE, 0, {0}};
+    for(u32 i = 0; i < SECTION2_SIZE; i++) plainFirm[offset + i] = nextRandom();
+    offset += SECTION2_SIZE;
+
+    plainFirmSize = offset;
+
+    //The NCCH: header, then the ExeFS header and the FIRM, encrypted from the ExeFS on
+    memset32(ncch, 0, sizeof(ncch));
+    for(u32 i = 0; i < 0x200; i++) ncch[i] = nextRandom();
+    *(u32 *)(ncch + 0x1A0) = 1;
+    *(u32 *)(ncch + 0x1A4) = (0x200 + plainFirmSize + 0x1FF) / 0x200;
+    memcpy(ncch + 0x400, plainFirm, plainFirmSize);
+    ncchSize = 0x400 + plainFirmSize;
+
+    u8 ctr[0x10] = {0};
+    for(u32 i = 0; i < 8; i++) ctr[7 - i] = ncch[0x108 + i];
+    ctr[8] = 2;
+
+    swAesSetKey(REFERENCE_SLOT, keyX0x2C, AES_KEYX);
+    swAesSetKey(REFERENCE_SLOT, ncch, AES_KEYY);
+    swAesUseKeyslot(REFERENCE_SLOT);
+    swAes(ncch + 0x200, ncch + 0x200, (ncchSize - 0x200) / AES_BLOCK_SIZE, ctr, AES_CTR_MODE);
+}
+
+//Fills the load areas with a pattern, so that writes past the sections show up
+static void clearLoadAreas(void)
+{
+    memset32((void *)SECTION0_ADDR, 0xA5A5A5A5, SECTION1_ADDR - SECTION0_ADDR);
+    memset32((void *)SECTION1_ADDR, 0xA5A5A5A5, SECTION1_SIZE + GUARD);
+    memset32((void *)SECTION2_ADDR, 0xA5A5A5A5, SECTION2_SIZE + GUARD);
+    memcpy(firm, ncch, ncchSize);
+}
+
+//What decryptFirmSections does on the boot path, in loadFirm
+static void routeSections(bool injectModules)
+{
+    sectionsInPlace = false;
+    section = firm->section;
+
+    initExeFsDecryption((u8 *)firm);
+    decryptFirmSections(injectModules);
+}
+
+//The whole-ExeFS path: decrypt everything in the buffer, then copy like launchFirm
+static void decryptAndCopySections(bool injectModules)
+{
+    sectionsInPlace = false;
+    section = firm->section;
+
+    decryptExeFs((u8 *)firm);
+
+    u32 sectionNum = 0;
+    if(injectModules)
+    {
+        copySection0AndInjectSystemModules();
+        sectionNum = 1;
+    }
+
+    for(; sectionNum < 4 && section[sectionNum].size; sectionNum++)
+        memcpy(section[sectionNum].address, (u8 *)firm + section[sectionNum].offset, section[sectionNum].size);
+}
+
+static bool isUntouched(const u8 *pos, u32 size)
+{
+    for(u32 i = 0; i < size; i++)
+        if(pos[i] != 0xA5) return false;
+
+    return true;
+}
+
+static int checkSections(const char *name)
+{
+    const firmHeader *header = (const firmHeader *)plainFirm;
+    const char *failure = NULL;
+
+    if(memcmp((void *)SECTION0_ADDR, expectedSection0, expectedSection0Size) != 0) failure = "section0 differs";
+    else if(!isUntouched((u8 *)SECTION0_ADDR + expectedSection0Size, GUARD)) failure = "section0 overran";
+    else if(memcmp((void *)SECTION1_ADDR, plainFirm + header->section[1].offset, SECTION1_SIZE) != 0) failure = "section1 differs";
+    else if(!isUntouched((u8 *)SECTION1_ADDR + SECTION1_SIZE, GUARD)) failure = "section1 overran";
+    else if(memcmp((void *)SECTION2_ADDR, plainFirm + header->section[2].offset, SECTION2_SIZE) != 0) failure = "section2 differs";
+    else if(!isUntouched((u8 *)SECTION2_ADDR + SECTION2_SIZE, GUARD)) failure = "section2 overran";
+    else if(memcmp(firm, plainFirm, sizeof(firmHeader)) != 0) failure = "the FIRM header isn't decrypted";
+
+    if(failure != NULL)
+    {
+        printf("%s: %s\n", name, failure);
+        return 1;
+    }
+
+    return 0;
+}
+
+static int testRouting(u32 loaderPosition, bool injectModules)
+{
+    char name[64];
+    int failed = 0;
+
+    buildFirm(loaderPosition, injectModules);
+    snprintf(name, sizeof(name), "loader at %u, %s", loaderPosition, injectModules ? "NATIVE_FIRM" : "SAFE_FIRM");
+
+    clearLoadAreas();
+    routeSections(injectModules);
+    failed |= checkSections(name);
+
+    //decryptFirmSections' results as firm.c uses them afterwards
+    if(!sectionsInPlace || getSectionData(1) != (u8 *)SECTION1_ADDR || getSectionData(2) != (u8 *)SECTION2_ADDR ||
+       sectionSizes[0] != expectedSection0Size || sectionSizes[1] != SECTION1_SIZE || sectionSizes[2] != SECTION2_SIZE)
+    {
+        printf("%s: wrong section sizes or locations\n", name);
+        failed = 1;
+    }
+
+    clearLoadAreas();
+    decryptAndCopySections(injectModules);
+    failed |= checkSections(name);
+
+    return failed;
+}
+
+static void benchmark(void)
+{
+    double routeTime = 0,
+           copyTime = 0;
+    u32 runs = 20;
+
+    buildFirm(3, true);
+
+    for(u32 i = 0; i < runs; i++)
+    {
+        clearLoadAreas();
+        double start = now();
+        routeSections(true);
+        routeTime += now() - start;
+
+        clearLoadAreas();
+        start = now();
+        decryptAndCopySections(true);
+        copyTime += now() - start;
+    }
+
+    printf("FIRM sections (0x%X bytes): %.2f ms decrypted in place, %.2f ms decrypted and copied\n",
+           plainFirmSize, routeTime * 1000 / runs, copyTime * 1000 / runs);
+}
+
+int main(void)
+{
+    mapFixed(FIRM_AREA, FIRM_AREA_SIZE);
+    mapFixed(SECTION0_ADDR, 0x100000);
+    mapFixed(SECTION2_ADDR & ~0xFFFFF, 0x100000);
+
+    //Set by the bootROM on the console
+    swAesSetKey(0x2C, keyX0x2C, AES_KEYX);
+
+    int failed = 0;
+    for(u32 loaderPosition = 0; loaderPosition < MODULE_COUNT; loaderPosition++)
+    {
+        failed |= testRouting(loaderPosition, true);
+        failed |= testRouting(loaderPosition, false);
+    }
+
+    if(failed) return 1;
+
+    printf("FIRM sections: routed to their load addresses and injected like the whole-ExeFS path\n");
+    benchmark();
+
+    return 0;
+}
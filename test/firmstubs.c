@@ -0,0 +1,80 @@
+/*
+*   Stand-ins for everything source/firm.c calls, for the tests that include it to reach
+*   its static functions. They are weak, so a test links the real module instead of a
+*   stub just by adding its object
+*/
+
+#include <stdio.h>
+#include "../source/utils.h"
+#include "../source/fs.h"
+#include "../source/patches.h"
+#include "../source/cache.h"
+#include "../source/emunand.h"
+#include "../source/crypto.h"
+#include "../source/draw.h"
+#include "../source/screen.h"
+#include "../source/config.h"
+#include "../source/firmcache.h"
+#include "../source/pin.h"
+
+#define WEAK __attribute__((weak))
+
+//Defined in start.s
+WEAK u16 launchedFirmTIDLow[8];
+
+WEAK void error(const char *message)
+{
+    printf("error(): %s\n", message);
+    exit(1);
+}
+
+WEAK void mcuReboot(void)
+{
+    printf("mcuReboot() called\n");
+    exit(1);
+}
+
+WEAK void startChrono(__attribute__((unused)) u64 initialTicks) {}
+WEAK void stopChrono(void) {}
+WEAK void flushEntireDCache(void) {}
+WEAK void flushEntireICache(void) {}
+WEAK void deinitScreens(void) {}
+WEAK void waitSplash(void) {}
+WEAK bool loadSplash(__attribute__((unused)) bool deferDelay) { return false; }
+WEAK void mountFs(void) {}
+WEAK u32 fileRead(__attribute__((unused)) void *dest, __attribute__((unused)) const char *path, __attribute__((unused)) u32 maxSize) { return 0; }
+WEAK u32 firmRead(__attribute__((unused)) void *dest, __attribute__((unused)) u32 firmType) { return 0xFFFFFFFF; }
+WEAK void loadPayload(__attribute__((unused)) u32 pressed) {}
+WEAK bool readConfig(__attribute__((unused)) const char *configPath) { return false; }
+WEAK void writeConfig(__attribute__((unused)) const char *configPath, __attribute__((unused)) u32 configTemp, __attribute__((unused)) bool emuNandsChanged) {}
+WEAK void configMenu(__attribute__((unused)) bool oldPinStatus) {}
+WEAK bool verifyPin(void) { return true; }
+WEAK bool loadCachedFirm(__attribute__((unused)) firmHeader *firm, __attribute__((unused)) const firmCacheKey *key, __attribute__((unused)) u32 *sectionSizes) { return false; }
+WEAK void saveCachedFirm(__attribute__((unused)) const firmHeader *firm, __attribute__((unused)) const firmCacheKey *key, __attribute__((unused)) const u32 *sectionSizes) {}
+
+WEAK bool locateEmuNAND(__attribute__((unused)) u32 *off, __attribute__((unused)) u32 *head, FirmwareSource *emuNAND)
+{
+    *emuNAND = FIRMWARE_SYSNAND;
+    return false;
+}
+
+WEAK u32 emuNandLayout(void) { return 0; }
+WEAK u32 emuNandSector(u32 sector) { return sector; }
+WEAK void patchEmuNAND(__attribute__((unused)) u8 *arm9Section, __attribute__((unused)) u32 arm9SectionSize, __attribute__((unused)) u8 *process9Offset,
+                       __attribute__((unused)) u32 process9Size, __attribute__((unused)) u32 emuHeader, __attribute__((unused)) u32 branchAdditive) {}
+
+WEAK u8 *getProcess9(u8 *pos, __attribute__((unused)) u32 size, u32 *process9Size, u32 *process9MemAddr)
+{
+    *process9Size = 0;
+    *process9MemAddr = 0;
+    return pos;
+}
+
+WEAK void patchProcess9(__attribute__((unused)) u8 *pos, __attribute__((unused)) u32 size, __attribute__((unused)) u32 enabled) {}
+WEAK void patchFirmlaunches(__attribute__((unused)) u8 *pos, __attribute__((unused)) u32 size, __attribute__((unused)) u32 process9MemAddr) {}
+WEAK void patchFirmWrites(__attribute__((unused)) u8 *pos, __attribute__((unused)) u32 size) {}
+WEAK void patchOldFirmWrites(__attribute__((unused)) u8 *pos, __attribute__((unused)) u32 size) {}
+WEAK void reimplementSvcBackdoor(__attribute__((unused)) u8 *pos, __attribute__((unused)) u32 size) {}
+WEAK void implementSvcGetCFWInfo(__attribute__((unused)) u8 *pos, __attribute__((unused)) u32 size) {}
+WEAK void applyLegacyFirmPatches(__attribute__((unused)) u8 *pos, __attribute__((unused)) FirmwareType firmType) {}
+WEAK void patchTwlBg(__attribute__((unused)) u8 *pos) {}
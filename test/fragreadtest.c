@@ -0,0 +1,191 @@
+/*
+*   Host test of the fragment-wide reads of source/fatfs/ff.c.
+*   A contiguous file and one in 12 fragments are written to a FAT32 SD image through FatFs,
+*   then read whole like fileRead does, with the cluster link map, and cluster by cluster
+*   without it. The data has to match what was written, and with the link map f_read has to
+*   make one disk_read per fragment and no FAT sector reads. What each read costs, in FatFs
+*   requests, FAT sector reads and device commands, is printed
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "hostdisk.h"
+#include "../source/fs.h"
+#include "../source/fatfs/ff.h"
+#include "../source/fatfs/diskio.h"
+#include "../source/fatfs/sdmmc/sdmmc.h"
+
+//FAT32 needs at least 65526 clusters
+#define SD_SECTORS      80000
+#define CLUSTER_SECTORS 1
+#define FRAGMENTS       12
+#define FRAGMENT_SIZE   (16 * CLUSTER_SECTORS * 0x200)
+#define FILE_SIZE       (FRAGMENTS * FRAGMENT_SIZE)
+
+//diskio.c keeps the cache data in FCRAM
+#define CACHE_AREA      0x27E00000
+
+static u8 written[FILE_SIZE],
+          buffer[FILE_SIZE];
+
+//Only the SD is used
+u32 ctrNandRead(u32 sector, u32 sectorCount, u8 *outbuf)
+{
+    return sdmmc_nand_readsectors(sector, sectorCount, outbuf);
+}
+
+void ctrNandInit(void)
+{
+}
+
+static void writeChunk(FIL *file, const u8 *data, u32 size)
+{
+    UINT bytesWritten;
+
+    if(f_write(file, data, size, &bytesWritten) != FR_OK || bytesWritten != size)
+    {
+        printf("Can't write the test files\n");
+        exit(1);
+    }
+}
+
+//The fragmented file is written alternately with a filler file, which is then deleted
+static void buildImage(void)
+{
+    FATFS fs;
+    FIL contiguous,
+        fragmented,
+        filler;
+    u32 seed = 1;
+
+    for(u32 i = 0; i < FILE_SIZE; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        written[i] = (u8)(seed >> 16);
+    }
+
+    createDisk(&sdDisk, SD_SECTORS);
+    formatFat32(&sdDisk, CLUSTER_SECTORS);
+
+    f_mount(&fs, "0:", 1);
+
+    f_open(&contiguous, "/contiguous.bin", FA_WRITE | FA_CREATE_ALWAYS);
+    writeChunk(&contiguous, written, FILE_SIZE);
+    f_close(&contiguous);
+
+    f_open(&fragmented, "/fragmented.bin", FA_WRITE | FA_CREATE_ALWAYS);
+    f_open(&filler, "/filler.bin", FA_WRITE | FA_CREATE_ALWAYS);
+    for(u32 i = 0; i < FRAGMENTS; i++)
+    {
+        writeChunk(&fragmented, written + i * FRAGMENT_SIZE, FRAGMENT_SIZE);
+        f_sync(&fragmented);
+        writeChunk(&filler, written, CLUSTER_SECTORS * 0x200);
+        f_sync(&filler);
+    }
+    f_close(&fragmented);
+    f_close(&filler);
+    f_unlink("/filler.bin");
+
+    f_mount(NULL, "0:", 1);
+}
+
+static u32 fatReads(const FATFS *fs)
+{
+    u32 count = 0;
+
+    for(u32 i = 0; i < traceLength; i++)
+        if(trace[i].sector >= fs->fatbase && trace[i].sector < fs->database) count++;
+
+    return count;
+}
+
+static int readFile(const char *path, bool linkMap, u32 expectedFragments)
+{
+    FATFS fs;
+    FIL file;
+    UINT read;
+    DWORD clmt[CLMT_SIZE];
+    u32 linkMapCommands = 0;
+    int failed = 0;
+
+    //A cold cache for each read
+    disk_initialize(0);
+    f_mount(&fs, "0:", 1);
+
+    if(f_open(&file, path, FA_READ) != FR_OK)
+    {
+        printf("Can't open %s\n", path);
+        return 1;
+    }
+
+    if(linkMap)
+    {
+        resetDiskCounters(&sdDisk);
+
+        clmt[0] = CLMT_SIZE;
+        file.cltbl = clmt;
+        if(f_lseek(&file, CREATE_LINKMAP) != FR_OK)
+        {
+            printf("%s: the link map doesn't fit\n", path);
+            return 1;
+        }
+
+        linkMapCommands = sdDisk.commands;
+
+        //The fragment count, as the table has them
+        u32 fragments = (clmt[0] - 1) / 2;
+        if(fragments != expectedFragments)
+        {
+            printf("%s: %u fragments instead of %u\n", path, fragments, expectedFragments);
+            failed = 1;
+        }
+    }
+
+    resetDiskCounters(&sdDisk);
+    traceLength = 0;
+    tracing = 1;
+
+    FRESULT result = f_read(&file, buffer, sizeof(buffer), &read);
+
+    tracing = 0;
+
+    if(result != FR_OK || read != FILE_SIZE || memcmp(buffer, written, FILE_SIZE) != 0)
+    {
+        printf("%s: f_read doesn't return the file's data\n", path);
+        failed = 1;
+    }
+
+    u32 fat = fatReads(&fs);
+
+    printf("%-16s %-8s %8u %8u %8u %8u\n", path + 1, linkMap ? "yes" : "no", traceLength, fat, sdDisk.commands, linkMapCommands);
+
+    if(linkMap && (traceLength != expectedFragments || fat != 0))
+    {
+        printf("%s: %u FatFs reads and %u FAT sector reads instead of one per fragment and none\n", path, traceLength, fat);
+        failed = 1;
+    }
+
+    f_close(&file);
+    f_mount(NULL, "0:", 1);
+
+    return failed;
+}
+
+int main(void)
+{
+    int failed = 0;
+
+    mapFixed(CACHE_AREA, 0x100000);
+
+    buildImage();
+
+    printf("%u KB files, %u sector clusters\n", FILE_SIZE / 1024, CLUSTER_SECTORS);
+    printf("%-16s %-8s %8s %8s %8s %8s\n", "file", "link map", "reads", "FAT", "commands", "map cmds");
+
+    failed |= readFile("/contiguous.bin", false, 1);
+    failed |= readFile("/contiguous.bin", true, 1);
+    failed |= readFile("/fragmented.bin", false, FRAGMENTS);
+    failed |= readFile("/fragmented.bin", true, FRAGMENTS);
+
+    return failed;
+}
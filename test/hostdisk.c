@@ -0,0 +1,203 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/mman.h>
+#include "hostdisk.h"
+
+hostDisk sdDisk,
+         nandDisk;
+uint8_t nandCid[0x10];
+
+void createDisk(hostDisk *disk, uint32_t sectorCount)
+{
+    free(disk->image);
+    disk->image = calloc(sectorCount, 0x200);
+    if(disk->image == NULL)
+    {
+        printf("Out of memory\n");
+        exit(1);
+    }
+
+    disk->sectorCount = sectorCount;
+    resetDiskCounters(disk);
+}
+
+void loadDisk(hostDisk *disk, const char *path)
+{
+    FILE *file = fopen(path, "rb");
+    long size;
+
+    if(file == NULL || fseek(file, 0, SEEK_END) != 0 || (size = ftell(file)) <= 0)
+    {
+        printf("Can't read %s\n", path);
+        exit(1);
+    }
+
+    rewind(file);
+    createDisk(disk, (uint32_t)((size + 0x1FF) / 0x200));
+    if(fread(disk->image, 1, size, file) != (size_t)size)
+    {
+        printf("Can't read %s\n", path);
+        exit(1);
+    }
+
+    fclose(file);
+}
+
+void saveDisk(const hostDisk *disk, const char *path)
+{
+    FILE *file = fopen(path, "wb");
+
+    if(file == NULL || fwrite(disk->image, 0x200, disk->sectorCount, file) != disk->sectorCount)
+    {
+        printf("Can't write %s\n", path);
+        exit(1);
+    }
+
+    fclose(file);
+}
+
+void resetDiskCounters(hostDisk *disk)
+{
+    disk->commands = disk->sectorsRead = disk->sectorsWritten = 0;
+}
+
+static uint32_t diskRead(hostDisk *disk, uint32_t sector, uint32_t count, volatile uint8_t *out)
+{
+    disk->commands++;
+    if(sector > disk->sectorCount || count > disk->sectorCount - sector) return 1;
+
+    memcpy((uint8_t *)out, disk->image + sector * 0x200, count * 0x200);
+    disk->sectorsRead += count;
+
+    return 0;
+}
+
+//The driver's entry points, see source/fatfs/sdmmc/sdmmc.h
+void sdmmc_sdcard_init(void)
+{
+}
+
+uint32_t sdmmc_sdcard_readsectors(uint32_t sector, uint32_t count, volatile uint8_t *out)
+{
+    return diskRead(&sdDisk, sector, count, out);
+}
+
+uint32_t sdmmc_nand_readsectors(uint32_t sector, uint32_t count, volatile uint8_t *out)
+{
+    return diskRead(&nandDisk, sector, count, out);
+}
+
+int sdmmc_get_cid(int isNand, uint32_t *info)
+{
+    if(isNand) memcpy(info, nandCid, sizeof(nandCid));
+    else memset(info, 0, sizeof(nandCid));
+
+    return 0;
+}
+
+//Reads complete right away, so there's never any idle time to hand out
+void sdmmc_set_idle_callback(void (*callback)(void))
+{
+    (void)callback;
+}
+
+uint32_t sdmmc_sdcard_writesectors(uint32_t sector, uint32_t count, volatile uint8_t *in)
+{
+    sdDisk.commands++;
+    if(sector > sdDisk.sectorCount || count > sdDisk.sectorCount - sector) return 1;
+
+    memcpy(sdDisk.image + sector * 0x200, (const uint8_t *)in, count * 0x200);
+    sdDisk.sectorsWritten += count;
+
+    return 0;
+}
+
+static void write16(uint8_t *pos, uint32_t value)
+{
+    pos[0] = (uint8_t)value;
+    pos[1] = (uint8_t)(value >> 8);
+}
+
+static void write32(uint8_t *pos, uint32_t value)
+{
+    write16(pos, value);
+    write16(pos + 2, value >> 16);
+}
+
+void formatFat32(hostDisk *disk, uint32_t clusterSectors)
+{
+    const uint32_t reserved = 32;
+    uint32_t fatSectors = 1;
+
+    //Enough FAT for the clusters left after the FATs themselves
+    for(;;)
+    {
+        uint32_t clusters = (disk->sectorCount - reserved - 2 * fatSectors) / clusterSectors,
+                 needed = ((clusters + 2) * 4 + 0x1FF) / 0x200;
+        if(needed <= fatSectors) break;
+        fatSectors = needed;
+    }
+
+    memset(disk->image, 0, (reserved + 2 * fatSectors + clusterSectors) * 0x200);
+
+    uint8_t *boot = disk->image;
+    memcpy(boot, "\xEB\x58\x90MSWIN4.1", 11);
+    write16(boot + 11, 0x200);
+    boot[13] = (uint8_t)clusterSectors;
+    write16(boot + 14, reserved);
+    boot[16] = 2;
+    boot[21] = 0xF8;
+    write16(boot + 24, 63);
+    write16(boot + 26, 255);
+    write32(boot + 32, disk->sectorCount);
+    write32(boot + 36, fatSectors);
+    write32(boot + 44, 2); //Root directory cluster
+    write16(boot + 48, 1); //FSInfo sector
+    write16(boot + 50, 6); //Backup boot sector
+    boot[64] = 0x80;
+    boot[66] = 0x29;
+    write32(boot + 67, 0x4C554D41);
+    memcpy(boot + 71, "NO NAME    FAT32   ", 19);
+    write16(boot + 510, 0xAA55);
+
+    uint8_t *fsInfo = disk->image + 0x200;
+    write32(fsInfo, 0x41615252);
+    write32(fsInfo + 484, 0x61417272);
+    write32(fsInfo + 488, 0xFFFFFFFF);
+    write32(fsInfo + 492, 0xFFFFFFFF);
+    write32(fsInfo + 508, 0xAA550000);
+
+    memcpy(disk->image + 6 * 0x200, boot, 0x400);
+
+    for(uint32_t i = 0; i < 2; i++)
+    {
+        uint8_t *fat = disk->image + (reserved + i * fatSectors) * 0x200;
+        write32(fat, 0x0FFFFFF8);
+        write32(fat + 4, 0x0FFFFFFF);
+        write32(fat + 8, 0x0FFFFFFF); //Root directory
+    }
+}
+
+void *mapFixed(uintptr_t address, uint32_t size)
+{
+    void *map = mmap((void *)address, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+
+    if(map != (void *)address)
+    {
+        printf("Can't map 0x%lX bytes at 0x%lX\n", (unsigned long)size, (unsigned long)address);
+        exit(1);
+    }
+
+    return map;
+}
+
+double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
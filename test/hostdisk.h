@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdint.h>
+
+/* File-backed stand-ins for the SDMMC driver: each device is an image in memory (optionally
+   loaded from and saved to a file) and every driver call counts as one device command */
+
+typedef struct hostDisk
+{
+    uint8_t *image;
+    uint32_t sectorCount;
+    uint32_t commands,
+             sectorsRead,
+             sectorsWritten;
+} hostDisk;
+
+extern hostDisk sdDisk,
+                nandDisk;
+
+//What sdmmc_get_cid returns for the NAND
+extern uint8_t nandCid[0x10];
+
+void createDisk(hostDisk *disk, uint32_t sectorCount);
+void loadDisk(hostDisk *disk, const char *path);
+void saveDisk(const hostDisk *disk, const char *path);
+void resetDiskCounters(hostDisk *disk);
+
+/* FatFs is built with disk_read renamed to traced_disk_read, which records every request
+   it makes while tracing is on, and then calls the real disk_read */
+typedef struct traceEntry
+{
+    uint8_t pdrv;
+    uint32_t sector,
+             count;
+} traceEntry;
+
+extern traceEntry *trace;
+extern uint32_t traceLength;
+extern int tracing;
+
+void saveTrace(const char *path);
+void loadTrace(const char *path);
+
+//Formats the whole disk as a FAT32 volume without a partition table
+void formatFat32(hostDisk *disk, uint32_t clusterSectors);
+
+//Maps size bytes at a fixed address the ARM9 code expects memory at
+void *mapFixed(uintptr_t address, uint32_t size);
+
+double now(void);
@@ -0,0 +1,66 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "hostdisk.h"
+#include "../source/fatfs/diskio.h"
+
+traceEntry *trace;
+uint32_t traceLength;
+int tracing;
+
+static void addTraceEntry(uint8_t pdrv, uint32_t sector, uint32_t count)
+{
+    static uint32_t capacity;
+
+    if(traceLength == capacity)
+    {
+        capacity = capacity ? capacity * 2 : 256;
+        trace = realloc(trace, capacity * sizeof(traceEntry));
+        if(trace == NULL)
+        {
+            printf("Out of memory\n");
+            exit(1);
+        }
+    }
+
+    trace[traceLength++] = (traceEntry){pdrv, sector, count};
+}
+
+DRESULT traced_disk_read(BYTE pdrv, BYTE *buff, DWORD sector, UINT count)
+{
+    if(tracing) addTraceEntry(pdrv, (uint32_t)sector, count);
+
+    return disk_read(pdrv, buff, sector, count);
+}
+
+void saveTrace(const char *path)
+{
+    FILE *file = fopen(path, "w");
+
+    if(file == NULL)
+    {
+        printf("Can't write %s\n", path);
+        exit(1);
+    }
+
+    for(uint32_t i = 0; i < traceLength; i++)
+        fprintf(file, "%u %u %u\n", trace[i].pdrv, trace[i].sector, trace[i].count);
+
+    fclose(file);
+}
+
+void loadTrace(const char *path)
+{
+    FILE *file = fopen(path, "r");
+    unsigned int pdrv, sector, count;
+
+    if(file == NULL)
+    {
+        printf("Can't read %s\n", path);
+        exit(1);
+    }
+
+    traceLength = 0;
+    while(fscanf(file, "%u %u %u", &pdrv, &sector, &count) == 3) addTraceEntry((uint8_t)pdrv, sector, count);
+
+    fclose(file);
+}
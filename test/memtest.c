@@ -0,0 +1,272 @@
+/*
+*   Differential fuzz test and benchmark of memcpy, memset32 and memcmp from the three
+*   memory.c files (ARM9, chainloader and 3ds_injector), against the byte loops they replaced.
+*   Each build has its functions renamed by the Makefile so they can be linked together.
+*   The ldm/stm bursts are ARM code, so on the host the timings only cover the word loops
+*   and the head/tail handling around them
+*/
+
+#include <stdio.h>
+#include "hostdisk.h"
+
+#define BUFFER_SIZE     0x110000
+#define GUARD           0x40
+#define FUZZ_RUNS       300000
+#define BENCH_BYTES     0x1000000
+
+typedef void (*memcpyFunc)(void *dest, const void *src, uint32_t size);
+typedef int (*memcmpFunc)(const void *buf1, const void *buf2, uint32_t size);
+
+void arm9_memcpy(void *dest, const void *src, uint32_t size);
+int arm9_memcmp(const void *buf1, const void *buf2, uint32_t size);
+void memset32(void *dest, uint32_t filler, uint32_t size);
+void loader_memcpy(void *dest, const void *src, uint32_t size);
+void injector_memcpy(void *dest, const void *src, uint32_t size);
+int injector_memcmp(const void *buf1, const void *buf2, uint32_t size);
+
+//The original versions
+static void byteMemcpy(void *dest, const void *src, uint32_t size)
+{
+    uint8_t *destc = (uint8_t *)dest;
+    const uint8_t *srcc = (const uint8_t *)src;
+
+    for(uint32_t i = 0; i < size; i++)
+        destc[i] = srcc[i];
+}
+
+static void byteMemset32(void *dest, uint32_t filler, uint32_t size)
+{
+    uint32_t *dest32 = (uint32_t *)dest;
+
+    for(uint32_t i = 0; i < size / 4; i++)
+        dest32[i] = filler;
+}
+
+static int byteMemcmp(const void *buf1, const void *buf2, uint32_t size)
+{
+    const uint8_t *buf1c = (const uint8_t *)buf1;
+    const uint8_t *buf2c = (const uint8_t *)buf2;
+
+    for(uint32_t i = 0; i < size; i++)
+    {
+        int cmp = buf1c[i] - buf2c[i];
+        if(cmp) return cmp;
+    }
+
+    return 0;
+}
+
+static const struct
+{
+    const char *name;
+    memcpyFunc copy;
+    memcmpFunc compare;
+} implementations[] = {
+    {"ARM9", arm9_memcpy, arm9_memcmp},
+    {"loader", loader_memcpy, NULL},
+    {"injector", injector_memcpy, injector_memcmp}
+};
+
+#define IMPLEMENTATION_COUNT (sizeof(implementations) / sizeof(implementations[0]))
+
+static uint8_t __attribute__((aligned(64))) srcBuffer[BUFFER_SIZE],
+                                            destBuffer[BUFFER_SIZE],
+                                            expectedBuffer[BUFFER_SIZE];
+
+static uint32_t seed = 1;
+
+static uint32_t nextRandom(void)
+{
+    seed = seed * 1103515245 + 12345;
+    return seed >> 8;
+}
+
+//Mostly short sizes, where the head and tail handling is, with some long ones
+static uint32_t randomSize(void)
+{
+    switch(nextRandom() % 4)
+    {
+        case 0: return nextRandom() % 8;
+        case 1: return nextRandom() % 80;
+        case 2: return nextRandom() % 0x400;
+        default: return nextRandom() % 0x10000;
+    }
+}
+
+static void fillRandom(uint8_t *buffer, uint32_t size)
+{
+    for(uint32_t i = 0; i < size; i++) buffer[i] = (uint8_t)nextRandom();
+}
+
+static int fuzzCopy(uint32_t index)
+{
+    for(uint32_t run = 0; run < FUZZ_RUNS; run++)
+    {
+        uint32_t size = randomSize(),
+                 srcOffset = GUARD + nextRandom() % 8,
+                 destOffset = GUARD + nextRandom() % 8;
+
+        fillRandom(srcBuffer + srcOffset, size);
+        fillRandom(destBuffer, size + 2 * GUARD);
+        byteMemcpy(expectedBuffer, destBuffer, size + 2 * GUARD);
+        byteMemcpy(expectedBuffer + destOffset, srcBuffer + srcOffset, size);
+
+        implementations[index].copy(destBuffer + destOffset, srcBuffer + srcOffset, size);
+
+        if(byteMemcmp(destBuffer, expectedBuffer, size + 2 * GUARD) != 0)
+        {
+            printf("%s memcpy: copying %u bytes from offset %u to offset %u went wrong\n", implementations[index].name,
+                   size, srcOffset % 8, destOffset % 8);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static int fuzzCompare(uint32_t index)
+{
+    for(uint32_t run = 0; run < FUZZ_RUNS; run++)
+    {
+        uint32_t size = randomSize(),
+                 offset1 = nextRandom() % 8,
+                 offset2 = nextRandom() % 8;
+        uint8_t *buf1 = srcBuffer + offset1,
+                *buf2 = destBuffer + offset2;
+
+        fillRandom(buf1, size);
+        byteMemcpy(buf2, buf1, size);
+
+        //Equal, or a difference anywhere, including right past the end
+        if(nextRandom() % 4 != 0)
+        {
+            uint32_t pos = nextRandom() % (size + 1);
+            buf2[pos] ^= (uint8_t)(1 + nextRandom() % 255);
+        }
+
+        int expected = byteMemcmp(buf1, buf2, size),
+            result = implementations[index].compare(buf1, buf2, size);
+
+        if(result != expected)
+        {
+            printf("%s memcmp: %u bytes at offsets %u and %u returned %d instead of %d\n", implementations[index].name,
+                   size, offset1, offset2, result, expected);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static int fuzzSet(void)
+{
+    for(uint32_t run = 0; run < FUZZ_RUNS; run++)
+    {
+        uint32_t size = randomSize(),
+                 offset = GUARD + 4 * (nextRandom() % 8),
+                 filler = nextRandom() * 0x10001;
+
+        fillRandom(destBuffer, size + 2 * GUARD + 0x20);
+        byteMemcpy(expectedBuffer, destBuffer, size + 2 * GUARD + 0x20);
+        byteMemset32(expectedBuffer + offset, filler, size);
+
+        memset32(destBuffer + offset, filler, size);
+
+        if(byteMemcmp(destBuffer, expectedBuffer, size + 2 * GUARD + 0x20) != 0)
+        {
+            printf("memset32: setting %u bytes went wrong\n", size);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static double copyRate(memcpyFunc copy, uint32_t size, uint32_t srcAlign, uint32_t destAlign)
+{
+    uint32_t runs = BENCH_BYTES / size;
+    double start = now();
+
+    for(uint32_t i = 0; i < runs; i++)
+        copy(destBuffer + destAlign, srcBuffer + srcAlign, size);
+
+    return (double)runs * size / (now() - start) / (1024 * 1024);
+}
+
+static double compareRate(memcmpFunc compare, uint32_t size, uint32_t align1, uint32_t align2)
+{
+    uint32_t runs = BENCH_BYTES / size;
+    volatile int sink = 0;
+
+    //Equal buffers, so everything is compared
+    byteMemcpy(destBuffer + align2, srcBuffer + align1, size);
+    double start = now();
+
+    for(uint32_t i = 0; i < runs; i++)
+        sink += compare(srcBuffer + align1, destBuffer + align2, size);
+
+    (void)sink;
+
+    return (double)runs * size / (now() - start) / (1024 * 1024);
+}
+
+static void benchmark(void)
+{
+    static const uint32_t sizes[] = {16, 64, 256, 0x1000, 0x10000, 0x100000},
+                          alignments[][2] = {{0, 0}, {1, 1}, {1, 2}, {0, 3}};
+
+    printf("\nMB/s             src/dest   byte loop");
+    for(uint32_t i = 0; i < IMPLEMENTATION_COUNT; i++) printf("%10s", implementations[i].name);
+    printf("\n");
+
+    for(uint32_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+        for(uint32_t a = 0; a < sizeof(alignments) / sizeof(alignments[0]); a++)
+        {
+            uint32_t size = sizes[s],
+                     srcAlign = alignments[a][0],
+                     destAlign = alignments[a][1];
+
+            printf("memcpy %7u   %u/%u   %10.0f", size, srcAlign, destAlign, copyRate(byteMemcpy, size, srcAlign, destAlign));
+            for(uint32_t i = 0; i < IMPLEMENTATION_COUNT; i++)
+                printf("%10.0f", copyRate(implementations[i].copy, size, srcAlign, destAlign));
+            printf("\n");
+        }
+
+    fillRandom(srcBuffer, BUFFER_SIZE);
+
+    for(uint32_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+        for(uint32_t a = 0; a < sizeof(alignments) / sizeof(alignments[0]); a++)
+        {
+            uint32_t size = sizes[s],
+                     align1 = alignments[a][0],
+                     align2 = alignments[a][1];
+
+            printf("memcmp %7u   %u/%u   %10.0f", size, align1, align2, compareRate(byteMemcmp, size, align1, align2));
+            for(uint32_t i = 0; i < IMPLEMENTATION_COUNT; i++)
+            {
+                if(implementations[i].compare == NULL) printf("%10s", "-");
+                else printf("%10.0f", compareRate(implementations[i].compare, size, align1, align2));
+            }
+            printf("\n");
+        }
+}
+
+int main(int argc, char **argv)
+{
+    int failed = fuzzSet();
+
+    for(uint32_t i = 0; i < IMPLEMENTATION_COUNT; i++)
+    {
+        failed |= fuzzCopy(i);
+        if(implementations[i].compare != NULL) failed |= fuzzCompare(i);
+    }
+
+    if(failed) return 1;
+
+    printf("memory: memcpy, memset32 and memcmp match the byte loops over %u random runs each\n", FUZZ_RUNS);
+
+    //"memtest fuzz" skips the timings
+    if(argc < 2 || argv[1][0] != 'f') benchmark();
+
+    return 0;
+}
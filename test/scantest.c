@@ -0,0 +1,179 @@
+/*
+*   Host test and benchmark of the one-pass pattern scanner in source/patchengine.c.
+*   A synthetic Process9 of a real one's size is filled with Thumb-like code, and the patterns
+*   patchProcess9 looks for are planted at spread out offsets. memsearchMulti finds all of
+*   them in one pass, which is compared with the per-pattern memsearch calls it replaced, and
+*   with a naive search for correctness, including on random data with masked patterns
+*/
+
+#include <stdio.h>
+#include "hostdisk.h"
+#include "../source/patchengine.h"
+
+#define PROCESS9_SIZE   0x80000
+#define PATTERN_COUNT   7
+#define BENCH_RUNS      50
+#define FUZZ_RUNS       2000
+
+//The Process9 patterns, as in source/patches.c
+static const u8 patterns[PATTERN_COUNT][4] = {
+    {0xC0, 0x1C, 0x76, 0xE7},
+    {0xB5, 0x22, 0x4D, 0x0C},
+    {0xE2, 0x20, 0x20, 0x90},
+    {'e', 'x', 'e', ':'},
+    {0x0A, 0x81, 0x42, 0x02},
+    {0x21, 0x20, 0x18, 0x20},
+    {0x1E, 0x00, 0xC8, 0x05}
+};
+
+static u8 process9[PROCESS9_SIZE],
+          fuzzData[0x2000];
+
+static u32 seed = 1;
+
+static u32 nextRandom(void)
+{
+    seed = seed * 1103515245 + 12345;
+    return seed >> 8;
+}
+
+static const u8 *naiveSearch(const u8 *pos, u32 size, const searchPattern *pattern)
+{
+    const u8 *patternc = (const u8 *)pattern->pattern;
+
+    for(u32 i = 0; pattern->size <= size && i <= size - pattern->size; i++)
+    {
+        u32 j;
+        for(j = 0; j < pattern->size; j++)
+        {
+            u8 mask = pattern->mask == NULL ? 0xFF : pattern->mask[j];
+            if((pos[i + j] ^ patternc[j]) & mask) break;
+        }
+
+        if(j == pattern->size) return pos + i;
+    }
+
+    return NULL;
+}
+
+//Halfwords whose upper byte is a common Thumb opcode byte, like in compiled code
+static void buildProcess9(void)
+{
+    static const u8 opcodes[] = {0x68, 0x60, 0x1C, 0x46, 0x20, 0x21, 0xB5, 0xBD, 0xF0, 0xF7, 0xD0, 0xD1, 0xE7, 0x28, 0x42, 0x49, 0x48, 0x00};
+
+    for(u32 i = 0; i < PROCESS9_SIZE; i += 2)
+    {
+        process9[i] = (u8)nextRandom();
+        process9[i + 1] = opcodes[nextRandom() % sizeof(opcodes)];
+    }
+
+    for(u32 i = 0; i < PATTERN_COUNT; i++)
+    {
+        u32 offset = (PROCESS9_SIZE / 8 * (i + 1) + (nextRandom() % 0x1000)) & ~1u;
+        for(u32 j = 0; j < 4; j++) process9[offset + j] = patterns[i][j];
+    }
+}
+
+static int checkProcess9(const searchPattern *search)
+{
+    u8 *matches[PATTERN_COUNT];
+
+    if(memsearchMulti(process9, PROCESS9_SIZE, search, matches, PATTERN_COUNT) != PATTERN_COUNT)
+    {
+        printf("scanner: not every planted pattern was found\n");
+        return 1;
+    }
+
+    for(u32 i = 0; i < PATTERN_COUNT; i++)
+        if(matches[i] != naiveSearch(process9, PROCESS9_SIZE, &search[i]) ||
+           matches[i] != memsearch(process9, patterns[i], PROCESS9_SIZE, 4))
+        {
+            printf("scanner: pattern %u found at the wrong offset\n", i);
+            return 1;
+        }
+
+    return 0;
+}
+
+//Short random patterns, some masked, on data with few distinct bytes so they match often
+static int fuzz(void)
+{
+    u8 patternData[8][12],
+       maskData[8][12];
+    searchPattern search[8];
+    u8 *matches[8];
+
+    for(u32 run = 0; run < FUZZ_RUNS; run++)
+    {
+        u32 count = 1 + nextRandom() % 8,
+            size = nextRandom() % sizeof(fuzzData);
+
+        for(u32 i = 0; i < sizeof(fuzzData); i++) fuzzData[i] = (u8)(nextRandom() % 4);
+
+        for(u32 i = 0; i < count; i++)
+        {
+            search[i].size = 1 + nextRandom() % 12;
+            search[i].pattern = patternData[i];
+            search[i].mask = nextRandom() % 2 ? maskData[i] : NULL;
+
+            for(u32 j = 0; j < search[i].size; j++)
+            {
+                patternData[i][j] = (u8)(nextRandom() % 4);
+                maskData[i][j] = (u8)(nextRandom() % 3 ? 0xFF : nextRandom());
+            }
+        }
+
+        memsearchMulti(fuzzData, size, search, matches, count);
+
+        for(u32 i = 0; i < count; i++)
+            if(matches[i] != naiveSearch(fuzzData, size, &search[i]))
+            {
+                printf("scanner: random pattern %u of %u (%u bytes%s) found at the wrong offset in %u bytes\n", i, count,
+                       search[i].size, search[i].mask == NULL ? "" : ", masked", size);
+                return 1;
+            }
+    }
+
+    return 0;
+}
+
+static void benchmark(const searchPattern *search)
+{
+    u8 *matches[PATTERN_COUNT];
+    volatile u32 sink = 0;
+    double start = now();
+
+    for(u32 run = 0; run < BENCH_RUNS; run++)
+        for(u32 i = 0; i < PATTERN_COUNT; i++)
+            sink += memsearch(process9, patterns[i], PROCESS9_SIZE, 4) != NULL;
+
+    double separate = (now() - start) / BENCH_RUNS;
+
+    start = now();
+    for(u32 run = 0; run < BENCH_RUNS; run++)
+        sink += memsearchMulti(process9, PROCESS9_SIZE, search, matches, PATTERN_COUNT);
+
+    double multi = (now() - start) / BENCH_RUNS;
+
+    (void)sink;
+
+    printf("Process9 (0x%X bytes), %u patterns: %.3f ms with memsearch each, %.3f ms in one pass (%.1fx)\n",
+           PROCESS9_SIZE, PATTERN_COUNT, separate * 1000, multi * 1000, separate / multi);
+}
+
+int main(void)
+{
+    searchPattern search[PATTERN_COUNT];
+
+    for(u32 i = 0; i < PATTERN_COUNT; i++)
+        search[i] = (searchPattern){patterns[i], NULL, 4};
+
+    buildProcess9();
+
+    if(checkProcess9(search) || fuzz()) return 1;
+
+    printf("scanner: memsearchMulti agrees with memsearch and a naive search\n");
+    benchmark(search);
+
+    return 0;
+}
@@ -0,0 +1,313 @@
+/*
+*   Host test of the SDMMC sector transfers in source/fatfs/sdmmc/sdmmc.c.
+*   sdmmc.c is built against a model of the controller's registers, which serves an SD
+*   and a NAND image through the 16-bit or the 32-bit FIFO, and the sectors that come
+*   out of (or go into) it are compared byte for byte with the images
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "../source/fatfs/sdmmc/sdmmc.h"
+
+#define IMAGE_SECTORS 64
+#define GUARD_SIZE    16
+#define GUARD_BYTE    0xA5
+
+static u16 regs[0x200 / 2];
+static u8 images[2][IMAGE_SECTORS * 0x200]; //SD, NAND
+
+//Data phase of the current command
+static u8 block[0x200];
+static u32 blockPos,
+           blocksLeft,
+           sector;
+static bool reading,
+            writing,
+            blockReady;
+
+static u32 fifo16Accesses,
+           fifo32Accesses,
+           modelErrors;
+
+static void modelError(const char *what)
+{
+    if(!modelErrors++) printf("Register model: %s\n", what);
+}
+
+static u8 *currentImage(void)
+{
+    return images[regs[REG_SDPORTSEL / 2] & 1];
+}
+
+static void loadBlock(void)
+{
+    memcpy(block, currentImage() + sector * 0x200, 0x200);
+    blockPos = 0;
+    blockReady = true;
+
+#ifndef DATA32_SUPPORT
+    regs[REG_SDSTATUS1 / 2] |= TMIO_STAT1_RXRDY;
+#endif
+}
+
+static void endBlock(void)
+{
+    sector++;
+    blockPos = 0;
+    blockReady = false;
+
+    if(--blocksLeft == 0)
+    {
+        reading = writing = false;
+        regs[REG_SDSTATUS0 / 2] |= TMIO_STAT0_DATAEND;
+    }
+    else if(reading) loadBlock();
+#ifndef DATA32_SUPPORT
+    else regs[REG_SDSTATUS1 / 2] |= TMIO_STAT1_TXRQ;
+#endif
+}
+
+static void startCommand(u16 cmd)
+{
+    u32 arg = regs[REG_SDCMDARG0 / 2] | ((u32)regs[REG_SDCMDARG1 / 2] << 16);
+
+    regs[REG_SDSTATUS0 / 2] |= TMIO_STAT0_CMDRESPEND;
+
+    //Bit 11 flags a data phase, bit 12 a read
+    if(!(cmd & 0x800)) return;
+
+    //The NAND is addressed in bytes, the (SDHC) SD in sectors
+    sector = regs[REG_SDPORTSEL / 2] & 1 ? arg >> 9 : arg;
+    blocksLeft = regs[REG_SDBLKCOUNT / 2];
+    reading = (cmd & 0x1000) != 0;
+    writing = !reading;
+    blockPos = 0;
+
+#ifdef DATA32_SUPPORT
+    if(regs[REG_SDBLKCOUNT32 / 2] != blocksLeft || regs[REG_SDBLKLEN32 / 2] != 0x200)
+        modelError("the 32-bit block count or length wasn't set up");
+#endif
+
+    if(!blocksLeft || sector + blocksLeft > IMAGE_SECTORS)
+    {
+        modelError("transfer out of the image");
+        reading = writing = false;
+        return;
+    }
+
+    if(reading) loadBlock();
+#ifndef DATA32_SUPPORT
+    else regs[REG_SDSTATUS1 / 2] |= TMIO_STAT1_TXRQ;
+#endif
+}
+
+static u32 readFifo(u32 width)
+{
+    u32 data = 0;
+
+    if(!reading || !blockReady)
+    {
+        modelError("FIFO read with no data ready");
+        return 0;
+    }
+
+    for(u32 i = 0; i < width; i++) data |= (u32)block[blockPos++] << (i * 8);
+    if(blockPos == 0x200) endBlock();
+
+    return data;
+}
+
+static void writeFifo(u32 data, u32 width)
+{
+    if(!writing)
+    {
+        modelError("FIFO write with no write command");
+        return;
+    }
+
+    for(u32 i = 0; i < width; i++) block[blockPos++] = (u8)(data >> (i * 8));
+    if(blockPos == 0x200)
+    {
+        memcpy(currentImage() + sector * 0x200, block, 0x200);
+        endBlock();
+    }
+}
+
+u16 sdmmc_read16(u16 reg)
+{
+    switch(reg)
+    {
+        case REG_SDFIFO:
+#ifdef DATA32_SUPPORT
+            modelError("16-bit FIFO used in 32-bit mode");
+#endif
+            fifo16Accesses++;
+            return (u16)readFifo(2);
+        case REG_SDDATACTL32:
+        {
+            u16 value = regs[reg / 2] & ~0x300;
+#ifdef DATA32_SUPPORT
+            if(reading && blockReady) value |= 0x100; //RX FIFO full
+            if(!writing) value |= 0x200; //TX FIFO not accepting data
+#endif
+            return value;
+        }
+        default:
+            return regs[reg / 2];
+    }
+}
+
+void sdmmc_write16(u16 reg, u16 val)
+{
+    switch(reg)
+    {
+        case REG_SDFIFO:
+#ifdef DATA32_SUPPORT
+            modelError("16-bit FIFO used in 32-bit mode");
+#endif
+            fifo16Accesses++;
+            writeFifo(val, 2);
+            break;
+        case REG_SDCMD:
+            regs[reg / 2] = val;
+            startCommand(val);
+            break;
+        case REG_SDSTATUS1:
+            //Acknowledging a block request clears it until the next block
+            regs[reg / 2] = val;
+            break;
+        default:
+            regs[reg / 2] = val;
+            break;
+    }
+}
+
+u32 sdmmc_read32(u16 reg)
+{
+    if(reg != REG_SDFIFO32)
+        return sdmmc_read16(reg) | ((u32)sdmmc_read16(reg + 2) << 16);
+
+#ifndef DATA32_SUPPORT
+    modelError("32-bit FIFO used in 16-bit mode");
+#endif
+    fifo32Accesses++;
+    return readFifo(4);
+}
+
+void sdmmc_write32(u16 reg, u32 val)
+{
+    if(reg != REG_SDFIFO32)
+    {
+        sdmmc_write16(reg, (u16)val);
+        sdmmc_write16(reg + 2, (u16)(val >> 16));
+        return;
+    }
+
+#ifndef DATA32_SUPPORT
+    modelError("32-bit FIFO used in 16-bit mode");
+#endif
+    fifo32Accesses++;
+    writeFifo(val, 4);
+}
+
+void ioDelay(u32 us)
+{
+    (void)us;
+}
+
+static void fillImages(void)
+{
+    u32 seed = 0x12345678;
+
+    for(u32 i = 0; i < sizeof(images); i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        ((u8 *)images)[i] = (u8)(seed >> 16);
+    }
+}
+
+static bool guardsIntact(const u8 *buffer, u32 offset, u32 size)
+{
+    for(u32 i = 0; i < offset + GUARD_SIZE; i++)
+        if(buffer[i] != GUARD_BYTE) return false;
+    for(u32 i = offset + GUARD_SIZE + size; i < offset + 2 * GUARD_SIZE + size; i++)
+        if(buffer[i] != GUARD_BYTE) return false;
+
+    return true;
+}
+
+static int testRead(int nand, u32 first, u32 count, u32 offset)
+{
+    static u8 buffer[IMAGE_SECTORS * 0x200 + 2 * GUARD_SIZE + 4];
+    u8 *dest = buffer + GUARD_SIZE + offset;
+
+    memset(buffer, GUARD_BYTE, sizeof(buffer));
+    modelErrors = 0;
+
+    u32 result = nand ? sdmmc_nand_readsectors(first, count, dest) : sdmmc_sdcard_readsectors(first, count, dest);
+
+    if(result || modelErrors || memcmp(dest, images[nand] + first * 0x200, count * 0x200) != 0 ||
+       !guardsIntact(buffer, offset, count * 0x200))
+    {
+        printf("%s read of %u sectors at %u into a buffer at +%u doesn't match\n", nand ? "NAND" : "SD", count, first, offset);
+        return 1;
+    }
+
+    return 0;
+}
+
+static int testWrite(u32 first, u32 count, u32 offset)
+{
+    static u8 buffer[IMAGE_SECTORS * 0x200 + 2 * GUARD_SIZE + 4],
+              expected[sizeof(images[0])];
+    u8 *src = buffer + GUARD_SIZE + offset;
+
+    for(u32 i = 0; i < count * 0x200; i++) src[i] = (u8)(i * 7 + first + offset);
+    memcpy(expected, images[0], sizeof(expected));
+    memcpy(expected + first * 0x200, src, count * 0x200);
+    modelErrors = 0;
+
+    if(sdmmc_sdcard_writesectors(first, count, src) || modelErrors || memcmp(images[0], expected, sizeof(expected)) != 0)
+    {
+        printf("SD write of %u sectors at %u from a buffer at +%u doesn't match\n", count, first, offset);
+        return 1;
+    }
+
+    return 0;
+}
+
+int main(void)
+{
+    static const u32 counts[] = {1, 2, 5, 16};
+    int failed = 0;
+
+    fillImages();
+
+    getMMCDevice(0)->devicenumber = 1;
+    getMMCDevice(1)->devicenumber = 0;
+    getMMCDevice(1)->isSDHC = 1;
+
+    for(u32 offset = 0; offset < 4; offset++)
+        for(u32 i = 0; i < sizeof(counts) / sizeof(counts[0]); i++)
+        {
+            failed |= testRead(0, 3 + i, counts[i], offset);
+            failed |= testRead(1, 7 * i, counts[i], offset);
+            failed |= testWrite(11 + i, counts[i], offset);
+        }
+
+    //How many FIFO accesses a sector costs with an aligned buffer
+    fifo16Accesses = fifo32Accesses = 0;
+    failed |= testRead(0, 0, 16, 0);
+
+#ifdef DATA32_SUPPORT
+    const char *mode = "32-bit";
+#else
+    const char *mode = "16-bit";
+#endif
+
+    if(!failed)
+        printf("sdmmc (%s FIFO): reads and writes match the images, %u FIFO accesses per sector\n", mode,
+               (fifo16Accesses + fifo32Accesses) / 16);
+
+    return failed;
+}
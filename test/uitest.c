@@ -0,0 +1,276 @@
+/*
+*   Host test of the retained menu text of source/ui.c.
+*   ui.c and draw.c are built as is, and draw to in-memory framebuffers at the addresses of
+*   the real ones. The screen functions they call are modeled here: the shown framebuffer is
+*   the one fb->top_left names, swapFramebuffers shows the other one and returns the old one.
+*   The config menu's updates, and then random edits, moves, recolors and row count changes,
+*   are made through the ui calls, and after each uiFlush the shown framebuffer has to be
+*   exactly the rows drawn from scratch on black by a plain pixel by pixel renderer.
+*   How many cells the flushes redrew is compared with redrawing every row each time
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "hostdisk.h"
+#include "../source/ui.h"
+#include "../source/draw.h"
+#include "../source/screen.h"
+#include "../source/memory.h"
+
+//draw.c has its own copy
+#define font_size referenceFontSize
+#include "../source/font.h"
+#undef font_size
+
+#define RANDOM_STEPS    2000
+
+static u8 expectedFb[SCREEN_TOP_FBSIZE];
+static uiRow model[UI_MAX_ROWS];
+static u32 modelCount,
+           cellsDrawn,
+           fullRedrawCells,
+           flushes;
+
+//The screens, with the GPU fills done right away
+void initScreens(void)
+{
+    fb->top_left = fb->top_right = TOP_FRAMEBUFFER_0;
+    memset32(TOP_FRAMEBUFFER_0, 0, SCREEN_TOP_FBSIZE);
+}
+
+u8 *initDoubleBuffering(void)
+{
+    memset32(TOP_FRAMEBUFFER_1, 0, SCREEN_TOP_FBSIZE);
+
+    return TOP_FRAMEBUFFER_1;
+}
+
+u8 *swapFramebuffers(void)
+{
+    u8 *oldFront = fb->top_left;
+
+    fb->top_left = fb->top_right = oldFront == TOP_FRAMEBUFFER_0 ? TOP_FRAMEBUFFER_1 : TOP_FRAMEBUFFER_0;
+
+    return oldFront;
+}
+
+void waitScreens(void) {}
+
+void error(const char *message)
+{
+    printf("error(): %s\n", message);
+    exit(1);
+}
+
+//What else draw.c uses, for the splash
+u32 arm11Submit(__attribute__((unused)) void (*func)(u32 arg), __attribute__((unused)) u32 arg) { return 0; }
+u32 fileRead(__attribute__((unused)) void *dest, __attribute__((unused)) const char *path, __attribute__((unused)) u32 maxSize) { return 0; }
+void flushDCacheRange(__attribute__((unused)) void *startAddress, __attribute__((unused)) u32 size) {}
+void chrono(__attribute__((unused)) u32 seconds) {}
+u64 chronoTicks(void) { return 0; }
+
+//Linked with --wrap=drawCell, to count the cells ui.c redraws
+void __real_drawCell(u8 *framebuffer, char character, int posX, int posY, u32 color);
+
+void __wrap_drawCell(u8 *framebuffer, char character, int posX, int posY, u32 color)
+{
+    cellsDrawn++;
+    __real_drawCell(framebuffer, character, posX, posY, color);
+}
+
+static u32 modelRowLength(const uiRow *row)
+{
+    u32 length = (SCREEN_TOP_WIDTH - row->posX) / SPACING_X;
+
+    return length < UI_ROW_LENGTH ? length : UI_ROW_LENGTH;
+}
+
+//An opaque glyph, bit by bit, like the renderer before the glyph atlas
+static void referenceCell(unsigned char character, int posX, int posY, u32 color)
+{
+    for(int y = 0; y < 8; y++)
+        for(int x = 0; x < 8; x++)
+        {
+            u32 pixel = (font[character * 8 + y] >> (7 - x)) & 1 ? color : COLOR_BLACK;
+            u8 *pos = expectedFb + ((posX + x) * SCREEN_TOP_HEIGHT + SCREEN_TOP_HEIGHT - posY - y - 1) * 3;
+
+            pos[0] = pixel >> 16;
+            pos[1] = pixel >> 8;
+            pos[2] = pixel;
+        }
+}
+
+static int checkFlush(const char *what)
+{
+    uiFlush();
+    flushes++;
+
+    memset32(expectedFb, 0, SCREEN_TOP_FBSIZE);
+    for(u32 i = 0; i < modelCount; i++)
+    {
+        fullRedrawCells += modelRowLength(&model[i]);
+
+        for(u32 j = 0; j < modelRowLength(&model[i]); j++)
+            referenceCell(model[i].text[j], model[i].posX + j * SPACING_X, model[i].posY, model[i].color);
+    }
+
+    const u8 *shown = fb->top_left;
+
+    for(u32 i = 0; i < SCREEN_TOP_FBSIZE; i++)
+        if(shown[i] != expectedFb[i])
+        {
+            printf("%s: pixel (%u, %u) byte %u is %02X instead of %02X\n", what, i / 3 / SCREEN_TOP_HEIGHT,
+                   SCREEN_TOP_HEIGHT - 1 - i / 3 % SCREEN_TOP_HEIGHT, i % 3, shown[i], expectedFb[i]);
+            return 1;
+        }
+
+    return 0;
+}
+
+//The ui calls, mirrored in the model
+static u32 addRow(int posX, int posY, const char *text, u32 color)
+{
+    uiRow *row = &model[modelCount];
+    u32 i;
+
+    row->posX = posX;
+    row->posY = posY;
+    row->color = color;
+    for(i = 0; i < modelRowLength(row) && text[i]; i++) row->text[i] = text[i];
+    for(; i < UI_ROW_LENGTH; i++) row->text[i] = ' ';
+
+    modelCount++;
+
+    return uiAddRow(posX, posY, text, color);
+}
+
+static void setCharacter(u32 row, u32 pos, char character)
+{
+    if(pos < modelRowLength(&model[row])) model[row].text[pos] = character;
+    uiSetCharacter(row, pos, character);
+}
+
+static void setColor(u32 row, u32 color)
+{
+    model[row].color = color;
+    uiSetColor(row, color);
+}
+
+static void clearRows(void)
+{
+    modelCount = 0;
+    uiClear();
+}
+
+static int configMenu(void)
+{
+    static const char *options[] = {
+        "Screen brightness: 4( ) 3( ) 2( ) 1( )",
+        "New 3DS CPU: Off( ) Clock( ) L2( ) Clock+L2( )",
+        "( ) Autoboot SysNAND",
+        "( ) Use SysNAND FIRM if booting with R (A9LH)",
+        "( ) Use second EmuNAND as default",
+        "( ) Enable region/language emu. and ext. .code",
+        "( ) Show current NAND in System Settings",
+        "( ) Enable experimental TwlBg patches",
+        "( ) Show GBA boot screen in patched AGB_FIRM",
+        "( ) Display splash screen before payloads",
+        "( ) Use a PIN"
+    };
+    const u32 optionCount = sizeof(options) / sizeof(options[0]);
+    int failed = 0;
+
+    addRow(10, 10, "Luma3DS configuration", COLOR_TITLE);
+    addRow(10, 20, "Press A to select, START to save", COLOR_WHITE);
+    for(u32 i = 0; i < optionCount; i++) addRow(10, 40 + i * SPACING_Y, options[i], i ? COLOR_WHITE : COLOR_RED);
+    failed |= checkFlush("Menu");
+
+    //Moving the cursor down the options, then toggling each
+    for(u32 i = 1; i < optionCount; i++)
+    {
+        setColor(i + 1, COLOR_WHITE);
+        setColor(i + 2, COLOR_RED);
+        failed |= checkFlush("Cursor");
+    }
+    for(u32 i = 2; i < optionCount; i++)
+    {
+        setCharacter(i + 2, 1, 'x');
+        failed |= checkFlush("Toggle");
+    }
+    setCharacter(2, 20, ' ');
+    setCharacter(2, 29, 'x');
+    failed |= checkFlush("Multiple choice");
+
+    //Another screen with fewer rows elsewhere, like the PIN one
+    clearRows();
+    addRow(10, 10, "Enter a new PIN to proceed", COLOR_TITLE);
+    addRow(10, 100, "PIN (4 digits): ", COLOR_WHITE);
+    failed |= checkFlush("PIN screen");
+
+    for(u32 i = 0; i < 4; i++)
+    {
+        setCharacter(1, 16 + i, '*');
+        failed |= checkFlush("PIN digit");
+    }
+
+    return failed;
+}
+
+static int randomEdits(void)
+{
+    static const u32 colors[] = {COLOR_WHITE, COLOR_RED, COLOR_TITLE, 0x00FF00};
+    int failed = 0;
+
+    srand(1);
+
+    for(u32 step = 0; step < RANDOM_STEPS && !failed; step++)
+    {
+        u32 edits = rand() % 4 + 1;
+
+        for(u32 i = 0; i < edits; i++)
+        {
+            u32 action = rand() % 16;
+
+            if(action == 0 || !modelCount)
+            {
+                //A new screen, with rows at new positions, some right where the old ones were
+                clearRows();
+                for(u32 j = rand() % UI_MAX_ROWS + 1, posY = rand() % 30; j && posY <= SCREEN_TOP_HEIGHT - 8; j--, posY += SPACING_Y)
+                {
+                    char text[UI_ROW_LENGTH + 1];
+                    u32 length = rand() % (UI_ROW_LENGTH + 1);
+
+                    for(u32 k = 0; k < length; k++) text[k] = (char)(rand() % 4 ? ' ' + rand() % 95 : ' ');
+                    text[length] = 0;
+
+                    addRow((rand() % 2) * 10 + (rand() % 4) * SPACING_X, posY, text, colors[rand() % 4]);
+                }
+            }
+            else if(action < 3 && modelCount < UI_MAX_ROWS && model[modelCount - 1].posY + SPACING_Y <= SCREEN_TOP_HEIGHT - 8)
+                addRow(10, model[modelCount - 1].posY + SPACING_Y, "An added row", colors[rand() % 4]);
+            else if(action < 8) setColor(rand() % modelCount, colors[rand() % 4]);
+            else setCharacter(rand() % modelCount, rand() % UI_ROW_LENGTH, (char)(' ' + rand() % 96 + rand() % 2 * 0x80));
+        }
+
+        failed |= checkFlush("Random edits");
+    }
+
+    return failed;
+}
+
+int main(void)
+{
+    mapFixed((uintptr_t)TOP_FRAMEBUFFER_0, 0x200000);
+    mapFixed((uintptr_t)fb & ~0xFFF, 0x1000);
+
+    uiInit();
+
+    int failed = configMenu();
+    if(!failed) failed = randomEdits();
+
+    if(!failed)
+        printf("ui: %u flushes show exactly the rows, %u cells redrawn instead of %u (%.1f%%)\n", flushes,
+               cellsDrawn, fullRedrawCells, 100.0 * cellsDrawn / fullRedrawCells);
+
+    return failed;
+}